@@ -0,0 +1,219 @@
+/*
+ * cachesim.c - Set-associative L1/L2/TLB model (mdriver --cachesim).
+ *
+ * Both caches use the same line size, allocate on loads and stores
+ * alike, and are not inclusive: an L1 miss looks up L2 and fills both.
+ * The TLB is looked up on every access, independently of the caches.
+ * An access that straddles a line or a page is counted once but looks
+ * up both. The model starts empty at every cs_start.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cachesim.h"
+
+#define MAXLINE 1024
+
+/* One set-associative structure: tag[set * ways + way], 0 if empty */
+typedef struct
+{
+	long sets;
+	int ways;
+	unsigned long *tag;	 /* block number + 1 */
+	unsigned long *used; /* time of the last hit, for LRU */
+} cache_t;
+
+static csconfig_t cfg = {
+	32 * 1024, 8,	/* L1: 32K, 8-way */
+	1024 * 1024, 16, /* L2: 1M, 16-way */
+	64,				/* 64 B lines */
+	64, 4,			/* TLB: 64 entries, 4-way */
+	4096};			/* 4K pages */
+
+static cache_t l1, l2, tlb;
+static int cs_on = 0;		  /* between cs_start and cs_stop */
+static char *cs_base;		  /* heap base the addresses are taken from */
+static unsigned long tick = 0; /* access counter, the LRU clock */
+static csstat_t cur;		  /* counts of the current run */
+static char desc[MAXLINE];
+
+/*
+ * cache_init - (Re)allocate c for n blocks in ways-way sets and empty it
+ */
+static int cache_init(cache_t *c, long n, int ways)
+{
+	if (ways < 1 || n < ways || n % ways != 0)
+		return -1;
+	free(c->tag);
+	free(c->used);
+	c->sets = n / ways;
+	c->ways = ways;
+	c->tag = (unsigned long *)calloc(n, sizeof(unsigned long));
+	c->used = (unsigned long *)calloc(n, sizeof(unsigned long));
+	return (c->tag && c->used) ? 0 : -1;
+}
+
+/*
+ * cache_lookup - Look up block number blk in c, filling it over the least
+ *     recently used way on a miss. Returns 1 on a hit, 0 on a miss.
+ */
+static int cache_lookup(cache_t *c, unsigned long blk)
+{
+	long base = (long)(blk % c->sets) * c->ways;
+	int w, victim = 0;
+
+	for (w = 0; w < c->ways; w++)
+	{
+		if (c->tag[base + w] == blk + 1)
+		{
+			c->used[base + w] = tick;
+			return 1;
+		}
+		if (c->used[base + w] < c->used[base + victim])
+			victim = w;
+	}
+	c->tag[base + victim] = blk + 1;
+	c->used[base + victim] = tick;
+	return 0;
+}
+
+/*
+ * parse_size - Read a size with an optional k or m suffix from *s
+ */
+static long parse_size(char **s)
+{
+	long v = strtol(*s, s, 10);
+
+	if (**s == 'k' || **s == 'K')
+		v <<= 10, (*s)++;
+	else if (**s == 'm' || **s == 'M')
+		v <<= 20, (*s)++;
+	return v;
+}
+
+/*
+ * cs_configure - Change the geometry from spec, a comma-separated list
+ *     of l1=SIZE/WAYS, l2=SIZE/WAYS, line=BYTES, tlb=ENTRIES/WAYS and
+ *     page=BYTES (sizes may end in k or m); what is left out keeps its
+ *     default. Returns 0, or -1 if spec does not parse or makes no sense.
+ */
+int cs_configure(const char *spec)
+{
+	char buf[MAXLINE], *item, *s, *save;
+	csconfig_t c = cfg;
+	long a, b;
+
+	snprintf(buf, sizeof(buf), "%s", spec);
+	for (item = strtok_r(buf, ",", &save); item != NULL;
+		 item = strtok_r(NULL, ",", &save))
+	{
+		if ((s = strchr(item, '=')) == NULL)
+			return -1;
+		*s++ = '\0';
+		a = parse_size(&s);
+		b = 0;
+		if (*s == '/')
+		{
+			s++;
+			b = strtol(s, &s, 10);
+		}
+		if (*s != '\0' || a <= 0)
+			return -1;
+		if (!strcmp(item, "l1") && b > 0)
+			c.l1_size = a, c.l1_ways = (int)b;
+		else if (!strcmp(item, "l2") && b > 0)
+			c.l2_size = a, c.l2_ways = (int)b;
+		else if (!strcmp(item, "tlb") && b > 0)
+			c.tlb_size = (int)a, c.tlb_ways = (int)b;
+		else if (!strcmp(item, "line") && b == 0 && (a & (a - 1)) == 0)
+			c.line = (int)a;
+		else if (!strcmp(item, "page") && b == 0 && (a & (a - 1)) == 0)
+			c.page = a;
+		else
+			return -1;
+	}
+	if (c.l1_size % c.line || c.l2_size % c.line ||
+		cache_init(&l1, c.l1_size / c.line, c.l1_ways) < 0 ||
+		cache_init(&l2, c.l2_size / c.line, c.l2_ways) < 0 ||
+		cache_init(&tlb, c.tlb_size, c.tlb_ways) < 0)
+		return -1;
+	cfg = c;
+	return 0;
+}
+
+/*
+ * cs_describe - The geometry in words, for the driver's report
+ */
+const char *cs_describe(void)
+{
+	snprintf(desc, sizeof(desc),
+			 "L1 %ldK %d-way, L2 %ldK %d-way, %d B lines, "
+			 "TLB %d entries %d-way, %ldK pages",
+			 cfg.l1_size >> 10, cfg.l1_ways, cfg.l2_size >> 10, cfg.l2_ways,
+			 cfg.line, cfg.tlb_size, cfg.tlb_ways, cfg.page >> 10);
+	return desc;
+}
+
+/*
+ * cs_start - Empty the model and count the accesses from now on, with
+ *     addresses taken relative to base
+ */
+void cs_start(void *base)
+{
+	if (l1.tag == NULL && cs_configure("") < 0)
+	{
+		fprintf(stderr, "cachesim: bad default geometry\n");
+		exit(1);
+	}
+	memset(l1.tag, 0, l1.sets * l1.ways * sizeof(unsigned long));
+	memset(l1.used, 0, l1.sets * l1.ways * sizeof(unsigned long));
+	memset(l2.tag, 0, l2.sets * l2.ways * sizeof(unsigned long));
+	memset(l2.used, 0, l2.sets * l2.ways * sizeof(unsigned long));
+	memset(tlb.tag, 0, tlb.sets * tlb.ways * sizeof(unsigned long));
+	memset(tlb.used, 0, tlb.sets * tlb.ways * sizeof(unsigned long));
+	memset(&cur, 0, sizeof(cur));
+	tick = 0;
+	cs_base = (char *)base;
+	cs_on = 1;
+}
+
+/*
+ * cs_stop - Stop counting and return the counts of the run in *cs
+ */
+void cs_stop(csstat_t *cs)
+{
+	cs_on = 0;
+	*cs = cur;
+}
+
+/*
+ * cs_ref - Record a size-byte load (store == 0) or store at p, and
+ *     return p. Does nothing outside cs_start/cs_stop.
+ */
+void *cs_ref(void *p, int size, int store)
+{
+	unsigned long lo, hi, blk, pg;
+
+	if (!cs_on)
+		return p;
+	tick++;
+	if (store)
+		cur.stores++;
+	else
+		cur.loads++;
+
+	lo = (unsigned long)((char *)p - cs_base);
+	hi = lo + size - 1;
+	for (pg = lo / cfg.page; pg <= hi / cfg.page; pg++)
+		if (!cache_lookup(&tlb, pg))
+			cur.tlb_miss++;
+	for (blk = lo / cfg.line; blk <= hi / cfg.line; blk++)
+		if (!cache_lookup(&l1, blk))
+		{
+			cur.l1_miss++;
+			if (!cache_lookup(&l2, blk))
+				cur.l2_miss++;
+		}
+	return p;
+}
@@ -0,0 +1,45 @@
+/*
+ * cachesim.h - Cache model fed with the allocators' metadata accesses
+ *              (mdriver --cachesim).
+ *
+ * Built with -DMM_CACHESIM, the GET/PUT and free-list link macros of mm.c,
+ * mm_seg.c and sdfs.c pass every address they read or write to cs_ref
+ * (see MM_REF in mm.h). While a simulation runs, each access goes
+ * through a data TLB and an L1 and L2 cache, all set associative with
+ * LRU replacement. Addresses are taken relative to the heap base, so
+ * the counts depend only on the allocator and the trace, not on the
+ * host or where the heap was mapped.
+ */
+#ifndef __CACHESIM_H_
+#define __CACHESIM_H_
+
+/* Geometry of the simulated hierarchy */
+typedef struct
+{
+	long l1_size;  /* bytes */
+	int l1_ways;
+	long l2_size;  /* bytes */
+	int l2_ways;
+	int line;	   /* line size of both caches, bytes */
+	int tlb_size;  /* entries */
+	int tlb_ways;
+	long page;	   /* page size, bytes */
+} csconfig_t;
+
+/* Counts of one simulated run */
+typedef struct
+{
+	double loads;	 /* metadata reads */
+	double stores;	 /* metadata writes */
+	double l1_miss;
+	double l2_miss;	 /* accesses that missed in L1 and L2 */
+	double tlb_miss;
+} csstat_t;
+
+int cs_configure(const char *spec);
+const char *cs_describe(void);
+void cs_start(void *base);
+void cs_stop(csstat_t *cs);
+void *cs_ref(void *p, int size, int store);
+
+#endif /* __CACHESIM_H_ */
@@ -1,6 +1,6 @@
 /* 
- * clock.c - Routines for using the cycle counters on x86, 
- *           Alpha, and Sparc boxes.
+ * clock.c - Routines for using the cycle counters on x86, x86-64,
+ *           AArch64, Alpha, and Sparc boxes.
  * 
  * Copyright (c) 2002, R. Bryant and D. O'Hallaron, All rights reserved.
  * May not be used, modified, or copied without permission.
@@ -9,6 +9,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <time.h>
 #include <sys/times.h>
 #include "clock.h"
 
@@ -21,7 +22,28 @@
  * You can verify this for yourself using gcc -v.
  *******************************************************/
 
-#if defined(__i386__)  
+#if defined(__x86_64__) || defined(__aarch64__)
+/*******************************************************
+ * 64-bit versions of start_counter() and get_counter().
+ * read_counter (clock.h) returns the whole 64-bit count,
+ * so no double precision borrow is needed.
+ *******************************************************/
+
+static unsigned long long cyc_start = 0;
+
+/* Record the current value of the cycle counter. */
+void start_counter()
+{
+    cyc_start = read_counter();
+}
+
+/* Return the number of cycles since the last call to start_counter. */
+double get_counter()
+{
+    return (double)(read_counter() - cyc_start);
+}
+
+#elif defined(__i386__)  
 /*******************************************************
  * Pentium versions of start_counter() and get_counter()
  *******************************************************/
@@ -195,10 +217,52 @@ double mhz_full(int verbose, int sleeptime)
 }
 /* $end mhz */
 
-/* Version using a default sleeptime */
+#define CAL_NSECS 100000000 /* length of the counter calibration (100 ms) */
+
+/*
+ * mhz_calibrate - Estimate the counter rate against CLOCK_MONOTONIC.
+ * The TSC of current x86-64 parts and the AArch64 virtual counter
+ * tick at a constant rate, so a short busy wait is accurate enough
+ * and saves the two second sleep of mhz_full.
+ */
+static double mhz_calibrate(int verbose)
+{
+    struct timespec t0, t1;
+    unsigned long long c0, c1;
+    double ns, rate;
+
+#if defined(__aarch64__)
+    unsigned long long freq;
+
+    __asm__ __volatile__("mrs %0, cntfrq_el0" : "=r" (freq));
+    if (freq != 0) {
+	rate = freq / 1e6;
+	if (verbose)
+	    printf("Counter rate (cntfrq_el0) = %.1f MHz\n", rate);
+	return rate;
+    }
+#endif
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    c0 = read_counter();
+    do {
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+    } while (ns < CAL_NSECS);
+    c1 = read_counter();
+    rate = (c1 - c0) / (ns / 1e3);
+    if (verbose)
+	printf("Processor clock rate ~= %.1f MHz\n", rate);
+    return rate;
+}
+
+/* Version using a default sleeptime (or a quick calibration) */
 double mhz(int verbose)
 {
+#if defined(__x86_64__) || defined(__aarch64__)
+    return mhz_calibrate(verbose);
+#else
     return mhz_full(verbose, 2);
+#endif
 }
 
 /** Special counters that compensate for timer interrupt overhead */
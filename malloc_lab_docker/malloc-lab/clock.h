@@ -1,4 +1,35 @@
 /* Routines for using cycle counter */
+#ifndef __CLOCK_H_
+#define __CLOCK_H_
+
+#include <time.h>
+
+/*
+ * read_counter - Raw value of the cycle counter: the time stamp counter
+ *     on x86, the virtual counter on AArch64 (which runs at the fixed
+ *     rate in cntfrq_el0, not at the CPU clock), and CLOCK_MONOTONIC
+ *     nanoseconds on other platforms. Inline so hot paths can time
+ *     single calls with it.
+ */
+static inline unsigned long long read_counter(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned hi, lo;
+
+    __asm__ __volatile__("rdtscp" : "=a" (lo), "=d" (hi) : : "ecx");
+    return ((unsigned long long)hi << 32) | lo;
+#elif defined(__aarch64__)
+    unsigned long long v;
+
+    __asm__ __volatile__("isb; mrs %0, cntvct_el0" : "=r" (v));
+    return v;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
 
 /* Start the counter */
 void start_counter();
@@ -20,3 +51,5 @@ double mhz_full(int verbose, int sleeptime);
 void start_comp_counter();
 
 double get_comp_counter();
+
+#endif /* __CLOCK_H_ */
@@ -62,11 +62,25 @@
  */
 #define MAX_HEAP (20*(1<<20))  /* 20 MB */
 
+/*
+ * Default size of a heap mapped from a file (mem_init_file). The
+ * file is created sparse, so only touched pages use disk space.
+ * Override at runtime with mem_set_mapsize().
+ */
+#define PERSIST_HEAP (256*(1<<20))  /* 256 MB */
+
 /*****************************************************************************
- * Set exactly one of these USE_xxx constants to "1" to select a timing method
+ * Set exactly one of these USE_xxx constants to "1" to select a timing method.
+ * The cycle counter is picked automatically where clock.c implements it.
  *****************************************************************************/
-#define USE_FCYC   0   /* cycle counter w/K-best scheme (x86 & Alpha only) */
+#if defined(__x86_64__) || defined(__aarch64__) || defined(__i386__)
+#define USE_FCYC   1   /* cycle counter w/K-best scheme (x86, x86-64, AArch64 & Alpha) */
+#define USE_ITIMER 0   /* interval timer (any Unix box) */
+#define USE_GETTOD 0   /* gettimeofday (any Unix box) */
+#else
+#define USE_FCYC   0   /* cycle counter w/K-best scheme (x86, x86-64, AArch64 & Alpha) */
 #define USE_ITIMER 0   /* interval timer (any Unix box) */
 #define USE_GETTOD 1   /* gettimeofday (any Unix box) */
+#endif
 
 #endif /* __CONFIG_H */
@@ -28,6 +28,7 @@ static int maxsamples = MAXSAMPLES;
 static double epsilon = EPSILON;
 static int compensate = COMPENSATE;
 static int clear_cache = CLEAR_CACHE;
+static test_funct prepare = NULL; /* run before each measurement, untimed */
 static int cache_bytes = CACHE_BYTES;
 static int cache_block = CACHE_BLOCK;
 
@@ -133,6 +134,8 @@ double fcyc(test_funct f, void *argp)
     if (compensate) {
 	do {
 	    double cyc;
+	    if (prepare)
+		prepare(argp);
 	    if (clear_cache)
 		clear();
 	    start_comp_counter();
@@ -143,6 +146,8 @@ double fcyc(test_funct f, void *argp)
     } else {
 	do {
 	    double cyc;
+	    if (prepare)
+		prepare(argp);
 	    if (clear_cache)
 		clear();
 	    start_counter();
@@ -245,7 +250,12 @@ void set_fcyc_epsilon(double epsilon_arg)
     epsilon = epsilon_arg;
 }
 
-
-
-
-
+/*
+ * set_fcyc_prepare - Function called with the same argument before
+ *     each measurement of f, outside the timed region (NULL for none)
+ *     Default = NULL
+ */
+void set_fcyc_prepare(test_funct prepare_arg)
+{
+    prepare = prepare_arg;
+}
@@ -63,6 +63,13 @@ void set_fcyc_maxsamples(int maxsamples_arg);
  */
 void set_fcyc_epsilon(double epsilon_arg);
 
+/*
+ * set_fcyc_prepare - Function called with the same argument before
+ *     each measurement of f, outside the timed region (NULL for none)
+ *     Default = NULL
+ */
+void set_fcyc_prepare(test_funct prepare_arg);
+
 
 
 
@@ -26,7 +26,14 @@ void init_fsecs(void)
     /* set key parameters for the fcyc package */
     set_fcyc_maxsamples(20); 
     set_fcyc_clear_cache(1);
+#if defined(__x86_64__) || defined(__aarch64__)
+    /* The tick-based calibration behind compensation needs 100 timer
+       ticks (a second or more, longer on tickless kernels); the K-best
+       scheme already drops the samples that an interrupt inflated. */
+    set_fcyc_compensate(0);
+#else
     set_fcyc_compensate(1);
+#endif
     set_fcyc_epsilon(0.01);
     set_fcyc_k(3);
     Mhz = mhz(verbose > 0);
@@ -54,4 +61,36 @@ double fsecs(fsecs_test_funct f, void *argp)
 #endif 
 }
 
+/*
+ * set_fsecs_prepare - Have fsecs call prepare(argp) before every run of
+ *     f, outside the timed region (NULL for none), e.g. to put back the
+ *     state that the previous run consumed
+ */
+void set_fsecs_prepare(fsecs_test_funct prepare)
+{
+    set_fcyc_prepare(prepare);
+    set_ftimer_prepare(prepare);
+}
+
+/*
+ * fsecs_method - The name of the timer fsecs uses
+ */
+const char *fsecs_method(void)
+{
+#if USE_FCYC
+    return "fcyc";
+#elif USE_ITIMER
+    return "itimer";
+#elif USE_GETTOD
+    return "gettimeofday";
+#endif
+}
 
+/*
+ * fsecs_mhz - The clock rate that converts fcyc cycles to seconds
+ *     (0 if the timer does not count cycles)
+ */
+double fsecs_mhz(void)
+{
+    return Mhz;
+}
@@ -2,3 +2,6 @@ typedef void (*fsecs_test_funct)(void *);
 
 void init_fsecs(void);
 double fsecs(fsecs_test_funct f, void *argp);
+void set_fsecs_prepare(fsecs_test_funct prepare);
+const char *fsecs_method(void);
+double fsecs_mhz(void);
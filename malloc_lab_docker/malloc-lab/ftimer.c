@@ -16,6 +16,9 @@
 static void init_etime(void);
 static double get_etime(void);
 
+/* run before each call of f, outside the timed region (set_ftimer_prepare) */
+static ftimer_test_funct prepare = NULL;
+
 /* 
  * ftimer_itimer - Use the interval timer to estimate the running time
  * of f(argp). Return the average of n runs.  
@@ -26,6 +29,16 @@ double ftimer_itimer(ftimer_test_funct f, void *argp, int n)
     int i;
 
     init_etime();
+    if (prepare) {		/* time the calls one at a time */
+	tmeas = 0;
+	for (i = 0; i < n; i++) {
+	    prepare(argp);
+	    start = get_etime();
+	    f(argp);
+	    tmeas += get_etime() - start;
+	}
+	return tmeas / n;
+    }
     start = get_etime();
     for (i = 0; i < n; i++) 
 	f(argp);
@@ -43,6 +56,18 @@ double ftimer_gettod(ftimer_test_funct f, void *argp, int n)
     struct timeval stv, etv;
     double diff;
 
+    if (prepare) {		/* time the calls one at a time */
+	diff = 0;
+	for (i = 0; i < n; i++) {
+	    prepare(argp);
+	    gettimeofday(&stv, NULL);
+	    f(argp);
+	    gettimeofday(&etv, NULL);
+	    diff += 1E3*(etv.tv_sec - stv.tv_sec) + 1E-3*(etv.tv_usec-stv.tv_usec);
+	}
+	diff /= n;
+	return (1E-3*diff);
+    }
     gettimeofday(&stv, NULL);
     for (i = 0; i < n; i++) 
 	f(argp);
@@ -53,6 +78,16 @@ double ftimer_gettod(ftimer_test_funct f, void *argp, int n)
 }
 
 
+/*
+ * set_ftimer_prepare - Function called with the same argument before
+ *     each call of f, outside the timed region (NULL for none). The
+ *     calls are then timed one at a time instead of as a batch.
+ */
+void set_ftimer_prepare(ftimer_test_funct prepare_arg)
+{
+    prepare = prepare_arg;
+}
+
 /*
  * Routines for manipulating the Unix interval timer
  */
@@ -12,3 +12,6 @@ double ftimer_itimer(ftimer_test_funct f, void *argp, int n);
    Return the average of n runs */
 double ftimer_gettod(ftimer_test_funct f, void *argp, int n);
 
+/* Call prepare(argp) before each call of f, untimed (NULL for none) */
+void set_ftimer_prepare(ftimer_test_funct prepare);
+
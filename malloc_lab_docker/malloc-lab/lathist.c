@@ -0,0 +1,150 @@
+/*
+ * lathist.c - Latency histograms and the calibration of lat_now.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "lathist.h"
+
+#define CAL_NSECS 20000000 /* length of the tick rate calibration (20 ms) */
+#define OVHD_TRIES 10000   /* back-to-back reads used to find the overhead */
+
+const double lat_pcts[LAT_NPCT] = {50.0, 90.0, 99.0, 99.9};
+
+static double ticks_per_ns = 0; /* set by lat_calibrate */
+
+static uint64_t mono_ns(void);
+static int bucket(uint64_t v);
+static double bucket_mid(int b);
+
+/*
+ * lat_calibrate - Measure how many lat_now ticks make a nanosecond by
+ *     comparing the counter to CLOCK_MONOTONIC over CAL_NSECS
+ */
+void lat_calibrate(void)
+{
+	uint64_t t0, t1, c0, c1;
+
+	t0 = mono_ns();
+	c0 = lat_now();
+	do
+		t1 = mono_ns();
+	while (t1 - t0 < CAL_NSECS);
+	c1 = lat_now();
+	ticks_per_ns = (double)(c1 - c0) / (double)(t1 - t0);
+}
+
+/*
+ * lat_overhead - The cost in ticks of timing an empty region, i.e. the
+ *     smallest difference between two back-to-back lat_now calls
+ */
+uint64_t lat_overhead(void)
+{
+	uint64_t t0, t1, best = UINT64_MAX;
+	int i;
+
+	for (i = 0; i < OVHD_TRIES; i++)
+	{
+		t0 = lat_now();
+		t1 = lat_now();
+		if (t1 - t0 < best)
+			best = t1 - t0;
+	}
+	return best;
+}
+
+/*
+ * lat_clear - Empty a histogram
+ */
+void lat_clear(lathist_t *h)
+{
+	memset(h, 0, sizeof(*h));
+}
+
+/*
+ * lat_add - Record one sample of ticks
+ */
+void lat_add(lathist_t *h, uint64_t ticks)
+{
+	h->count[bucket(ticks)]++;
+	h->n++;
+	if (ticks > h->max)
+		h->max = ticks;
+}
+
+/*
+ * lat_summarize - Read the percentiles and the maximum of h, in
+ *     nanoseconds, into *s
+ */
+void lat_summarize(lathist_t *h, latsum_t *s)
+{
+	uint64_t rank, seen;
+	double v, scale;
+	int b, i;
+
+	if (ticks_per_ns == 0)
+		lat_calibrate();
+	scale = 1.0 / ticks_per_ns;
+
+	memset(s, 0, sizeof(*s));
+	s->n = h->n;
+	if (h->n == 0)
+		return;
+	s->max = h->max * scale;
+	for (i = 0; i < LAT_NPCT; i++)
+	{
+		/* The smallest bucket that holds the rank'th sample */
+		rank = (uint64_t)(lat_pcts[i] / 100.0 * h->n + 0.999999);
+		if (rank == 0)
+			rank = 1;
+		for (b = 0, seen = 0; b < LAT_NBUCKETS; b++)
+			if ((seen += h->count[b]) >= rank)
+				break;
+		v = bucket_mid(b);
+		s->pct[i] = ((v < h->max) ? v : h->max) * scale;
+	}
+}
+
+/*
+ * bucket - The histogram bucket of v. Values below LAT_SUB get a bucket
+ *     each; above that, every power of two gets LAT_SUB buckets.
+ */
+static int bucket(uint64_t v)
+{
+	int e;
+
+	if (v < LAT_SUB)
+		return (int)v;
+	e = 63 - __builtin_clzll(v);
+	return (e - LAT_SUBBITS + 1) * LAT_SUB +
+		   (int)((v >> (e - LAT_SUBBITS)) & (LAT_SUB - 1));
+}
+
+/*
+ * bucket_mid - The middle of the range of values that fall in bucket b
+ */
+static double bucket_mid(int b)
+{
+	int e, sub;
+	double lo, width;
+
+	if (b < LAT_SUB)
+		return b;
+	e = b / LAT_SUB - 1 + LAT_SUBBITS;
+	sub = b % LAT_SUB;
+	width = (double)((uint64_t)1 << (e - LAT_SUBBITS));
+	lo = (LAT_SUB + sub) * width;
+	return lo + (width - 1) / 2;
+}
+
+/*
+ * mono_ns - CLOCK_MONOTONIC in nanoseconds
+ */
+static uint64_t mono_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
@@ -0,0 +1,51 @@
+/*
+ * lathist.h - Log-bucketed latency histograms for per-operation timing
+ *             (mdriver -L).
+ *
+ * Samples are raw ticks of a cheap counter (lat_now). Each power of two
+ * is split into LAT_SUB linear sub-buckets, so a percentile read back
+ * from a histogram is within 1/LAT_SUB of the true value.
+ */
+#ifndef __LATHIST_H_
+#define __LATHIST_H_
+
+#include <stdint.h>
+
+#include "clock.h"
+
+#define LAT_SUBBITS 3					/* log2 of the sub-buckets per power of 2 */
+#define LAT_SUB (1 << LAT_SUBBITS)
+#define LAT_NBUCKETS (64 * LAT_SUB)
+
+typedef struct
+{
+	uint64_t count[LAT_NBUCKETS];
+	uint64_t n;	  /* number of samples */
+	uint64_t max; /* largest sample */
+} lathist_t;
+
+/* Percentiles reported by lat_summarize */
+#define LAT_NPCT 4
+extern const double lat_pcts[LAT_NPCT]; /* 50, 90, 99, 99.9 */
+
+/* A histogram boiled down to nanoseconds */
+typedef struct
+{
+	uint64_t n;
+	double pct[LAT_NPCT];
+	double max;
+} latsum_t;
+
+/* lat_now - Read the cycle counter (see read_counter in clock.h) */
+static inline uint64_t lat_now(void)
+{
+	return read_counter();
+}
+
+void lat_calibrate(void);
+uint64_t lat_overhead(void);
+void lat_clear(lathist_t *h);
+void lat_add(lathist_t *h, uint64_t ticks);
+void lat_summarize(lathist_t *h, latsum_t *s);
+
+#endif /* __LATHIST_H_ */
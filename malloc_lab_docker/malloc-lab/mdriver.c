@@ -7,14 +7,24 @@
  * Copyright (c) 2002, R. Bryant and D. O'Hallaron, All rights reserved.
  * May not be used, modified, or copied without permission.
  */
+#define _GNU_SOURCE /* sched_setaffinity */
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <errno.h>
+#include <getopt.h>
+#include <math.h>
 #include <string.h>
 #include <assert.h>
 #include <float.h>
+#include <stdint.h>
 #include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <sched.h>
 
 extern char *optarg; // Added declaration for optarg
 
@@ -22,6 +32,15 @@ extern char *optarg; // Added declaration for optarg
 #include "memlib.h"
 #include "fsecs.h"
 #include "config.h"
+#include "trace.h"
+#include "tstream.h"
+#include "mthread.h"
+#include "lathist.h"
+#include "perfctr.h"
+#include "results.h"
+#include "nullmm.h"
+#include "mmdl.h"
+#include "cachesim.h"
 
 /**********************
  * Constants and macros
@@ -31,47 +50,73 @@ extern char *optarg; // Added declaration for optarg
 #define MAXLINE 1024	   /* max string size */
 #define HDRLINES 4		   /* number of header lines in a trace file */
 #define LINENUM(i) (i + 5) /* cnvt trace request nums to linenums (origin 1) */
+#define COLD_PHASE 4	   /* cold start = first 1/COLD_PHASE of the ops */
+#define RANGE_BLOCK 1024   /* range records allocated at a time */
+#define MT_REPS 10		   /* passes over each trace in a threaded replay (-T) */
+#define LAT_NCLASSES 4	   /* request size classes of the latency histograms (-L) */
+#define STEADY_FORKS 5	   /* children per timing with --steady-fork (best one counts) */
+#define CI_Z 1.96		   /* normal quantile of the 95% confidence intervals */
+#define AB_ROUNDS 11	   /* least timing rounds per trace with --ab */
+
+/* Backend replayed by default; "make mdriver-seg" builds one defaulting to seg */
+#ifndef DEFAULT_BACKEND
+#define DEFAULT_BACKEND "mm"
+#endif
 
 /* Returns true if p is ALIGNMENT-byte aligned */
-#define IS_ALIGNED(p) ((((unsigned int)(p)) % ALIGNMENT) == 0)
+#define IS_ALIGNED(p) (((uintptr_t)(p) % ALIGNMENT) == 0)
+
+/*
+ * Replays requests lo..hi-1 of trace with the given malloc, realloc and
+ * free. The timed mm, libc and null allocator (--calibrate) replays all
+ * expand this one loop, so they differ only in the functions they call.
+ */
+#define REPLAY(trace, lo, hi, malloc_fn, realloc_fn, free_fn)               \
+	do                                                                      \
+	{                                                                       \
+		long i_;                                                            \
+		char *p_;                                                           \
+                                                                            \
+		for (i_ = (lo); i_ < (hi); i_++)                                    \
+			switch ((trace)->ops[i_].type)                                  \
+			{                                                               \
+			case ALLOC:                                                     \
+				if ((p_ = malloc_fn((trace)->ops[i_].size)) == NULL)        \
+					app_error(#malloc_fn " failed in a timed replay");      \
+				(trace)->blocks[(trace)->ops[i_].index] = p_;               \
+				break;                                                      \
+			case REALLOC:                                                   \
+				p_ = realloc_fn((trace)->blocks[(trace)->ops[i_].index],    \
+							 (trace)->ops[i_].size);                        \
+				if (p_ == NULL)                                             \
+					app_error(#realloc_fn " failed in a timed replay");     \
+				(trace)->blocks[(trace)->ops[i_].index] = p_;               \
+				break;                                                      \
+			case FREE:                                                      \
+				free_fn((trace)->blocks[(trace)->ops[i_].index]);           \
+				break;                                                      \
+			default:                                                        \
+				app_error("Nonexistent request type in a timed replay");    \
+			}                                                               \
+	} while (0)
 
 /******************************
  * The key compound data types
  *****************************/
 
-/* Records the extent of each block's payload */
+/*
+ * Records the extent of each block's payload. The records form a treap
+ * (a randomized balanced search tree) ordered by payload address.
+ */
 typedef struct range_t
 {
-	char *lo;			  /* low payload address */
-	char *hi;			  /* high payload address */
-	struct range_t *next; /* next list element */
+	char *lo;			   /* low payload address */
+	char *hi;			   /* high payload address */
+	unsigned prio;		   /* random heap priority that keeps the tree balanced */
+	struct range_t *left;  /* payloads at lower addresses */
+	struct range_t *right; /* payloads at higher addresses (also free list link) */
 } range_t;
 
-/* Characterizes a single trace operation (allocator request) */
-typedef struct
-{
-	enum
-	{
-		ALLOC,
-		FREE,
-		REALLOC
-	} type;	   /* type of request */
-	int index; /* index for free() to use later */
-	int size;  /* byte size of alloc/realloc request */
-} traceop_t;
-
-/* Holds the information for one trace file*/
-typedef struct
-{
-	int sugg_heapsize;	 /* suggested heap size (unused) */
-	int num_ids;		 /* number of alloc/realloc ids */
-	int num_ops;		 /* number of distinct requests */
-	int weight;			 /* weight for this trace (unused) */
-	traceop_t *ops;		 /* array of requests */
-	char **blocks;		 /* array of ptrs returned by malloc/realloc... */
-	size_t *block_sizes; /* ... and a corresponding array of payload sizes */
-} trace_t;
-
 /*
  * Holds the params to the xxx_speed functions, which are timed by fcyc.
  * This struct is necessary because fcyc accepts only a pointer array
@@ -81,21 +126,77 @@ typedef struct
 {
 	trace_t *trace;
 	range_t *ranges;
+	long first_op;		 /* first op of the timed window (--steady) */
+	char **saved_blocks; /* trace->blocks at first_op (--steady) */
+	mmdl_t *lib;		 /* allocator library being timed (--ab) */
 } speed_t;
 
-/* Summarizes the important stats for some malloc function on some trace */
+/* Cost of the cold-start phase of a trace (for the -H option) */
+typedef struct
+{
+	size_t sbrks; /* number of mem_sbrk calls */
+	long faults;  /* number of minor page faults */
+} coldstat_t;
+
+/* Bookkeeping of a streamed replay (for the -S option) */
 typedef struct
 {
-	/* defined for both libc malloc and student malloc package (mm.c) */
-	double ops;	 /* number of ops (malloc/free/realloc) in the trace */
-	int valid;	 /* was the trace processed correctly by the allocator? */
-	double secs; /* number of secs needed to run the trace */
+	size_t max_live;  /* largest number of live ids */
+	size_t map_bytes; /* final size of the id table */
+	long skipped;	  /* frees of unknown ids and reused live ids */
+} streamstat_t;
 
-	/* defined only for the student malloc package */
-	double util; /* space utilization for this trace (always 0 for libc) */
+/* Per-op latency of a trace, by request type and size class (-L) */
+typedef struct
+{
+	latsum_t s[3][LAT_NCLASSES]; /* indexed by ALLOC/FREE/REALLOC */
+} latstat_t;
+
+/* One sample of the heap taken by eval_mm_util (-U) */
+typedef struct
+{
+	long op;			 /* ops done when the sample was taken */
+	size_t live;		 /* live payload bytes */
+	size_t heap;		 /* heap size (mem_heapsize) */
+	mm_heapstats_t free; /* free blocks, if mm.c has mm_heapstats */
+} tlsample_t;
+
+/* Summary of the heap timeline of a trace (-U) */
+typedef struct
+{
+	long samples;
+	size_t max_waste;		/* largest heap - live */
+	size_t max_free_blocks; /* most free blocks at once */
+	double max_frag;		/* worst 1 - largest free / free bytes */
+	size_t end_largest;		/* largest free block at the end */
+} tlstat_t;
+
+/* Head-to-head result of a trace (--ab) */
+typedef struct
+{
+	double ratio;	 /* median of B's time / A's time over the rounds */
+	double ratio_lo; /* 95% confidence interval of that median */
+	double ratio_hi;
+} abstat_t;
+
+/*
+ * An allocator backend (-A): its operations table, and the replay loop
+ * the timings run, which calls the backend's functions directly rather
+ * than through the table
+ */
+typedef struct
+{
+	const mm_ops_t *ops;
+	void (*replay)(trace_t *trace, long lo, long hi);
+} backend_t;
 
-	/* Note: secs and util are only defined if valid is true */
-} stats_t;
+/* How mm_init_hint is fed a heap size hint (-H option) */
+enum
+{
+	HINT_NONE, /* always call plain mm_init */
+	HINT_SUGG, /* the sugg_heapsize from the trace header */
+	HINT_PEAK  /* the peak live payload measured by eval_mm_util */
+};
 
 /********************
  * Global variables
@@ -104,6 +205,31 @@ int verbose = 0;	   /* global flag for verbose output */
 static int errors = 0; /* number of errs found when running student malloc */
 char msg[MAXLINE];	   /* for whenever we need to compose an error message */
 
+static int hint_mode = HINT_NONE; /* source of heap size hints (-H) */
+static int stream_mode = 0;		  /* stream traces instead of loading them (-S) */
+static int max_threads = 0;		  /* threaded replays with 1..max_threads threads (-T) */
+static int num_jobs = 1;		  /* worker processes evaluating traces (-j) */
+static int lat_mode = 0;		  /* measure per-op latency histograms (-L) */
+static int perf_mode = 0;		  /* count hardware events in the timed runs (-P) */
+static int cachesim_mode = 0;	  /* simulate the metadata accesses (--cachesim) */
+static int num_reps = 1;		  /* timings of each trace (-R) */
+static double steady_pct = 0;	  /* warm-up prefix, in % of each trace (--steady) */
+static int steady_fork = 0;		  /* fork at the end of the prefix (--steady-fork) */
+static int num_warmup = 0;		  /* untimed runs before the timed ones (--warmup) */
+static int calibrate = 0;		  /* subtract the replay loop's own time (--calibrate) */
+static int cpu_pin = -1;		  /* CPU the timings run on, or -1 (--cpu) */
+static cpu_set_t orig_cpus;		  /* CPUs allowed before --cpu pinned the driver */
+static char *ab_libs[2] = {NULL, NULL}; /* allocator libraries A and B (--ab) */
+static long speed_runs = 0;		  /* calls of eval_mm_speed so far */
+static long tl_every = 0;		  /* sample the heap every tl_every ops (-U) */
+static char *tl_file = NULL;	  /* CSV file for the heap samples (--timeline) */
+
+static tlsample_t *tl_samples = NULL; /* samples of the current trace */
+static long tl_n = 0, tl_cap = 0;	  /* used and allocated samples */
+
+static range_t *free_ranges = NULL; /* pool of unused range records */
+static unsigned range_seed = 1;		/* state of the treap priority generator */
+
 /* Directory where default tracefiles are found */
 static char tracedir[MAXLINE] = TRACEDIR;
 
@@ -115,32 +241,107 @@ static char *default_tracefiles[] = {
  * Function prototypes
  *********************/
 
-/* these functions manipulate range lists */
+/* these functions manipulate the range tree */
 static int add_range(range_t **ranges, char *lo, int size,
 					 int tracenum, int opnum);
 static void remove_range(range_t **ranges, char *lo);
 static void clear_ranges(range_t **ranges);
-
-/* These functions read, allocate, and free storage for traces */
-static trace_t *read_trace(char *tracedir, char *filename);
-static void free_trace(trace_t *trace);
+static range_t *new_range(void);
+static range_t *insert_range(range_t *root, range_t *r);
+static range_t *merge_ranges(range_t *a, range_t *b);
+static int filled_with(const char *p, int c, int n);
 
 /* Routines for evaluating the correctness and speed of libc malloc */
 static int eval_libc_valid(trace_t *trace, int tracenum);
 static void eval_libc_speed(void *ptr);
+static void eval_null_speed(void *ptr);
 
 /* Routines for evaluating correctnes, space utilization, and speed
    of the student's malloc package in mm.c */
 static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges);
-static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges);
+static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges,
+						   stats_t *stats);
+static void touch_payload(char *p, int size);
+static void tl_sample(long op, size_t live);
+static void tl_finish(char *tracefile, int tracenum, tlstat_t *tl);
+static void print_timeline(int n, tlstat_t *tl);
 static void eval_mm_speed(void *ptr);
+static void replay_mm(trace_t *trace, long lo, long hi);
+static void replay_seg(trace_t *trace, long lo, long hi);
+static void replay_sdfs(trace_t *trace, long lo, long hi);
+static void replay_libc(trace_t *trace, long lo, long hi);
+static int libc_init(void);
+static const backend_t *find_backend(const char *name);
+static void time_mm(trace_t *trace, range_t *ranges, stats_t *stats,
+					pcstat_t *pc);
+static void steady_restore(void *ptr);
+static void time_steady_fork(speed_t *params, stats_t *stats, pcstat_t *pc);
+static size_t heap_hint(trace_t *trace);
+static int init_mm(trace_t *trace);
+static void eval_mm_coldstart(trace_t *trace, size_t hint,
+							  coldstat_t *init, coldstat_t *phase);
+static void print_coldstart(int n, coldstat_t *cold);
+static void eval_mm_stream(char *filename, int tracenum,
+						   stats_t *stats, streamstat_t *ss);
+static void print_stream(int n, streamstat_t *ss);
+static void eval_mm_trace(char *tracefile, int tracenum, range_t **ranges,
+						  stats_t *stats, coldstat_t *cold, streamstat_t *ss,
+						  latstat_t *lat, pcstat_t *pc, tlstat_t *tl,
+						  csstat_t *cs);
+static void eval_mm_jobs(char **tracefiles, int n, stats_t *stats,
+						 coldstat_t *cold, streamstat_t *ss, latstat_t *lat,
+						 pcstat_t *pc, tlstat_t *tl, csstat_t *cs);
+static void eval_mm_latency(trace_t *trace, latstat_t *lat);
+static int lat_class(size_t size);
+static void print_latency(int n, latstat_t *lat);
+static void print_perfctr(int n, stats_t *stats, pcstat_t *pc);
+static void print_pcrow(pcstat_t *pc, double ops);
+static void eval_mm_cachesim(trace_t *trace, csstat_t *cs);
+static void print_cachesim(int n, stats_t *stats, csstat_t *cs);
+static void retime_mm(char **tracefiles, int n, range_t **ranges, stats_t *stats);
+static int read_full(int fd, void *buf, size_t n);
+static int write_full(int fd, const void *buf, size_t n);
+static void eval_scaling(char **tracefiles, int n, int run_libc);
+static void print_scaling(const mt_alloc_t *a, mt_result_t *res);
+static int mm_init_threadsafe(void);
+static void eval_ab(char **tracefiles, int n);
+static int eval_ab_util(mmdl_t *lib, trace_t *trace, int tracenum, double *util);
+static void eval_ab_speed(void *ptr);
+static void print_ab(int n, mmdl_t *lib, stats_t **stats, abstat_t *ab,
+					 int rounds);
 
 /* Various helper routines */
 static void printresults(int n, stats_t *stats);
+static void print_pct(double frac);
+static void time_speed(fsecs_test_funct f, speed_t *params, stats_t *stats);
+static void summarize_times(double *t, int n, stats_t *stats);
+static void median_ci(double *t, int n, double *med, double *lo, double *hi);
+static int cmp_double(const void *a, const void *b);
+static void calibrate_speed(speed_t *params, stats_t *stats);
+static void pin_to_cpu(int cpu);
 static void usage(void);
 static void unix_error(char *msg);
 static void malloc_error(int tracenum, int opnum, char *msg);
 static void app_error(char *msg);
+static double now_secs(void);
+
+/*********************
+ * Allocator backends
+ ********************/
+
+/* libc malloc as a backend: nothing to set up, and no heap of its own */
+static const mm_ops_t libc_ops = {
+	"libc", libc_init, malloc, free, realloc, NULL, NULL, NULL, 0};
+
+/* Backends selectable with -A */
+static const backend_t backends[] = {
+	{&mm_ops, replay_mm},
+	{&seg_ops, replay_seg},
+	{&sdfs_ops, replay_sdfs},
+	{&libc_ops, replay_libc}};
+
+static const mm_ops_t *mmops = &mm_ops; /* allocator under test (-A) */
+static void (*mm_replay)(trace_t *, long, long) = replay_mm; /* its replay loop */
 
 /**************
  * Main routine
@@ -155,20 +356,70 @@ int main(int argc, char **argv)
 	range_t *ranges = NULL;		/* keeps track of block extents for one trace */
 	stats_t *libc_stats = NULL; /* libc stats for each trace */
 	stats_t *mm_stats = NULL;	/* mm (i.e. student) stats for each trace */
+	coldstat_t *cold = NULL;	/* cold-start costs for each trace (-H) */
+	streamstat_t *sstats = NULL; /* streaming bookkeeping for each trace (-S) */
+	latstat_t *lat = NULL;		 /* per-op latency for each trace (-L) */
+	pcstat_t *libc_pc = NULL;	 /* libc hardware counts for each trace (-P) */
+	pcstat_t *mm_pc = NULL;		 /* mm hardware counts for each trace (-P) */
+	csstat_t *cs = NULL;		 /* simulated cache misses for each trace (--cachesim) */
+	char *cs_spec = "";			 /* cache geometry (--cachesim=spec) */
+	tlstat_t *tl = NULL;		 /* heap timeline summary for each trace (-U) */
 	speed_t speed_params;		/* input parameters to the xx_speed routines */
 
 	int team_check = 1; /* If set, check team structure (reset by -a) */
 	int run_libc = 0;	/* If set, run libc malloc (set by -l) */
 	int autograder = 0; /* If set, emit summary info for autograder (-g) */
+	int retime = 0;		/* If set, re-time -j results serially (-s) */
+	char *json_file = NULL;	   /* write the results as JSON (--json) */
+	char *csv_file = NULL;	   /* write the results as CSV (--csv) */
+	char *baseline = NULL;	   /* compare against a JSON baseline (--compare) */
+	double threshold = 5.0;	   /* regression threshold in percent (--threshold) */
+	char *backend = DEFAULT_BACKEND; /* allocator to evaluate (-A) */
+	const backend_t *be;
+	int regressed = 0;		   /* traces that regressed against the baseline */
+	runinfo_t info;
+
+	/* Long-only options */
+	enum
+	{
+		OPT_JSON = 256,
+		OPT_CSV,
+		OPT_COMPARE,
+		OPT_THRESHOLD,
+		OPT_TIMELINE,
+		OPT_STEADY,
+		OPT_STEADY_FORK,
+		OPT_WARMUP,
+		OPT_CALIBRATE,
+		OPT_CPU,
+		OPT_AB,
+		OPT_CACHESIM
+	};
+	static struct option long_opts[] = {
+		{"json", required_argument, NULL, OPT_JSON},
+		{"csv", required_argument, NULL, OPT_CSV},
+		{"compare", required_argument, NULL, OPT_COMPARE},
+		{"threshold", required_argument, NULL, OPT_THRESHOLD},
+		{"reps", required_argument, NULL, 'R'},
+		{"timeline", required_argument, NULL, OPT_TIMELINE},
+		{"steady", required_argument, NULL, OPT_STEADY},
+		{"steady-fork", no_argument, NULL, OPT_STEADY_FORK},
+		{"warmup", required_argument, NULL, OPT_WARMUP},
+		{"calibrate", no_argument, NULL, OPT_CALIBRATE},
+		{"cpu", required_argument, NULL, OPT_CPU},
+		{"ab", required_argument, NULL, OPT_AB},
+		{"cachesim", optional_argument, NULL, OPT_CACHESIM},
+		{NULL, 0, NULL, 0}};
 
 	/* temporaries used to compute the performance index */
-	double secs, ops, util, avg_mm_util, avg_mm_throughput, p1, p2, perfindex;
+	double secs, p1, p2, perfindex;
 	int numcorrect;
 
 	/*
 	 * Read and interpret the command line arguments
 	 */
-	while ((c = getopt(argc, argv, "f:t:hvVgal")) != EOF)
+	while ((c = getopt_long(argc, argv, "f:t:hvVgalA:H:ST:j:sLPR:U:",
+							long_opts, NULL)) != EOF)
 	{
 		printf("getopt returned: %d\n", c); // 디버깅용 출력 추가
 
@@ -198,6 +449,121 @@ int main(int argc, char **argv)
 		case 'l': /* Run libc malloc */
 			run_libc = 1;
 			break;
+		case 'A': /* Evaluate this backend instead of mm.c */
+			backend = optarg;
+			break;
+		case 'H': /* Pre-size the heap with mm_init_hint */
+			if (!strcmp(optarg, "sugg"))
+				hint_mode = HINT_SUGG;
+			else if (!strcmp(optarg, "peak"))
+				hint_mode = HINT_PEAK;
+			else
+			{
+				usage();
+				exit(1);
+			}
+			break;
+		case 'j': /* Evaluate the traces in this many processes */
+			if ((num_jobs = atoi(optarg)) < 1)
+			{
+				usage();
+				exit(1);
+			}
+			break;
+		case 'R': /* Time each trace this many times */
+			if ((num_reps = atoi(optarg)) < 1)
+			{
+				usage();
+				exit(1);
+			}
+			break;
+		case OPT_JSON: /* Write the results as JSON */
+			json_file = optarg;
+			break;
+		case OPT_CSV: /* Write the results as CSV */
+			csv_file = optarg;
+			break;
+		case OPT_COMPARE: /* Flag regressions against a JSON baseline */
+			baseline = optarg;
+			break;
+		case OPT_THRESHOLD: /* Smallest change that counts as a regression */
+			if ((threshold = atof(optarg)) <= 0)
+			{
+				usage();
+				exit(1);
+			}
+			break;
+		case 'U': /* Sample the heap every this many ops */
+			if ((tl_every = atol(optarg)) < 1)
+			{
+				usage();
+				exit(1);
+			}
+			break;
+		case OPT_TIMELINE: /* Write the heap samples as CSV */
+			tl_file = optarg;
+			break;
+		case OPT_STEADY: /* Time only what follows a warm-up prefix */
+			steady_pct = atof(optarg);
+			if (steady_pct <= 0 || steady_pct >= 100)
+			{
+				usage();
+				exit(1);
+			}
+			break;
+		case OPT_STEADY_FORK: /* Fork at the end of the prefix instead */
+			steady_fork = 1;
+			break;
+		case OPT_WARMUP: /* Untimed runs of each trace before the timed ones */
+			if ((num_warmup = atoi(optarg)) < 0)
+			{
+				usage();
+				exit(1);
+			}
+			break;
+		case OPT_CALIBRATE: /* Subtract the cost of the replay loop */
+			calibrate = 1;
+			break;
+		case OPT_CPU: /* Run the timings on this CPU */
+			if ((cpu_pin = atoi(optarg)) < 0)
+			{
+				usage();
+				exit(1);
+			}
+			break;
+		case OPT_AB: /* Compare two allocator libraries head to head */
+			ab_libs[0] = strdup(optarg);
+			if ((ab_libs[1] = strchr(ab_libs[0], ',')) == NULL)
+			{
+				usage();
+				exit(1);
+			}
+			*ab_libs[1]++ = '\0';
+			break;
+		case OPT_CACHESIM: /* Simulate the caches on the metadata accesses */
+			cachesim_mode = 1;
+			if (optarg != NULL)
+				cs_spec = optarg;
+			break;
+		case 's': /* Re-measure -j throughput one trace at a time */
+			retime = 1;
+			break;
+		case 'L': /* Per-op latency histograms */
+			lat_mode = 1;
+			break;
+		case 'P': /* Hardware performance counters */
+			perf_mode = 1;
+			break;
+		case 'S': /* Stream the traces instead of loading them */
+			stream_mode = 1;
+			break;
+		case 'T': /* Measure scaling with up to this many threads */
+			if ((max_threads = atoi(optarg)) < 1)
+			{
+				usage();
+				exit(1);
+			}
+			break;
 		case 'v': /* Print per-trace performance breakdown */
 			verbose = 1;
 			break;
@@ -213,6 +579,26 @@ int main(int argc, char **argv)
 		}
 	}
 
+	/* Select the allocator backend */
+	if ((be = find_backend(backend)) == NULL)
+	{
+		printf("Unknown backend %s, choose one of:", backend);
+		for (i = 0; i < (int)(sizeof(backends) / sizeof(backends[0])); i++)
+			printf(" %s", backends[i].ops->name);
+		printf("\n");
+		exit(1);
+	}
+	mmops = be->ops;
+	mm_replay = be->replay;
+	if (steady_pct > 0 && !steady_fork && !(mmops->flags & MM_OPS_INHEAP))
+	{
+		/* A heap checkpoint would miss the state kept outside the heap */
+		if (verbose)
+			printf("%s keeps state outside the heap, using --steady-fork\n",
+				   mmops->name);
+		steady_fork = 1;
+	}
+
 	/*
 	 * Check and print team info
 	 */
@@ -257,6 +643,53 @@ int main(int argc, char **argv)
 
 	/* Initialize the timing package */
 	init_fsecs();
+	if (perf_mode && pc_open() == 0)
+	{
+		printf("Hardware counters unavailable (%s), ignoring -P\n", pc_error());
+		perf_mode = 0;
+	}
+	if (cachesim_mode && cs_configure(cs_spec) < 0)
+	{
+		printf("Bad cache geometry %s\n", cs_spec);
+		usage();
+		exit(1);
+	}
+#ifndef MM_CACHESIM
+	if (cachesim_mode)
+	{
+		printf("No cache simulator in this build (make mdriver-cachesim), "
+			   "ignoring --cachesim\n");
+		cachesim_mode = 0;
+	}
+#endif
+	if (steady_fork && steady_pct == 0)
+		steady_pct = 50;
+	if (verbose && steady_pct > 0)
+		printf("Timing the last %.0f%% of each mm trace, from a %s after the rest.\n",
+			   100 - steady_pct, steady_fork ? "fork" : "heap checkpoint");
+	if (cpu_pin >= 0)
+	{
+		if (sched_getaffinity(0, sizeof(orig_cpus), &orig_cpus) < 0)
+			unix_error("sched_getaffinity failed");
+		pin_to_cpu(cpu_pin);
+	}
+	if (verbose && (calibrate || num_reps > 1 || num_warmup > 0 || cpu_pin >= 0))
+	{
+		printf("Timing: median of %d run%s after %d warm-up run%s", num_reps,
+			   num_reps > 1 ? "s" : "", num_warmup, num_warmup != 1 ? "s" : "");
+		if (cpu_pin >= 0)
+			printf(", on CPU %d", cpu_pin);
+		printf("%s.\n", calibrate ? ", less the null allocator's time" : "");
+	}
+	speed_params.first_op = 0;
+	speed_params.saved_blocks = NULL;
+
+	/* --ab replaces the usual evaluation */
+	if (ab_libs[0] != NULL)
+	{
+		eval_ab(tracefiles, num_tracefiles);
+		exit(errors ? 1 : 0);
+	}
 
 	/*
 	 * Optionally run and evaluate the libc malloc package
@@ -270,21 +703,32 @@ int main(int argc, char **argv)
 		libc_stats = (stats_t *)calloc(num_tracefiles, sizeof(stats_t));
 		if (libc_stats == NULL)
 			unix_error("libc_stats calloc in main failed");
+		if (perf_mode &&
+			(libc_pc = (pcstat_t *)calloc(num_tracefiles, sizeof(pcstat_t))) == NULL)
+			unix_error("libc_pc calloc in main failed");
 
 		/* Evaluate the libc malloc package using the K-best scheme */
 		for (i = 0; i < num_tracefiles; i++)
 		{
+			if (verbose > 1)
+				printf("Reading tracefile: %s\n", tracefiles[i]);
 			trace = read_trace(tracedir, tracefiles[i]);
 			libc_stats[i].ops = trace->num_ops;
 			if (verbose > 1)
 				printf("Checking libc malloc for correctness, ");
+			secs = now_secs();
 			libc_stats[i].valid = eval_libc_valid(trace, i);
+			libc_stats[i].valid_secs = now_secs() - secs;
 			if (libc_stats[i].valid)
 			{
 				speed_params.trace = trace;
 				if (verbose > 1)
 					printf("and performance.\n");
-				libc_stats[i].secs = fsecs(eval_libc_speed, &speed_params);
+				time_speed(eval_libc_speed, &speed_params, &libc_stats[i]);
+				if (libc_pc != NULL)
+					pc_measure(eval_libc_speed, &speed_params, &libc_pc[i]);
+				if (calibrate)
+					calibrate_speed(&speed_params, &libc_stats[i]);
 			}
 			free_trace(trace);
 		}
@@ -295,6 +739,8 @@ int main(int argc, char **argv)
 			printf("\nResults for libc malloc:\n");
 			printresults(num_tracefiles, libc_stats);
 		}
+		if (libc_pc != NULL)
+			print_perfctr(num_tracefiles, libc_stats, libc_pc);
 	}
 
 	/*
@@ -307,79 +753,99 @@ int main(int argc, char **argv)
 	mm_stats = (stats_t *)calloc(num_tracefiles, sizeof(stats_t));
 	if (mm_stats == NULL)
 		unix_error("mm_stats calloc in main failed");
+	if (stream_mode &&
+		(sstats = (streamstat_t *)calloc(num_tracefiles, sizeof(streamstat_t))) == NULL)
+		unix_error("sstats calloc in main failed");
+	if (lat_mode && !stream_mode &&
+		(lat = (latstat_t *)calloc(num_tracefiles, sizeof(latstat_t))) == NULL)
+		unix_error("lat calloc in main failed");
+	if (perf_mode && !stream_mode &&
+		(mm_pc = (pcstat_t *)calloc(num_tracefiles, sizeof(pcstat_t))) == NULL)
+		unix_error("mm_pc calloc in main failed");
+	if (cachesim_mode && !stream_mode &&
+		(cs = (csstat_t *)calloc(num_tracefiles, sizeof(csstat_t))) == NULL)
+		unix_error("cs calloc in main failed");
+	if (tl_file != NULL && tl_every == 0)
+		tl_every = 100;
+	if (tl_every > 0 && !stream_mode &&
+		(tl = (tlstat_t *)calloc(num_tracefiles, sizeof(tlstat_t))) == NULL)
+		unix_error("tl calloc in main failed");
+	if (tl != NULL && tl_file != NULL)
+	{
+		FILE *fp;
+
+		if ((fp = fopen(tl_file, "w")) == NULL)
+			unix_error("Could not create the --timeline file");
+		fprintf(fp, "trace,file,op,live,heap,util,free_blocks,free_bytes,largest_free\n");
+		fclose(fp);
+	}
+	if (hint_mode != HINT_NONE && verbose && !stream_mode && /* only printed with -v */
+		(cold = (coldstat_t *)calloc(3 * num_tracefiles, sizeof(coldstat_t))) == NULL)
+		unix_error("cold calloc in main failed");
 
 	/* Initialize the simulated memory system in memlib.c */
+	if (max_threads > 1) /* room for one copy of a trace per thread */
+		mem_set_maxheap((size_t)max_threads * MAX_HEAP);
 	mem_init();
 
 	/* Evaluate student's mm malloc package using the K-best scheme */
-	for (i = 0; i < num_tracefiles; i++)
-	{
-		trace = read_trace(tracedir, tracefiles[i]);
-		mm_stats[i].ops = trace->num_ops;
-		if (verbose > 1)
-			printf("Checking mm_malloc for correctness, ");
-		mm_stats[i].valid = eval_mm_valid(trace, i, &ranges);
-		if (mm_stats[i].valid)
-		{
-			if (verbose > 1)
-				printf("efficiency, ");
-			mm_stats[i].util = eval_mm_util(trace, i, &ranges);
-			speed_params.trace = trace;
-			speed_params.ranges = ranges;
-			if (verbose > 1)
-				printf("and performance.\n");
-			mm_stats[i].secs = fsecs(eval_mm_speed, &speed_params);
-		}
-		free_trace(trace);
-	}
+	if (num_jobs > 1)
+		eval_mm_jobs(tracefiles, num_tracefiles, mm_stats, cold, sstats, lat,
+					 mm_pc, tl, cs);
+	else
+		for (i = 0; i < num_tracefiles; i++)
+			eval_mm_trace(tracefiles[i], i, &ranges, &mm_stats[i],
+						  cold ? &cold[3 * i] : NULL, sstats ? &sstats[i] : NULL,
+						  lat ? &lat[i] : NULL, mm_pc ? &mm_pc[i] : NULL,
+						  tl ? &tl[i] : NULL, cs ? &cs[i] : NULL);
+	if (num_jobs > 1 && retime)
+		retime_mm(tracefiles, num_tracefiles, &ranges, mm_stats);
 
 	/* Display the mm results in a compact table */
 	if (verbose)
 	{
-		printf("\nResults for mm malloc:\n");
+		printf("\nResults for %s malloc:\n", mmops->name);
 		printresults(num_tracefiles, mm_stats);
+		if (cold != NULL)
+			print_coldstart(num_tracefiles, cold);
+		if (sstats != NULL)
+			print_stream(num_tracefiles, sstats);
+		if (tl != NULL)
+			print_timeline(num_tracefiles, tl);
 		printf("\n");
 	}
+	if (lat != NULL)
+		print_latency(num_tracefiles, lat);
+	if (mm_pc != NULL)
+		print_perfctr(num_tracefiles, mm_stats, mm_pc);
+	if (cs != NULL)
+		print_cachesim(num_tracefiles, mm_stats, cs);
+
+	/* Optionally measure how the allocators scale with threads */
+	if (max_threads > 0)
+	{
+		if (cpu_pin >= 0) /* let the threads spread out again */
+			sched_setaffinity(0, sizeof(orig_cpus), &orig_cpus);
+		eval_scaling(tracefiles, num_tracefiles, run_libc);
+	}
 
 	/*
-	 * Accumulate the aggregate statistics for the student's mm package
+	 * Compute and print the performance index
 	 */
-	secs = 0;
-	ops = 0;
-	util = 0;
 	numcorrect = 0;
 	for (i = 0; i < num_tracefiles; i++)
-	{
-		secs += mm_stats[i].secs;
-		ops += mm_stats[i].ops;
-		util += mm_stats[i].util;
 		if (mm_stats[i].valid)
 			numcorrect++;
+	if (errors == 0 && !(mmops->flags & MM_OPS_MEMLIB))
+	{ /* No util to score without a memlib heap (-A libc) */
+		perfindex = 0.0;
 	}
-	avg_mm_util = util / num_tracefiles;
-
-	/*
-	 * Compute and print the performance index
-	 */
-	if (errors == 0)
+	else if (errors == 0)
 	{
-		avg_mm_throughput = ops / secs;
-
-		p1 = UTIL_WEIGHT * avg_mm_util;
-		if (avg_mm_throughput > AVG_LIBC_THRUPUT)
-		{
-			p2 = (double)(1.0 - UTIL_WEIGHT);
-		}
-		else
-		{
-			p2 = ((double)(1.0 - UTIL_WEIGHT)) *
-				 (avg_mm_throughput / AVG_LIBC_THRUPUT);
-		}
-
-		perfindex = (p1 + p2) * 100.0;
+		perfindex = perf_index(num_tracefiles, mm_stats, &p1, &p2);
 		printf("Perf index = %.0f (util) + %.0f (thru) = %.0f/100\n",
-			   p1 * 100,
-			   p2 * 100,
+			   p1,
+			   p2,
 			   perfindex);
 	}
 	else
@@ -388,32 +854,52 @@ int main(int argc, char **argv)
 		printf("Terminated with %d errors\n", errors);
 	}
 
+	/* Machine-readable results and the comparison with a baseline */
+	info.timer = fsecs_method();
+	info.mhz = fsecs_mhz();
+	info.jobs = num_jobs;
+	info.perfindex = -1; /* null in --json: errors, or nothing to score */
+	if (errors == 0 && (mmops->flags & MM_OPS_MEMLIB))
+		info.perfindex = perfindex;
+	if (json_file != NULL)
+		write_json(json_file, tracefiles, num_tracefiles, mm_stats,
+				   libc_stats, &info);
+	if (csv_file != NULL)
+		write_csv(csv_file, tracefiles, num_tracefiles, mm_stats,
+				  libc_stats, &info);
+	if (baseline != NULL)
+		regressed = compare_results(baseline, tracefiles, num_tracefiles,
+									mm_stats, threshold);
+
 	if (autograder)
 	{
 		printf("correct:%d\n", numcorrect);
 		printf("perfidx:%.0f\n", perfindex);
 	}
 
-	exit(0);
+	exit(regressed ? 2 : 0);
 }
 
 /*****************************************************************
- * The following routines manipulate the range list, which keeps
+ * The following routines manipulate the range tree, which keeps
  * track of the extent of every allocated block payload. We use the
- * range list to detect any overlapping allocated blocks.
+ * range tree to detect any overlapping allocated blocks. Since the
+ * tree is ordered by address, a new block only has to be checked
+ * against its predecessor and successor, so each check, insertion
+ * and removal takes O(log n) expected time for n live blocks.
  ****************************************************************/
 
 /*
  * add_range - As directed by request opnum in trace tracenum,
  *     we've just called the student's mm_malloc to allocate a block of
  *     size bytes at addr lo. After checking the block for correctness,
- *     we create a range struct for this block and add it to the range list.
+ *     we create a range struct for this block and add it to the range tree.
  */
 static int add_range(range_t **ranges, char *lo, int size,
 					 int tracenum, int opnum)
 {
 	char *hi = lo + size - 1;
-	range_t *p;
+	range_t *p, *pred = NULL, *succ = NULL;
 	char msg[MAXLINE];
 
 	assert(size > 0);
@@ -427,9 +913,10 @@ static int add_range(range_t **ranges, char *lo, int size,
 		return 0;
 	}
 
-	/* The payload must lie within the extent of the heap */
-	if ((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) ||
-		(hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi()))
+	/* The payload must lie within the extent of the heap (if it has one) */
+	if ((mmops->flags & MM_OPS_MEMLIB) &&
+		((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) ||
+		 (hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi())))
 	{
 		sprintf(msg, "Payload (%p:%p) lies outside heap (%p:%p)",
 				lo, hi, mem_heap_lo(), mem_heap_hi());
@@ -437,29 +924,45 @@ static int add_range(range_t **ranges, char *lo, int size,
 		return 0;
 	}
 
-	/* The payload must not overlap any other payloads */
-	for (p = *ranges; p != NULL; p = p->next)
+	/*
+	 * The payload must not overlap any other payloads. Find the closest
+	 * payloads below and above lo; any overlap involves one of them.
+	 */
+	for (p = *ranges; p != NULL;)
 	{
-		if ((lo >= p->lo && lo <= p->hi) ||
-			(hi >= p->lo && hi <= p->hi))
+		if (p->lo <= lo)
+		{
+			pred = p;
+			p = p->right;
+		}
+		else
 		{
-			sprintf(msg, "Payload (%p:%p) overlaps another payload (%p:%p)\n",
-					lo, hi, p->lo, p->hi);
-			malloc_error(tracenum, opnum, msg);
-			return 0;
+			succ = p;
+			p = p->left;
 		}
 	}
+	if ((p = pred) != NULL && p->hi >= lo)
+		;
+	else if ((p = succ) != NULL && p->lo <= hi)
+		;
+	else
+		p = NULL;
+	if (p != NULL)
+	{
+		sprintf(msg, "Payload (%p:%p) overlaps another payload (%p:%p)\n",
+				lo, hi, p->lo, p->hi);
+		malloc_error(tracenum, opnum, msg);
+		return 0;
+	}
 
 	/*
 	 * Everything looks OK, so remember the extent of this block
-	 * by creating a range struct and adding it the range list.
+	 * by creating a range struct and adding it the range tree.
 	 */
-	if ((p = (range_t *)malloc(sizeof(range_t))) == NULL)
-		unix_error("malloc error in add_range");
-	p->next = *ranges;
+	p = new_range();
 	p->lo = lo;
 	p->hi = hi;
-	*ranges = p;
+	*ranges = insert_range(*ranges, p);
 	return 1;
 }
 
@@ -469,19 +972,16 @@ static int add_range(range_t **ranges, char *lo, int size,
 static void remove_range(range_t **ranges, char *lo)
 {
 	range_t *p;
-	range_t **prevpp = ranges;
-	int size;
+	range_t **linkp = ranges;
 
-	for (p = *ranges; p != NULL; p = p->next)
+	while ((p = *linkp) != NULL && p->lo != lo)
+		linkp = (lo < p->lo) ? &p->left : &p->right;
+
+	if (p != NULL)
 	{
-		if (p->lo == lo)
-		{
-			*prevpp = p->next;
-			size = p->hi - p->lo + 1;
-			free(p);
-			break;
-		}
-		prevpp = &(p->next);
+		*linkp = merge_ranges(p->left, p->right);
+		p->right = free_ranges;
+		free_ranges = p;
 	}
 }
 
@@ -489,122 +989,106 @@ static void remove_range(range_t **ranges, char *lo)
  * clear_ranges - free all of the range records for a trace
  */
 static void clear_ranges(range_t **ranges)
+{
+	range_t *p = *ranges;
+
+	if (p == NULL)
+		return;
+	clear_ranges(&p->left);
+	clear_ranges(&p->right);
+	p->right = free_ranges;
+	free_ranges = p;
+	*ranges = NULL;
+}
+
+/*
+ * new_range - take a range record from the pool, refilling the pool
+ *     RANGE_BLOCK records at a time instead of one malloc per record
+ */
+static range_t *new_range(void)
 {
 	range_t *p;
-	range_t *pnext;
+	int i;
 
-	for (p = *ranges; p != NULL; p = pnext)
+	if (free_ranges == NULL)
 	{
-		pnext = p->next;
-		free(p);
+		if ((p = (range_t *)malloc(RANGE_BLOCK * sizeof(range_t))) == NULL)
+			unix_error("malloc error in new_range");
+		for (i = 0; i < RANGE_BLOCK; i++)
+		{
+			p[i].right = free_ranges;
+			free_ranges = &p[i];
+		}
 	}
-	*ranges = NULL;
+	p = free_ranges;
+	free_ranges = p->right;
+
+	/* xorshift32 gives reproducible, well-mixed priorities */
+	range_seed ^= range_seed << 13;
+	range_seed ^= range_seed >> 17;
+	range_seed ^= range_seed << 5;
+	p->prio = range_seed;
+	p->left = p->right = NULL;
+	return p;
 }
 
-/**********************************************
- * The following routines manipulate tracefiles
- *********************************************/
-
 /*
- * read_trace - read a trace file and store it in memory
+ * insert_range - insert r into the treap rooted at root by address, then
+ *     rotate it up while its priority beats its parent's. Returns the
+ *     new root.
  */
-static trace_t *read_trace(char *tracedir, char *filename)
+static range_t *insert_range(range_t *root, range_t *r)
 {
-	FILE *tracefile;
-	trace_t *trace;
-	char type[MAXLINE];
-	char path[MAXLINE];
-	unsigned index, size;
-	unsigned max_index = 0;
-	unsigned op_index;
-
-	if (verbose > 1)
-		printf("Reading tracefile: %s\n", filename);
+	range_t *child;
 
-	/* Allocate the trace record */
-	if ((trace = (trace_t *)malloc(sizeof(trace_t))) == NULL)
-		unix_error("malloc 1 failed in read_trance");
-
-	/* Read the trace file header */
-	strcpy(path, tracedir);
-	strcat(path, filename);
-	if ((tracefile = fopen(path, "r")) == NULL)
+	if (root == NULL)
+		return r;
+	if (r->lo < root->lo)
 	{
-		sprintf(msg, "Could not open %s in read_trace", path);
-		unix_error(msg);
+		child = root->left = insert_range(root->left, r);
+		if (child->prio > root->prio)
+		{ /* rotate right */
+			root->left = child->right;
+			child->right = root;
+			return child;
+		}
 	}
-	fscanf(tracefile, "%d", &(trace->sugg_heapsize)); /* not used */
-	fscanf(tracefile, "%d", &(trace->num_ids));
-	fscanf(tracefile, "%d", &(trace->num_ops));
-	fscanf(tracefile, "%d", &(trace->weight)); /* not used */
-
-	/* We'll store each request line in the trace in this array */
-	if ((trace->ops =
-			 (traceop_t *)malloc(trace->num_ops * sizeof(traceop_t))) == NULL)
-		unix_error("malloc 2 failed in read_trace");
-
-	/* We'll keep an array of pointers to the allocated blocks here... */
-	if ((trace->blocks =
-			 (char **)malloc(trace->num_ids * sizeof(char *))) == NULL)
-		unix_error("malloc 3 failed in read_trace");
-
-	/* ... along with the corresponding byte sizes of each block */
-	if ((trace->block_sizes =
-			 (size_t *)malloc(trace->num_ids * sizeof(size_t))) == NULL)
-		unix_error("malloc 4 failed in read_trace");
-
-	/* read every request line in the trace file */
-	index = 0;
-	op_index = 0;
-	while (fscanf(tracefile, "%s", type) != EOF)
+	else
 	{
-		switch (type[0])
-		{
-		case 'a':
-			fscanf(tracefile, "%u %u", &index, &size);
-			trace->ops[op_index].type = ALLOC;
-			trace->ops[op_index].index = index;
-			trace->ops[op_index].size = size;
-			max_index = (index > max_index) ? index : max_index;
-			break;
-		case 'r':
-			fscanf(tracefile, "%u %u", &index, &size);
-			trace->ops[op_index].type = REALLOC;
-			trace->ops[op_index].index = index;
-			trace->ops[op_index].size = size;
-			max_index = (index > max_index) ? index : max_index;
-			break;
-		case 'f':
-			fscanf(tracefile, "%ud", &index);
-			trace->ops[op_index].type = FREE;
-			trace->ops[op_index].index = index;
-			break;
-		default:
-			printf("Bogus type character (%c) in tracefile %s\n",
-				   type[0], path);
-			exit(1);
+		child = root->right = insert_range(root->right, r);
+		if (child->prio > root->prio)
+		{ /* rotate left */
+			root->right = child->left;
+			child->left = root;
+			return child;
 		}
-		op_index++;
 	}
-	fclose(tracefile);
-	assert(max_index == trace->num_ids - 1);
-	assert(trace->num_ops == op_index);
-
-	return trace;
+	return root;
 }
 
 /*
- * free_trace - Free the trace record and the three arrays it points
- *              to, all of which were allocated in read_trace().
+ * merge_ranges - join two treaps where every address in a is below
+ *     every address in b, keeping the heap order on priorities
  */
-void free_trace(trace_t *trace)
+static range_t *merge_ranges(range_t *a, range_t *b)
 {
-	free(trace->ops); /* free the three arrays... */
-	free(trace->blocks);
-	free(trace->block_sizes);
-	free(trace); /* and the trace record itself... */
+	if (a == NULL)
+		return b;
+	if (b == NULL)
+		return a;
+	if (a->prio > b->prio)
+	{
+		a->right = merge_ranges(a->right, b);
+		return a;
+	}
+	b->left = merge_ranges(a, b->left);
+	return b;
 }
 
+/**********************************************
+ * The following routines manipulate tracefiles
+ *********************************************/
+
 /**********************************************************************
  * The following functions evaluate the correctness, space utilization,
  * and throughput of the libc and mm malloc packages.
@@ -615,7 +1099,7 @@ void free_trace(trace_t *trace)
  */
 static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 {
-	int i, j;
+	int i;
 	int index;
 	int size;
 	int oldsize;
@@ -628,7 +1112,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 	clear_ranges(ranges);
 
 	/* Call the mm package's init function */
-	if (mm_init() < 0)
+	if (init_mm(trace) < 0)
 	{
 		malloc_error(tracenum, 0, "mm_init failed.");
 		return 0;
@@ -646,7 +1130,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 		case ALLOC: /* mm_malloc */
 
 			/* Call the student's malloc */
-			if ((p = mm_malloc(size)) == NULL)
+			if ((p = mmops->malloc(size)) == NULL)
 			{
 				malloc_error(tracenum, i, "mm_malloc failed.");
 				return 0;
@@ -676,7 +1160,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 
 			/* Call the student's realloc */
 			oldp = trace->blocks[index];
-			if ((newp = mm_realloc(oldp, size)) == NULL)
+			if ((newp = mmops->realloc(oldp, size)) == NULL)
 			{
 				malloc_error(tracenum, i, "mm_realloc failed.");
 				return 0;
@@ -697,14 +1181,11 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 			oldsize = trace->block_sizes[index];
 			if (size < oldsize)
 				oldsize = size;
-			for (j = 0; j < oldsize; j++)
+			if (!filled_with(newp, index & 0xFF, oldsize))
 			{
-				if (newp[j] != (index & 0xFF))
-				{
-					malloc_error(tracenum, i, "mm_realloc did not preserve the "
-											  "data from old block");
-					return 0;
-				}
+				malloc_error(tracenum, i, "mm_realloc did not preserve the "
+										  "data from old block");
+				return 0;
 			}
 			memset(newp, index & 0xFF, size);
 
@@ -718,7 +1199,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 			/* Remove region from list and call student's free function */
 			p = trace->blocks[index];
 			remove_range(ranges, p);
-			mm_free(p);
+			mmops->free(p);
 			break;
 
 		default:
@@ -730,6 +1211,18 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 	return 1;
 }
 
+/*
+ * filled_with - Returns true if the n bytes at p all hold the value c.
+ *     Comparing the block with itself shifted by one byte lets memcmp
+ *     do the work a word at a time.
+ */
+static int filled_with(const char *p, int c, int n)
+{
+	if (n <= 0)
+		return 1;
+	return ((unsigned char)p[0] == c) && (memcmp(p, p + 1, n - 1) == 0);
+}
+
 /*
  * eval_mm_util - Evaluate the space utilization of the student's package
  *   The idea is to remember the high water mark "hwm" of the heap for
@@ -740,8 +1233,14 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
  *   doesn't allow the students to decrement the brk pointer, so brk
  *   is always the high water mark of the heap.
  *
+ *   The run starts on untouched heap pages and writes to every page of
+ *   each payload, as a program using its blocks would. If stats is not
+ *   NULL, its minor page faults, the heap pages resident at the end,
+ *   and the utilization against those pages (tutil) are stored there:
+ *   a heap can span more than it ever touches.
  */
-static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
+static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges,
+						   stats_t *stats)
 {
 	int i;
 	int index;
@@ -750,14 +1249,22 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 	int total_size = 0;
 	char *p;
 	char *newp, *oldp;
+	struct rusage ru;
+	long faults;
 
-	/* initialize the heap and the mm malloc package */
+	/* initialize the heap, on fresh pages, and the mm malloc package */
 	mem_reset_brk();
-	if (mm_init() < 0)
+	mem_discard_pages();
+	getrusage(RUSAGE_SELF, &ru);
+	faults = ru.ru_minflt;
+	if (mmops->init() < 0)
 		app_error("mm_init failed in eval_mm_util");
+	tl_n = 0;
 
 	for (i = 0; i < trace->num_ops; i++)
 	{
+		if (tl_every > 0 && i % tl_every == 0)
+			tl_sample(i, total_size);
 		switch (trace->ops[i].type)
 		{
 
@@ -765,8 +1272,9 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 			index = trace->ops[i].index;
 			size = trace->ops[i].size;
 
-			if ((p = mm_malloc(size)) == NULL)
+			if ((p = mmops->malloc(size)) == NULL)
 				app_error("mm_malloc failed in eval_mm_util");
+			touch_payload(p, size);
 
 			/* Remember region and size */
 			trace->blocks[index] = p;
@@ -786,8 +1294,9 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 			oldsize = trace->block_sizes[index];
 
 			oldp = trace->blocks[index];
-			if ((newp = mm_realloc(oldp, newsize)) == NULL)
+			if ((newp = mmops->realloc(oldp, newsize)) == NULL)
 				app_error("mm_realloc failed in eval_mm_util");
+			touch_payload(newp, newsize);
 
 			/* Remember region and size */
 			trace->blocks[index] = newp;
@@ -806,7 +1315,7 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 			size = trace->block_sizes[index];
 			p = trace->blocks[index];
 
-			mm_free(p);
+			mmops->free(p);
 
 			/* Keep track of current total size
 			 * of all allocated blocks */
@@ -819,80 +1328,1179 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 		}
 	}
 
+	if (tl_every > 0)
+		tl_sample(trace->num_ops, total_size);
+
+	trace->peak_bytes = max_total_size;
+	if (stats != NULL)
+	{
+		getrusage(RUSAGE_SELF, &ru);
+		stats->faults = ru.ru_minflt - faults;
+		stats->pages = mem_resident_pages();
+		stats->tutil = stats->pages ? (double)max_total_size /
+										  (stats->pages * mem_pagesize())
+									: 0;
+	}
+	if (!(mmops->flags & MM_OPS_MEMLIB)) /* no heap to measure (-A libc) */
+	{
+		if (stats != NULL)
+			stats->tutil = -1;
+		return -1;
+	}
 	return ((double)max_total_size / (double)mem_heapsize());
 }
 
 /*
- * eval_mm_speed - This is the function that is used by fcyc()
- *    to measure the running time of the mm malloc package.
+ * touch_payload - Write to every page of the size-byte payload at p
  */
-static void eval_mm_speed(void *ptr)
+static void touch_payload(char *p, int size)
 {
-	int i, index, size, newsize;
-	char *p, *newp, *oldp, *block;
-	trace_t *trace = ((speed_t *)ptr)->trace;
-
-	/* Reset the heap and initialize the mm package */
-	mem_reset_brk();
-	if (mm_init() < 0)
-		app_error("mm_init failed in eval_mm_speed");
-
-	/* Interpret each trace request */
-	for (i = 0; i < trace->num_ops; i++)
-		switch (trace->ops[i].type)
-		{
-
-		case ALLOC: /* mm_malloc */
-			index = trace->ops[i].index;
-			size = trace->ops[i].size;
-			if ((p = mm_malloc(size)) == NULL)
-				app_error("mm_malloc error in eval_mm_speed");
-			trace->blocks[index] = p;
-			break;
-
-		case REALLOC: /* mm_realloc */
-			index = trace->ops[i].index;
-			newsize = trace->ops[i].size;
-			oldp = trace->blocks[index];
-			if ((newp = mm_realloc(oldp, newsize)) == NULL)
-				app_error("mm_realloc error in eval_mm_speed");
-			trace->blocks[index] = newp;
-			break;
-
-		case FREE: /* mm_free */
-			index = trace->ops[i].index;
-			block = trace->blocks[index];
-			mm_free(block);
-			break;
+	int pagesize = (int)mem_pagesize();
+	int k;
 
-		default:
-			app_error("Nonexistent request type in eval_mm_valid");
-		}
+	for (k = 0; k < size; k += pagesize - (int)((unsigned long)(p + k) % pagesize))
+		p[k] = 0;
+	if (size > 0)
+		p[size - 1] = 0;
 }
 
 /*
- * eval_libc_valid - We run this function to make sure that the
- *    libc malloc can run to completion on the set of traces.
- *    We'll be conservative and terminate if any libc malloc call fails.
- *
+ * tl_sample - Record the state of the heap after op ops of eval_mm_util,
+ *     with live bytes of payload allocated
  */
-static int eval_libc_valid(trace_t *trace, int tracenum)
+static void tl_sample(long op, size_t live)
 {
-	int i, newsize;
-	char *p, *newp, *oldp;
+	tlsample_t *t;
 
-	for (i = 0; i < trace->num_ops; i++)
+	if (tl_n == tl_cap)
 	{
-		switch (trace->ops[i].type)
-		{
+		tl_cap = tl_cap ? 2 * tl_cap : 1024;
+		if ((tl_samples = (tlsample_t *)realloc(tl_samples,
+												tl_cap * sizeof(tlsample_t))) == NULL)
+			unix_error("realloc failed in tl_sample");
+	}
+	t = &tl_samples[tl_n++];
+	t->op = op;
+	t->live = live;
+	t->heap = mem_heapsize();
+	if (mmops->heapstats == NULL || mmops->heapstats(&t->free) < 0)
+		memset(&t->free, 0, sizeof(t->free));
+}
 
-		case ALLOC: /* malloc */
-			if ((p = malloc(trace->ops[i].size)) == NULL)
-			{
-				malloc_error(tracenum, i, "libc malloc failed");
-				unix_error("System message");
-			}
-			trace->blocks[trace->ops[i].index] = p;
+/*
+ * tl_finish - Summarize the samples of the trace eval_mm_util just ran
+ *     into *tl and, with --timeline, append them to the CSV file. Each
+ *     trace goes out in a single write to the O_APPEND file, so -j
+ *     workers don't interleave their rows.
+ */
+static void tl_finish(char *tracefile, int tracenum, tlstat_t *tl)
+{
+	tlsample_t *t;
+	char *buf, *name;
+	size_t len = 0, cap;
+	double frag;
+	long k;
+	int fd;
+
+	memset(tl, 0, sizeof(*tl));
+	tl->samples = tl_n;
+	for (k = 0; k < tl_n; k++)
+	{
+		t = &tl_samples[k];
+		if (t->heap > t->live && t->heap - t->live > tl->max_waste)
+			tl->max_waste = t->heap - t->live;
+		if (t->free.free_blocks > tl->max_free_blocks)
+			tl->max_free_blocks = t->free.free_blocks;
+		frag = t->free.free_bytes ? 1.0 - (double)t->free.largest_free / t->free.free_bytes : 0;
+		if (frag > tl->max_frag)
+			tl->max_frag = frag;
+	}
+	if (tl_n > 0)
+		tl->end_largest = tl_samples[tl_n - 1].free.largest_free;
+	if (tl_file == NULL)
+		return;
+
+	name = strrchr(tracefile, '/') ? strrchr(tracefile, '/') + 1 : tracefile;
+	cap = (tl_n + 1) * (strlen(name) + 128);
+	if ((buf = (char *)malloc(cap)) == NULL)
+		unix_error("malloc failed in tl_finish");
+	for (k = 0; k < tl_n; k++)
+	{
+		t = &tl_samples[k];
+		len += snprintf(buf + len, cap - len, "%d,%s,%ld,%zu,%zu,%.6f,",
+						tracenum, name, t->op, t->live, t->heap,
+						t->heap ? (double)t->live / t->heap : 0.0);
+		if (mmops->heapstats != NULL)
+			len += snprintf(buf + len, cap - len, "%zu,%zu,%zu\n",
+							t->free.free_blocks, t->free.free_bytes,
+							t->free.largest_free);
+		else
+			len += snprintf(buf + len, cap - len, ",,\n");
+	}
+	if ((fd = open(tl_file, O_WRONLY | O_APPEND)) < 0 ||
+		write_full(fd, buf, len) < 0)
+		unix_error("Could not write the --timeline file");
+	close(fd);
+	free(buf);
+}
+
+/*
+ * eval_mm_speed - This is the function that is used by fcyc()
+ *    to measure the running time of the mm malloc package. With
+ *    --steady it replays only the window after the warm-up prefix,
+ *    on the heap that steady_restore has put back.
+ */
+static void eval_mm_speed(void *ptr)
+{
+	speed_t *params = (speed_t *)ptr;
+	trace_t *trace = params->trace;
+
+	speed_runs++;
+	/* Reset the heap and initialize the mm package */
+	if (params->first_op == 0)
+	{
+		mem_reset_brk();
+		if (init_mm(trace) < 0)
+			app_error("mm_init failed in eval_mm_speed");
+	}
+	mm_replay(trace, params->first_op, trace->num_ops);
+}
+
+/*
+ * replay_mm - Interpret trace requests lo..hi-1 with the mm package
+ */
+static void replay_mm(trace_t *trace, long lo, long hi)
+{
+	REPLAY(trace, lo, hi, mm_malloc, mm_realloc, mm_free);
+}
+
+/*
+ * replay_seg, replay_sdfs, replay_libc - replay_mm for the other -A
+ *    backends. Each expands REPLAY with its own functions, so the timed
+ *    loop makes the same direct calls as for mm.c.
+ */
+static void replay_seg(trace_t *trace, long lo, long hi)
+{
+	REPLAY(trace, lo, hi, seg_malloc, seg_realloc, seg_free);
+}
+
+static void replay_sdfs(trace_t *trace, long lo, long hi)
+{
+	REPLAY(trace, lo, hi, sdfs_malloc, sdfs_realloc, sdfs_free);
+}
+
+static void replay_libc(trace_t *trace, long lo, long hi)
+{
+	REPLAY(trace, lo, hi, malloc, realloc, free);
+}
+
+/*
+ * libc_init - mm_init of the libc backend
+ */
+static int libc_init(void)
+{
+	return 0;
+}
+
+/*
+ * find_backend - Look up an -A backend by name, or return NULL
+ */
+static const backend_t *find_backend(const char *name)
+{
+	int i;
+
+	for (i = 0; i < (int)(sizeof(backends) / sizeof(backends[0])); i++)
+		if (!strcmp(backends[i].ops->name, name))
+			return &backends[i];
+	return NULL;
+}
+
+/*
+ * eval_null_speed - The replay of eval_mm_speed or eval_libc_speed
+ *    against the null allocator, timed by calibrate_speed
+ */
+static void eval_null_speed(void *ptr)
+{
+	speed_t *params = (speed_t *)ptr;
+
+	REPLAY(params->trace, params->first_op, params->trace->num_ops,
+		   null_malloc, null_realloc, null_free);
+}
+
+/*
+ * time_mm - Time the mm package on trace into *stats, and count its
+ *    hardware events into *pc if pc is not NULL. With --steady the first
+ *    steady_pct% of the ops are replayed once, untimed, and every timed
+ *    run starts from the heap and block table as they were at that
+ *    point: restored from a checkpoint before each run (mm.c keeps all
+ *    of its state in the heap, so a copy of the heap is enough), or
+ *    with --steady-fork from a fresh child process. With --calibrate
+ *    the null allocator's time for the same window is taken off. The
+ *    minor page faults per run and the heap pages resident afterwards
+ *    go to stats->run_faults and run_pages.
+ */
+static void time_mm(trace_t *trace, range_t *ranges, stats_t *stats,
+					pcstat_t *pc)
+{
+	speed_t params;
+	size_t len = trace->num_ids * sizeof(char *);
+	struct rusage ru;
+	long faults, runs;
+
+	params.trace = trace;
+	params.ranges = ranges;
+	params.first_op = 0;
+	params.saved_blocks = NULL;
+	stats->ops = trace->num_ops;
+	if (steady_pct > 0)
+	{
+		params.first_op = (long)(trace->num_ops * steady_pct / 100);
+		stats->ops = trace->num_ops - params.first_op;
+
+		/* Warm up */
+		mem_reset_brk();
+		if (init_mm(trace) < 0)
+			app_error("mm_init failed in time_mm");
+		mm_replay(trace, 0, params.first_op);
+		if (!steady_fork)
+		{
+			if (mem_checkpoint() < 0 ||
+				(params.saved_blocks = malloc(len ? len : 1)) == NULL)
+				unix_error("Could not save the heap for --steady");
+			memcpy(params.saved_blocks, trace->blocks, len);
+			set_fsecs_prepare(steady_restore);
+		}
+	}
+
+	if (steady_fork)
+		time_steady_fork(&params, stats, pc);
+	else
+	{
+		getrusage(RUSAGE_SELF, &ru);
+		faults = ru.ru_minflt;
+		runs = speed_runs;
+		time_speed(eval_mm_speed, &params, stats);
+		getrusage(RUSAGE_SELF, &ru);
+		stats->run_faults = (double)(ru.ru_minflt - faults) / (speed_runs - runs);
+		stats->run_pages = mem_resident_pages();
+		if (pc != NULL)
+		{
+			if (params.saved_blocks != NULL)
+				steady_restore(&params);
+			pc_measure(eval_mm_speed, &params, pc);
+		}
+		set_fsecs_prepare(NULL);
+		free(params.saved_blocks);
+		params.saved_blocks = NULL;
+	}
+	if (calibrate)
+		calibrate_speed(&params, stats);
+}
+
+/*
+ * steady_restore - Put the heap and the block table back to the end of
+ *    the warm-up prefix (called by fsecs before each timed run)
+ */
+static void steady_restore(void *ptr)
+{
+	speed_t *params = (speed_t *)ptr;
+
+	mem_rollback();
+	memcpy(params->trace->blocks, params->saved_blocks,
+		   params->trace->num_ids * sizeof(char *));
+}
+
+/*
+ * time_steady_fork - --steady-fork: for every timing, fork children at
+ *    the end of the warm-up prefix and keep the fastest of STEADY_FORKS.
+ *    Each child first writes to every page of the heap area and of the
+ *    block table, so that copy-on-write faults fall outside the timed
+ *    window, then replays the window once and sends its time and minor
+ *    page faults back over a pipe. With -P one more child counts the
+ *    hardware events. The children start cold on purpose, so --warmup
+ *    does not apply. run_pages is what the prefix left resident.
+ */
+static void time_steady_fork(speed_t *params, stats_t *stats, pcstat_t *pc)
+{
+	trace_t *trace = params->trace;
+	size_t pagesize = mem_pagesize();
+	char *p, *lo, *hi;
+	int fds[2], r, k, status, runs = 0;
+	double t, best, *times, res[2], faults = 0;
+	struct timespec t0, t1;
+	struct rusage ru;
+	pid_t pid;
+
+	if ((times = (double *)malloc(num_reps * sizeof(double))) == NULL)
+		unix_error("malloc failed in time_steady_fork");
+
+	for (r = 0; r <= num_reps; r++)
+	{
+		if (r == num_reps && pc == NULL)
+			break;
+		best = DBL_MAX;
+		for (k = 0; k < (r < num_reps ? STEADY_FORKS : 1); k++)
+		{
+			if (pipe(fds) < 0)
+				unix_error("pipe failed in time_steady_fork");
+			if ((pid = fork()) < 0)
+				unix_error("fork failed in time_steady_fork");
+			if (pid == 0)
+			{
+				close(fds[0]);
+				lo = (char *)mem_heap_lo();
+				for (p = lo; p < lo + MAX_HEAP; p += pagesize)
+					*(volatile char *)p = *(volatile char *)p;
+				lo = (char *)trace->blocks;
+				hi = lo + trace->num_ids * sizeof(char *);
+				for (p = lo; p < hi; p += pagesize)
+					*(volatile char *)p = *(volatile char *)p;
+
+				if (r == num_reps) /* the -P child */
+				{
+					pc_measure(eval_mm_speed, params, pc);
+					write_full(fds[1], pc, sizeof(*pc));
+				}
+				else
+				{
+					getrusage(RUSAGE_SELF, &ru);
+					res[1] = ru.ru_minflt;
+					clock_gettime(CLOCK_MONOTONIC, &t0);
+					mm_replay(trace, params->first_op, trace->num_ops);
+					clock_gettime(CLOCK_MONOTONIC, &t1);
+					getrusage(RUSAGE_SELF, &ru);
+					res[0] = (t1.tv_sec - t0.tv_sec) + 1e-9 * (t1.tv_nsec - t0.tv_nsec);
+					res[1] = ru.ru_minflt - res[1];
+					write_full(fds[1], res, sizeof(res));
+				}
+				_exit(0);
+			}
+			close(fds[1]);
+			if (r == num_reps)
+			{
+				if (read_full(fds[0], pc, sizeof(*pc)) <= 0)
+					app_error("--steady-fork child died");
+			}
+			else if (read_full(fds[0], res, sizeof(res)) <= 0)
+				app_error("--steady-fork child died");
+			else
+			{
+				t = res[0];
+				faults += res[1];
+				runs++;
+			}
+			close(fds[0]);
+			if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) ||
+				WEXITSTATUS(status) != 0)
+				app_error("--steady-fork child failed");
+			if (r < num_reps && t < best)
+				best = t;
+		}
+		if (r < num_reps)
+			times[r] = best;
+	}
+	summarize_times(times, num_reps, stats);
+	stats->run_faults = faults / runs;
+	stats->run_pages = mem_resident_pages();
+	free(times);
+}
+
+/*
+ * heap_hint - The heap size hint for trace selected by -H, or 0 if
+ *     mm_init should be used. Hints are capped to the simulated heap.
+ */
+static size_t heap_hint(trace_t *trace)
+{
+	size_t hint;
+
+	switch (hint_mode)
+	{
+	case HINT_SUGG:
+		hint = trace->sugg_heapsize;
+		break;
+	case HINT_PEAK: /* 0 until eval_mm_util has run on this trace */
+		hint = trace->peak_bytes;
+		break;
+	default:
+		return 0;
+	}
+	return (hint > MAX_HEAP / 2) ? MAX_HEAP / 2 : hint;
+}
+
+/*
+ * init_mm - Initialize the mm package for a run of trace, pre-sizing
+ *     the heap with mm_init_hint if a hint is selected.
+ */
+static int init_mm(trace_t *trace)
+{
+	size_t hint = heap_hint(trace);
+
+	return (hint && mmops->init_hint) ? mmops->init_hint(hint) : mmops->init();
+}
+
+/*
+ * eval_mm_coldstart - Count mem_sbrk calls and minor page faults of the
+ *    first 1/COLD_PHASE of the trace, starting from untouched heap pages.
+ *    The cost of initializing the package (with the hint, if any) is
+ *    reported separately in *init.
+ */
+static void eval_mm_coldstart(trace_t *trace, size_t hint,
+							  coldstat_t *init, coldstat_t *phase)
+{
+	int i, index, nops = trace->num_ops / COLD_PHASE;
+	size_t sbrks;
+	long faults;
+	struct rusage ru;
+	char *p;
+
+	mem_reset_brk();
+	mem_discard_pages();
+
+	getrusage(RUSAGE_SELF, &ru);
+	sbrks = mem_sbrk_calls();
+	faults = ru.ru_minflt;
+	if (((hint && mmops->init_hint) ? mmops->init_hint(hint) : mmops->init()) < 0)
+		app_error("mm_init failed in eval_mm_coldstart");
+	getrusage(RUSAGE_SELF, &ru);
+	if (init != NULL)
+	{
+		init->sbrks = mem_sbrk_calls() - sbrks;
+		init->faults = ru.ru_minflt - faults;
+	}
+
+	sbrks = mem_sbrk_calls();
+	faults = ru.ru_minflt;
+	for (i = 0; i < nops; i++)
+	{
+		index = trace->ops[i].index;
+		switch (trace->ops[i].type)
+		{
+		case ALLOC:
+			if ((p = mmops->malloc(trace->ops[i].size)) == NULL)
+				app_error("mm_malloc failed in eval_mm_coldstart");
+			trace->blocks[index] = p;
+			break;
+		case REALLOC:
+			if ((p = mmops->realloc(trace->blocks[index], trace->ops[i].size)) == NULL)
+				app_error("mm_realloc failed in eval_mm_coldstart");
+			trace->blocks[index] = p;
+			break;
+		case FREE:
+			mmops->free(trace->blocks[index]);
+			break;
+		}
+	}
+	getrusage(RUSAGE_SELF, &ru);
+	phase->sbrks = mem_sbrk_calls() - sbrks;
+	phase->faults = ru.ru_minflt - faults;
+}
+
+/*
+ * eval_mm_stream - Replay a trace through the mm package without loading
+ *    it (-S). Ops arrive a window at a time from a tstream and live blocks
+ *    are kept in an idmap, so driver memory depends on the live set rather
+ *    than on the length or id space of the trace. Blocks are checked for
+ *    alignment and heap bounds but not for overlap, and the replay is
+ *    timed once, with the streaming overhead included.
+ */
+static void eval_mm_stream(char *filename, int tracenum,
+						   stats_t *stats, streamstat_t *ss)
+{
+	char path[MAXLINE];
+	trace_t info;
+	tstream_t *s;
+	traceop_t *ops;
+	idmap_t map;
+	idmap_ent_t *e;
+	long i, n, opnum = 0;
+	size_t total = 0, peak = 0;
+	char *p;
+	double start;
+
+	if (filename[0] == '/')
+		path[0] = '\0';
+	else
+		strcpy(path, tracedir);
+	strcat(path, filename);
+
+	memset(stats, 0, sizeof(stats_t));
+	memset(ss, 0, sizeof(streamstat_t));
+	mem_reset_brk();
+	s = tstream_open(path, 0, &info);
+	idmap_init(&map);
+	if (init_mm(&info) < 0)
+	{
+		malloc_error(tracenum, 0, "mm_init failed.");
+		goto out;
+	}
+
+	start = now_secs();
+	while ((n = tstream_next(s, &ops)) > 0)
+	{
+		for (i = 0; i < n; i++, opnum++)
+		{
+			switch (ops[i].type)
+			{
+			case ALLOC:	  /* mm_malloc */
+			case REALLOC: /* mm_realloc, mm_malloc for an unknown id */
+				e = idmap_insert(&map, ops[i].index);
+				if (e->p != NULL && ops[i].type == ALLOC)
+				{
+					/* The capture missed the free of this id */
+					mmops->free(e->p);
+					total -= e->size;
+					e->p = NULL;
+					e->size = 0;
+					ss->skipped++;
+				}
+				if (e->p != NULL)
+					p = mmops->realloc(e->p, ops[i].size);
+				else
+					p = mmops->malloc(ops[i].size);
+				if (p == NULL)
+				{
+					malloc_error(tracenum, (int)opnum, "mm_malloc/mm_realloc failed.");
+					goto out;
+				}
+				if (!IS_ALIGNED(p) ||
+					((mmops->flags & MM_OPS_MEMLIB) &&
+					 (p < (char *)mem_heap_lo() ||
+					  p + ops[i].size - 1 > (char *)mem_heap_hi())))
+				{
+					malloc_error(tracenum, (int)opnum,
+								 "Payload is not aligned or not in the heap");
+					goto out;
+				}
+				total += ops[i].size - e->size;
+				peak = (total > peak) ? total : peak;
+				e->p = p;
+				e->size = ops[i].size;
+				break;
+
+			case FREE: /* mm_free */
+				if ((e = idmap_find(&map, ops[i].index)) == NULL)
+				{
+					ss->skipped++; /* allocated before the capture started */
+					break;
+				}
+				mmops->free(e->p);
+				total -= e->size;
+				idmap_remove(&map, e);
+				break;
+
+			default:
+				app_error("Nonexistent request type in eval_mm_stream");
+			}
+		}
+	}
+	stats->secs = now_secs() - start;
+	stats->secs_lo = stats->secs_hi = stats->secs;
+	stats->reps = 1;
+	stats->ops = opnum;
+	stats->tutil = -1; /* touched pages are only measured by eval_mm_util */
+	if (mmops->flags & MM_OPS_MEMLIB)
+		stats->util = (double)peak / (double)mem_heapsize();
+	else /* no heap to measure (-A libc) */
+		stats->util = -1;
+	stats->valid = 1;
+
+out:
+	ss->max_live = map.max_count;
+	ss->map_bytes = (map.mask + 1) * sizeof(idmap_ent_t);
+	idmap_destroy(&map);
+	tstream_close(s);
+}
+
+/*
+ * eval_mm_trace - Evaluate the mm package on one trace: correctness,
+ *    utilization and throughput, plus the cold-start costs if cold is
+ *    not NULL (cold[0]: phase with mm_init, cold[1..2]: init/phase with
+ *    the hint) and the per-op latencies if lat is not NULL. With -S the
+ *    trace is streamed into *ss instead.
+ */
+static void eval_mm_trace(char *tracefile, int tracenum, range_t **ranges,
+						  stats_t *stats, coldstat_t *cold, streamstat_t *ss,
+						  latstat_t *lat, pcstat_t *pc, tlstat_t *tl,
+						  csstat_t *cs)
+{
+	trace_t *trace;
+	double secs;
+
+	if (stream_mode)
+	{
+		if (verbose > 1)
+			printf("Streaming tracefile: %s\n", tracefile);
+		eval_mm_stream(tracefile, tracenum, stats, ss);
+		return;
+	}
+	if (verbose > 1)
+		printf("Reading tracefile: %s\n", tracefile);
+	trace = read_trace(tracedir, tracefile);
+	stats->ops = trace->num_ops;
+	if (verbose > 1)
+		printf("Checking mm_malloc for correctness, ");
+	secs = now_secs();
+	stats->valid = eval_mm_valid(trace, tracenum, ranges);
+	stats->valid_secs = now_secs() - secs;
+	if (stats->valid)
+	{
+		if (verbose > 1)
+			printf("efficiency, ");
+		stats->util = eval_mm_util(trace, tracenum, ranges, stats);
+		if (tl != NULL)
+			tl_finish(tracefile, tracenum, tl);
+		if (verbose > 1)
+			printf("and performance.\n");
+		time_mm(trace, *ranges, stats, pc);
+		if (cold != NULL)
+		{
+			eval_mm_coldstart(trace, 0, NULL, &cold[0]);
+			eval_mm_coldstart(trace, heap_hint(trace), &cold[1], &cold[2]);
+		}
+		if (lat != NULL)
+			eval_mm_latency(trace, lat);
+		if (cs != NULL)
+			eval_mm_cachesim(trace, cs);
+	}
+	free_trace(trace);
+}
+
+/*
+ * eval_mm_latency - Replay the trace once, reading the cycle counter
+ *    around every mm_malloc/mm_free/mm_realloc call. The samples go into
+ *    one histogram per request type and size class (frees are classed by
+ *    the size of the block they free), less the cost of reading the
+ *    counter, and are summarized into *lat.
+ */
+static void eval_mm_latency(trace_t *trace, latstat_t *lat)
+{
+	static lathist_t hist[3][LAT_NCLASSES];
+	uint64_t t0, t1, ovhd;
+	int i, k, type, index;
+	size_t size;
+	char *p;
+
+	for (type = 0; type < 3; type++)
+		for (k = 0; k < LAT_NCLASSES; k++)
+			lat_clear(&hist[type][k]);
+	ovhd = lat_overhead();
+
+	mem_reset_brk();
+	if (init_mm(trace) < 0)
+		app_error("mm_init failed in eval_mm_latency");
+
+	for (i = 0; i < trace->num_ops; i++)
+	{
+		type = trace->ops[i].type;
+		index = trace->ops[i].index;
+		size = trace->ops[i].size;
+		switch (type)
+		{
+		case ALLOC:
+			t0 = lat_now();
+			p = mmops->malloc(size);
+			t1 = lat_now();
+			if (p == NULL)
+				app_error("mm_malloc failed in eval_mm_latency");
+			trace->blocks[index] = p;
+			trace->block_sizes[index] = size;
+			break;
+		case REALLOC:
+			t0 = lat_now();
+			p = mmops->realloc(trace->blocks[index], size);
+			t1 = lat_now();
+			if (p == NULL)
+				app_error("mm_realloc failed in eval_mm_latency");
+			trace->blocks[index] = p;
+			trace->block_sizes[index] = size;
+			break;
+		case FREE:
+			size = trace->block_sizes[index];
+			t0 = lat_now();
+			mmops->free(trace->blocks[index]);
+			t1 = lat_now();
+			break;
+		default:
+			app_error("Nonexistent request type in eval_mm_latency");
+		}
+		lat_add(&hist[type][lat_class(size)],
+				(t1 - t0 > ovhd) ? t1 - t0 - ovhd : 0);
+	}
+
+	for (type = 0; type < 3; type++)
+		for (k = 0; k < LAT_NCLASSES; k++)
+			lat_summarize(&hist[type][k], &lat->s[type][k]);
+}
+
+/*
+ * lat_class - The latency histogram size class of a request
+ */
+static int lat_class(size_t size)
+{
+	if (size <= 64)
+		return 0;
+	if (size <= 512)
+		return 1;
+	if (size <= 4096)
+		return 2;
+	return 3;
+}
+
+/* What a -j worker sends back for each trace it evaluated */
+typedef struct
+{
+	int tracenum;
+	int errors; /* errors reported while evaluating the trace */
+	stats_t stats;
+	coldstat_t cold[3];
+	streamstat_t stream;
+	latstat_t lat;
+	pcstat_t pc;
+	tlstat_t tl;
+	csstat_t cs;
+} jobmsg_t;
+
+/*
+ * eval_mm_jobs - Evaluate the traces in num_jobs forked worker processes.
+ *    Worker w takes traces w, w + num_jobs, ... and evaluates them on its
+ *    own copy of the memlib heap, sending a jobmsg_t per trace back over
+ *    a pipe. A worker that dies (e.g. on a segfault in mm.c) leaves its
+ *    remaining traces marked invalid. With --cpu, worker w runs on the
+ *    w-th CPU after the given one.
+ */
+static void eval_mm_jobs(char **tracefiles, int n, stats_t *stats,
+						 coldstat_t *cold, streamstat_t *ss, latstat_t *lat,
+						 pcstat_t *pc, tlstat_t *tl, csstat_t *cs)
+{
+	int njobs = (num_jobs < n) ? num_jobs : n;
+	int *done, i, w, live, status;
+	pid_t *pids;
+	struct pollfd *fds;
+	range_t *ranges = NULL;
+	jobmsg_t m;
+
+	if ((pids = (pid_t *)calloc(njobs, sizeof(pid_t))) == NULL ||
+		(fds = (struct pollfd *)calloc(njobs, sizeof(struct pollfd))) == NULL ||
+		(done = (int *)calloc(n, sizeof(int))) == NULL)
+		unix_error("calloc failed in eval_mm_jobs");
+
+	fflush(stdout); /* don't let the workers inherit buffered output */
+	for (w = 0; w < njobs; w++)
+	{
+		int fd[2];
+
+		if (pipe(fd) < 0)
+			unix_error("pipe failed in eval_mm_jobs");
+		if ((pids[w] = fork()) < 0)
+			unix_error("fork failed in eval_mm_jobs");
+		if (pids[w] == 0)
+		{
+			close(fd[0]);
+			if (cpu_pin >= 0)
+				pin_to_cpu((cpu_pin + w) % sysconf(_SC_NPROCESSORS_ONLN));
+			for (i = w; i < n; i += njobs)
+			{
+				memset(&m, 0, sizeof(m));
+				m.tracenum = i;
+				m.errors = errors;
+				eval_mm_trace(tracefiles[i], i, &ranges, &m.stats,
+							  cold ? m.cold : NULL, ss ? &m.stream : NULL,
+							  lat ? &m.lat : NULL, pc ? &m.pc : NULL,
+							  tl ? &m.tl : NULL, cs ? &m.cs : NULL);
+				m.errors = errors - m.errors;
+				if (write_full(fd[1], &m, sizeof(m)) < 0)
+					unix_error("write failed in eval_mm_jobs");
+			}
+			fflush(stdout);
+			_exit(0);
+		}
+		close(fd[1]);
+		fds[w].fd = fd[0];
+		fds[w].events = POLLIN;
+	}
+
+	/* Collect the results in whatever order the workers finish them */
+	for (live = njobs; live > 0;)
+	{
+		if (poll(fds, njobs, -1) < 0)
+			unix_error("poll failed in eval_mm_jobs");
+		for (w = 0; w < njobs; w++)
+		{
+			if (fds[w].fd < 0 || fds[w].revents == 0)
+				continue;
+			if (read_full(fds[w].fd, &m, sizeof(m)) <= 0)
+			{
+				close(fds[w].fd);
+				fds[w].fd = -1;
+				live--;
+				continue;
+			}
+			stats[m.tracenum] = m.stats;
+			if (cold != NULL)
+				memcpy(&cold[3 * m.tracenum], m.cold, sizeof(m.cold));
+			if (ss != NULL)
+				ss[m.tracenum] = m.stream;
+			if (lat != NULL)
+				lat[m.tracenum] = m.lat;
+			if (pc != NULL)
+				pc[m.tracenum] = m.pc;
+			if (tl != NULL)
+				tl[m.tracenum] = m.tl;
+			if (cs != NULL)
+				cs[m.tracenum] = m.cs;
+			errors += m.errors;
+			done[m.tracenum] = 1;
+		}
+	}
+
+	for (w = 0; w < njobs; w++)
+		if (waitpid(pids[w], &status, 0) > 0 &&
+			!(WIFEXITED(status) && WEXITSTATUS(status) == 0))
+			printf("ERROR: worker %d exited abnormally\n", w);
+	for (i = 0; i < n; i++)
+		if (!done[i])
+		{
+			memset(&stats[i], 0, sizeof(stats_t));
+			malloc_error(i, 0, "trace was not evaluated (worker died).");
+		}
+
+	free(pids);
+	free(fds);
+	free(done);
+}
+
+/*
+ * retime_mm - Measure the throughput of the valid traces again, one at
+ *    a time, so that the -j workers' numbers are not skewed by competing
+ *    for the CPUs and caches.
+ */
+static void retime_mm(char **tracefiles, int n, range_t **ranges, stats_t *stats)
+{
+	trace_t *trace;
+	int i;
+
+	for (i = 0; i < n; i++)
+	{
+		if (!stats[i].valid || stream_mode)
+			continue;
+		trace = read_trace(tracedir, tracefiles[i]);
+		eval_mm_util(trace, i, ranges, NULL); /* sets peak_bytes for -H peak */
+		time_mm(trace, *ranges, &stats[i], NULL);
+		free_trace(trace);
+	}
+}
+
+/*
+ * read_full/write_full - pipe I/O that retries short transfers.
+ *    read_full returns 0 at end of file, -1 on error.
+ */
+static int read_full(int fd, void *buf, size_t n)
+{
+	char *p = buf;
+	ssize_t r;
+
+	while (n > 0)
+	{
+		if ((r = read(fd, p, n)) <= 0)
+		{
+			if (r < 0 && errno == EINTR)
+				continue;
+			return (r < 0) ? -1 : 0;
+		}
+		p += r;
+		n -= r;
+	}
+	return 1;
+}
+
+static int write_full(int fd, const void *buf, size_t n)
+{
+	const char *p = buf;
+	ssize_t r;
+
+	while (n > 0)
+	{
+		if ((r = write(fd, p, n)) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		p += r;
+		n -= r;
+	}
+	return 0;
+}
+
+/*
+ * eval_scaling - Replay every trace on 1..max_threads threads, in both
+ *    MT_COPY and MT_PARTITION mode, with mm malloc and optionally with
+ *    libc malloc, and print a scaling table for each allocator. Each
+ *    replay does MT_REPS passes over the trace and is timed by the wall
+ *    clock from the first thread start to the last thread end.
+ */
+static void eval_scaling(char **tracefiles, int n, int run_libc)
+{
+	mt_alloc_t allocs[] = {
+		{NULL, NULL, NULL, NULL},
+		{"libc malloc", malloc, free, realloc}};
+	char name[MAXLINE];
+	int nallocs = run_libc ? 2 : 1;
+	mt_result_t *res, r;
+	trace_t *trace;
+	int i, k, mode, t;
+
+	/* A memlib backend without a lock would corrupt its heap */
+	if ((mmops->flags & MM_OPS_MEMLIB) && mmops->set_threadsafe == NULL)
+	{
+		printf("\n%s is not thread-safe, skipping -T\n", mmops->name);
+		return;
+	}
+	sprintf(name, "%s malloc", mmops->name);
+	allocs[0].name = name;
+	allocs[0].malloc_fn = mmops->malloc;
+	allocs[0].free_fn = mmops->free;
+	allocs[0].realloc_fn = mmops->realloc;
+
+	/* res[(k * 2 + mode) * max_threads + t - 1]: sums over all traces */
+	if ((res = (mt_result_t *)calloc(nallocs * 2 * max_threads,
+									 sizeof(mt_result_t))) == NULL)
+		unix_error("calloc failed in eval_scaling");
+
+	if (mmops->set_threadsafe != NULL)
+		mmops->set_threadsafe(1);
+	for (i = 0; i < n; i++)
+	{
+		if (verbose > 1)
+			printf("Threaded replays of %s\n", tracefiles[i]);
+		trace = read_trace(tracedir, tracefiles[i]);
+		for (k = 0; k < nallocs; k++)
+			for (mode = MT_COPY; mode <= MT_PARTITION; mode++)
+				for (t = 1; t <= max_threads; t++)
+				{
+					if (k == 0 && mm_init_threadsafe() < 0)
+						app_error("mm_init failed in eval_scaling");
+					mt_replay(trace, &allocs[k], mode, t, MT_REPS, &r);
+					res[(k * 2 + mode) * max_threads + t - 1].wall_secs += r.wall_secs;
+					res[(k * 2 + mode) * max_threads + t - 1].ops += r.ops;
+					res[(k * 2 + mode) * max_threads + t - 1].thread_secs += r.thread_secs;
+				}
+		free_trace(trace);
+	}
+	if (mmops->set_threadsafe != NULL)
+		mmops->set_threadsafe(0);
+
+	for (k = 0; k < nallocs; k++)
+		print_scaling(&allocs[k], &res[k * 2 * max_threads]);
+	printf("\n");
+	free(res);
+}
+
+/*
+ * mm_init_threadsafe - Start a threaded replay with an empty mm heap
+ */
+static int mm_init_threadsafe(void)
+{
+	mem_reset_brk();
+	return mmops->init();
+}
+
+/*
+ * eval_ab - --ab: evaluate two allocator libraries head to head on every
+ *    trace. Both are loaded at once, each with its own memlib heap. The
+ *    timed runs of the two are interleaved, A B, B A, A B, ..., so that
+ *    whatever the machine does meanwhile slows both alike, and each
+ *    round yields the ratio of B's time to A's. The throughput change
+ *    is the median ratio, with a 95% confidence interval.
+ */
+static void eval_ab(char **tracefiles, int n)
+{
+	mmdl_t lib[2];
+	stats_t *stats[2], null;
+	abstat_t *ab;
+	speed_t params;
+	trace_t *trace;
+	double *times[2], *ratio, off;
+	int rounds = (num_reps > AB_ROUNDS) ? num_reps : AB_ROUNDS;
+	int i, r, k, s;
+
+	for (s = 0; s < 2; s++)
+	{
+		if (mmdl_open(&lib[s], ab_libs[s]) < 0)
+		{
+			fprintf(stderr, "Cannot load %s\n", mmdl_error());
+			exit(1);
+		}
+		if ((stats[s] = (stats_t *)calloc(n, sizeof(stats_t))) == NULL ||
+			(times[s] = (double *)malloc(rounds * sizeof(double))) == NULL)
+			unix_error("calloc failed in eval_ab");
+	}
+	if ((ab = (abstat_t *)calloc(n, sizeof(abstat_t))) == NULL ||
+		(ratio = (double *)malloc(rounds * sizeof(double))) == NULL)
+		unix_error("calloc failed in eval_ab");
+
+	params.ranges = NULL;
+	params.first_op = 0;
+	params.saved_blocks = NULL;
+	for (i = 0; i < n; i++)
+	{
+		if (verbose > 1)
+			printf("Reading tracefile: %s\n", tracefiles[i]);
+		trace = read_trace(tracedir, tracefiles[i]);
+		params.trace = trace;
+		for (s = 0; s < 2; s++)
+		{
+			stats[s][i].ops = trace->num_ops;
+			stats[s][i].valid = eval_ab_util(&lib[s], trace, i, &stats[s][i].util);
+		}
+		if (!stats[0][i].valid || !stats[1][i].valid)
+		{
+			free_trace(trace);
+			continue;
+		}
+
+		off = 0;
+		if (calibrate)
+		{
+			time_speed(eval_null_speed, &params, &null);
+			off = null.secs;
+		}
+		for (s = 0; s < 2; s++)
+		{
+			params.lib = &lib[s];
+			for (r = 0; r < num_warmup; r++)
+				eval_ab_speed(&params);
+		}
+		for (r = 0; r < rounds; r++)
+		{
+			for (k = 0; k < 2; k++)
+			{
+				s = (r + k) % 2;
+				params.lib = &lib[s];
+				times[s][r] = fmax(fsecs(eval_ab_speed, &params) - off, 1e-9);
+			}
+			ratio[r] = times[1][r] / times[0][r];
+		}
+		for (s = 0; s < 2; s++)
+		{
+			summarize_times(times[s], rounds, &stats[s][i]);
+			stats[s][i].secs_null = off;
+		}
+		median_ci(ratio, rounds, &ab[i].ratio, &ab[i].ratio_lo, &ab[i].ratio_hi);
+		free_trace(trace);
+	}
+
+	print_ab(n, lib, stats, ab, rounds);
+	for (s = 0; s < 2; s++)
+	{
+		mmdl_close(&lib[s]);
+		free(stats[s]);
+		free(times[s]);
+	}
+	free(ab);
+	free(ratio);
+}
+
+/*
+ * eval_ab_util - Replay trace once with an --ab library and store its
+ *    utilization (peak live payload over the final heap size, as in
+ *    eval_mm_util) in *util. Every block must be aligned and inside the
+ *    library's heap; returns 0 if one is not. The other checks of
+ *    eval_mm_valid need the allocator linked into the driver.
+ */
+static int eval_ab_util(mmdl_t *lib, trace_t *trace, int tracenum, double *util)
+{
+	size_t live = 0, peak = 0, size;
+	long i;
+	int index;
+	char *p;
+
+	lib->mem_reset_brk();
+	if (lib->mm_init() < 0)
+	{
+		malloc_error(tracenum, 0, "mm_init failed.");
+		return 0;
+	}
+	for (i = 0; i < trace->num_ops; i++)
+	{
+		index = trace->ops[i].index;
+		size = trace->ops[i].size;
+		switch (trace->ops[i].type)
+		{
+		case ALLOC:
+		case REALLOC:
+			if (trace->ops[i].type == ALLOC)
+				p = lib->mm_malloc(size);
+			else
+			{
+				p = lib->mm_realloc(trace->blocks[index], size);
+				live -= trace->block_sizes[index];
+			}
+			if (p == NULL || !IS_ALIGNED(p) || p < (char *)lib->mem_heap_lo() ||
+				p + size > (char *)lib->mem_heap_hi() + 1)
+			{
+				malloc_error(tracenum, i, "block is NULL, misaligned or outside the heap.");
+				return 0;
+			}
+			trace->blocks[index] = p;
+			trace->block_sizes[index] = size;
+			live += size;
+			if (live > peak)
+				peak = live;
+			break;
+
+		case FREE:
+			lib->mm_free(trace->blocks[index]);
+			live -= trace->block_sizes[index];
+			break;
+
+		default:
+			app_error("Nonexistent request type in eval_ab_util");
+		}
+	}
+	*util = (double)peak / lib->mem_heapsize();
+	return 1;
+}
+
+/*
+ * eval_ab_speed - Run a trace with an --ab library, from an empty heap
+ *    (timed by fsecs)
+ */
+static void eval_ab_speed(void *ptr)
+{
+	speed_t *params = (speed_t *)ptr;
+	mmdl_t *lib = params->lib;
+
+	lib->mem_reset_brk();
+	if (lib->mm_init() < 0)
+		app_error("mm_init failed in eval_ab_speed");
+	REPLAY(params->trace, 0, params->trace->num_ops,
+		   lib->mm_malloc, lib->mm_realloc, lib->mm_free);
+}
+
+/*
+ * eval_libc_valid - We run this function to make sure that the
+ *    libc malloc can run to completion on the set of traces.
+ *    We'll be conservative and terminate if any libc malloc call fails.
+ *
+ */
+static int eval_libc_valid(trace_t *trace, int tracenum)
+{
+	int i, newsize;
+	char *p, *newp, *oldp;
+
+	for (i = 0; i < trace->num_ops; i++)
+	{
+		switch (trace->ops[i].type)
+		{
+
+		case ALLOC: /* malloc */
+			if ((p = malloc(trace->ops[i].size)) == NULL)
+			{
+				malloc_error(tracenum, i, "libc malloc failed");
+				unix_error("System message");
+			}
+			trace->blocks[trace->ops[i].index] = p;
 			break;
 
 		case REALLOC: /* realloc */
@@ -925,40 +2533,9 @@ static int eval_libc_valid(trace_t *trace, int tracenum)
  */
 static void eval_libc_speed(void *ptr)
 {
-	int i;
-	int index, size, newsize;
-	char *p, *newp, *oldp, *block;
 	trace_t *trace = ((speed_t *)ptr)->trace;
 
-	for (i = 0; i < trace->num_ops; i++)
-	{
-		switch (trace->ops[i].type)
-		{
-		case ALLOC: /* malloc */
-			index = trace->ops[i].index;
-			size = trace->ops[i].size;
-			if ((p = malloc(size)) == NULL)
-				unix_error("malloc failed in eval_libc_speed");
-			trace->blocks[index] = p;
-			break;
-
-		case REALLOC: /* realloc */
-			index = trace->ops[i].index;
-			newsize = trace->ops[i].size;
-			oldp = trace->blocks[index];
-			if ((newp = realloc(oldp, newsize)) == NULL)
-				unix_error("realloc failed in eval_libc_speed\n");
-
-			trace->blocks[index] = newp;
-			break;
-
-		case FREE: /* free */
-			index = trace->ops[i].index;
-			block = trace->blocks[index];
-			free(block);
-			break;
-		}
-	}
+	REPLAY(trace, 0, trace->num_ops, malloc, realloc, free);
 }
 
 /*************************************
@@ -966,7 +2543,11 @@ static void eval_libc_speed(void *ptr)
  ************************************/
 
 /*
- * printresults - prints a performance summary for some malloc package
+ * printresults - prints a performance summary for some malloc package.
+ *     secs is the median of the -R runs; with -R 2 or more the ci95
+ *     column is the half-width of its confidence interval, and with
+ *     --calibrate the loop column is the null allocator's time that was
+ *     taken off it.
  */
 static void printresults(int n, stats_t *stats)
 {
@@ -974,33 +2555,55 @@ static void printresults(int n, stats_t *stats)
 	double secs = 0;
 	double ops = 0;
 	double util = 0;
+	double tutil = 0;
+	int measured = 1;  /* 0 if util was not measured (-A libc) */
+	int tmeasured = 1; /* 0 if tutil was not measured (-A libc, -S) */
 
 	/* Print the individual results for each trace */
-	printf("%5s%7s %5s%8s%10s%6s\n",
-		   "trace", " valid", "util", "ops", "secs", "Kops");
+	printf("%5s%7s %5s%6s%8s%10s%7s%10s%8s%7s",
+		   "trace", " valid", "util", "tutil", "ops", "secs", "Kops", "vsecs",
+		   "faults", "rflts");
+	if (num_reps > 1)
+		printf("%8s", "ci95");
+	if (calibrate)
+		printf("%10s", "loop");
+	printf("\n");
 	for (i = 0; i < n; i++)
 	{
 		if (stats[i].valid)
 		{
-			printf("%2d%10s%5.0f%%%8.0f%10.6f%6.0f\n",
-				   i,
-				   "yes",
-				   stats[i].util * 100.0,
+			printf("%2d%10s", i, "yes");
+			print_pct(stats[i].util);
+			print_pct(stats[i].tutil);
+			printf("%8.0f%10.6f%7.0f%10.6f%8.0f%7.1f",
 				   stats[i].ops,
 				   stats[i].secs,
-				   (stats[i].ops / 1e3) / stats[i].secs);
+				   (stats[i].ops / 1e3) / stats[i].secs,
+				   stats[i].valid_secs,
+				   stats[i].faults,
+				   stats[i].run_faults);
+			if (num_reps > 1)
+				printf("%7.1f%%", 50.0 * (stats[i].secs_hi - stats[i].secs_lo) /
+									  stats[i].secs);
+			if (calibrate)
+				printf("%10.6f", stats[i].secs_null);
+			printf("\n");
 			secs += stats[i].secs;
 			ops += stats[i].ops;
 			util += stats[i].util;
+			tutil += stats[i].tutil;
+			measured = measured && stats[i].util >= 0;
+			tmeasured = tmeasured && stats[i].tutil >= 0;
 		}
 		else
 		{
-			printf("%2d%10s%6s%8s%10s%6s\n",
+			printf("%2d%10s%6s%6s%8s%10s%7s\n",
 				   i,
 				   "no",
 				   "-",
 				   "-",
 				   "-",
+				   "-",
 				   "-");
 		}
 	}
@@ -1008,24 +2611,442 @@ static void printresults(int n, stats_t *stats)
 	/* Print the aggregate results for the set of traces */
 	if (errors == 0)
 	{
-		printf("%12s%5.0f%%%8.0f%10.6f%6.0f\n",
-			   "Total       ",
-			   (util / n) * 100.0,
+		printf("%12s", "Total       ");
+		print_pct(measured ? util / n : -1);
+		print_pct(tmeasured ? tutil / n : -1);
+		printf("%8.0f%10.6f%7.0f\n",
 			   ops,
 			   secs,
 			   (ops / 1e3) / secs);
 	}
 	else
 	{
-		printf("%12s%6s%8s%10s%6s\n",
+		printf("%12s%6s%6s%8s%10s%7s\n",
 			   "Total       ",
 			   "-",
 			   "-",
 			   "-",
+			   "-",
 			   "-");
 	}
 }
 
+/*
+ * print_pct - Print a util column of printresults: frac as a percentage,
+ *     or "-" if it is < 0 (not measured)
+ */
+static void print_pct(double frac)
+{
+	if (frac < 0)
+		printf("%6s", "-");
+	else
+		printf("%5.0f%%", frac * 100.0);
+}
+
+/*
+ * time_speed - Run f num_warmup times untimed, then time it num_reps
+ *     times with fsecs and summarize the times into *stats
+ */
+static void time_speed(fsecs_test_funct f, speed_t *params, stats_t *stats)
+{
+	double *times;
+	int r;
+
+	if ((times = (double *)malloc(num_reps * sizeof(double))) == NULL)
+		unix_error("malloc failed in time_speed");
+	for (r = 0; r < num_warmup; r++)
+	{
+		if (params->saved_blocks != NULL) /* --steady */
+			steady_restore(params);
+		f(params);
+	}
+	for (r = 0; r < num_reps; r++)
+		times[r] = fsecs(f, params);
+	summarize_times(times, num_reps, stats);
+	free(times);
+}
+
+/*
+ * summarize_times - Store the median of the n run times in t (which
+ *     get sorted), its 95% confidence interval and the sample standard
+ *     deviation in *stats
+ */
+static void summarize_times(double *t, int n, stats_t *stats)
+{
+	double sum = 0, sumsq = 0, var;
+	int i;
+
+	for (i = 0; i < n; i++)
+	{
+		sum += t[i];
+		sumsq += t[i] * t[i];
+	}
+	median_ci(t, n, &stats->secs, &stats->secs_lo, &stats->secs_hi);
+	stats->reps = n;
+	var = (n > 1) ? (sumsq - sum * sum / n) / (n - 1) : 0;
+	stats->secs_sd = (var > 0) ? sqrt(var) : 0;
+}
+
+/*
+ * median_ci - Sort the n values in t and return their median in *med
+ *     and a 95% confidence interval of it in *lo and *hi. The interval
+ *     runs between the order statistics whose ranks bound the middle 95%
+ *     of a binomial(n, 1/2), so it assumes nothing about how the values
+ *     are distributed; up to 10 values it is simply [min, max].
+ */
+static void median_ci(double *t, int n, double *med, double *lo, double *hi)
+{
+	double h = CI_Z * sqrt(n) / 2;
+	int j = (int)floor(n / 2.0 - h);	/* 1-based ranks */
+	int k = (int)ceil(n / 2.0 + h + 1);
+
+	qsort(t, n, sizeof(double), cmp_double);
+	*med = (n % 2) ? t[n / 2] : (t[n / 2 - 1] + t[n / 2]) / 2;
+	*lo = t[(j < 1) ? 0 : j - 1];
+	*hi = t[(k > n) ? n - 1 : k - 1];
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+/*
+ * calibrate_speed - --calibrate: time the replay of *params against the
+ *     null allocator the same way and take its median off the time in
+ *     *stats and both ends of its interval, which leaves the time spent
+ *     in the allocator itself. The null replay runs the same loop, so
+ *     what is taken off is the trace reads, the block table updates and
+ *     the call overhead. Times never go below 1 ns.
+ */
+static void calibrate_speed(speed_t *params, stats_t *stats)
+{
+	stats_t null;
+
+	time_speed(eval_null_speed, params, &null);
+	stats->secs_null = null.secs;
+	stats->secs = fmax(stats->secs - null.secs, 1e-9);
+	stats->secs_lo = fmax(stats->secs_lo - null.secs, 1e-9);
+	stats->secs_hi = fmax(stats->secs_hi - null.secs, 1e-9);
+}
+
+/*
+ * pin_to_cpu - Run the driver on cpu only, so that timings do not move
+ *     between cores (and their caches) halfway through
+ */
+static void pin_to_cpu(int cpu)
+{
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (sched_setaffinity(0, sizeof(set), &set) < 0)
+	{
+		fprintf(stderr, "Cannot run on CPU %d: %s\n", cpu, strerror(errno));
+		exit(1);
+	}
+}
+
+/*
+ * print_coldstart - prints the cold-start costs measured for -H. For each
+ *     trace, cold[3i] is the first phase after mm_init, and cold[3i+1]
+ *     and cold[3i+2] are mm_init_hint itself and the phase after it.
+ */
+static void print_coldstart(int n, coldstat_t *cold)
+{
+	int i;
+
+	printf("\nCold start, first 1/%d of each trace (sbrk calls, minor faults):\n",
+		   COLD_PHASE);
+	printf("%5s%14s%14s%14s%14s\n",
+		   "trace", "mm_init", "hint init", "hint phase", "fault ratio");
+	for (i = 0; i < n; i++)
+	{
+		coldstat_t *base = &cold[3 * i];
+		coldstat_t *init = &cold[3 * i + 1];
+		coldstat_t *phase = &cold[3 * i + 2];
+
+		printf("%2d%8zu/%5ld%8zu/%5ld%8zu/%5ld%13.0f%%\n",
+			   i,
+			   base->sbrks, base->faults,
+			   init->sbrks, init->faults,
+			   phase->sbrks, phase->faults,
+			   base->faults ? 100.0 * phase->faults / base->faults : 100.0);
+	}
+}
+
+/*
+ * print_stream - Print the bookkeeping of the streamed replays
+ */
+static void print_stream(int n, streamstat_t *ss)
+{
+	int i;
+
+	printf("\nStreamed replay (driver memory tracks the live set):\n");
+	printf("%5s%12s%14s%10s\n", "trace", "max live", "id table KB", "skipped");
+	for (i = 0; i < n; i++)
+		printf("%2d%15zu%14zu%10ld\n",
+			   i, ss[i].max_live, ss[i].map_bytes / 1024, ss[i].skipped);
+}
+
+/*
+ * print_timeline - Print the summary of the heap timeline of every trace
+ */
+static void print_timeline(int n, tlstat_t *tl)
+{
+	int i;
+
+	printf("\nHeap timeline, sampled every %ld ops%s:\n", tl_every,
+		   mmops->heapstats ? "" : " (the allocator has no heapstats)");
+	printf("%5s%9s%15s%12s%10s%16s\n", "trace", "samples", "max waste KB",
+		   "max free", "max frag", "end largest KB");
+	for (i = 0; i < n; i++)
+		printf("%2d%12ld%15zu%12zu%9.0f%%%16zu\n", i, tl[i].samples,
+			   tl[i].max_waste / 1024, tl[i].max_free_blocks,
+			   tl[i].max_frag * 100, tl[i].end_largest / 1024);
+}
+
+/*
+ * print_scaling - Print the threaded replay results of one allocator.
+ *     res holds max_threads results for MT_COPY followed by max_threads
+ *     results for MT_PARTITION. Efficiency is the aggregate throughput
+ *     with t threads divided by t times the throughput with one thread.
+ */
+static void print_scaling(const mt_alloc_t *a, mt_result_t *res)
+{
+	mt_result_t *copy, *part;
+	int t;
+
+	printf("\nThread scaling for %s (all traces, %d passes each):\n",
+		   a->name, MT_REPS);
+	printf("%7s  %-32s  %-32s\n", "",
+		   "copy (private copy per thread)", "partition (cross-thread frees)");
+	printf("%7s%10s%12s%10s  %10s%12s%10s\n", "threads",
+		   "Kops", "Kops/thread", "eff", "Kops", "Kops/thread", "eff");
+	for (t = 1; t <= max_threads; t++)
+	{
+		copy = &res[t - 1];
+		part = &res[max_threads + t - 1];
+		printf("%7d%10.0f%12.0f%9.0f%%  %10.0f%12.0f%9.0f%%\n", t,
+			   copy->ops / copy->wall_secs / 1e3,
+			   copy->ops / copy->thread_secs / 1e3,
+			   100.0 * (copy->ops / copy->wall_secs) /
+				   (t * res[0].ops / res[0].wall_secs),
+			   part->ops / part->wall_secs / 1e3,
+			   part->ops / part->thread_secs / 1e3,
+			   100.0 * (part->ops / part->wall_secs) /
+				   (t * res[max_threads].ops / res[max_threads].wall_secs));
+	}
+}
+
+/*
+ * print_ab - Print the --ab comparison: utilization and throughput of B
+ *     against A for each trace and in total. A "*" marks throughput
+ *     changes whose 95% confidence interval excludes 0.
+ */
+static void print_ab(int n, mmdl_t *lib, stats_t **stats, abstat_t *ab,
+					 int rounds)
+{
+	stats_t *a, *b;
+	double util[2] = {0, 0}, ops = 0, secs[2] = {0, 0}, lo, hi, p1, p2;
+	int i, s, valid = 1;
+
+	printf("\nA: %s\nB: %s\n", lib[0].path, lib[1].path);
+	printf("Head to head, %d interleaved rounds per trace%s:\n", rounds,
+		   calibrate ? ", less the null allocator's time" : "");
+	printf("%5s%9s%9s%8s%10s%10s%9s%20s\n", "trace", "util A", "util B",
+		   "change", "Kops A", "Kops B", "change", "95% CI");
+	for (i = 0; i < n; i++)
+	{
+		a = &stats[0][i];
+		b = &stats[1][i];
+		if (!a->valid || !b->valid)
+		{
+			printf("%2d%9s%9s\n", i, a->valid ? "" : "failed",
+				   b->valid ? "" : "failed");
+			valid = 0;
+			continue;
+		}
+		lo = 100.0 * (1 / ab[i].ratio_hi - 1);
+		hi = 100.0 * (1 / ab[i].ratio_lo - 1);
+		printf("%2d%11.1f%%%8.1f%%%+8.1f%10.0f%10.0f%+8.1f%%  [%+6.1f%%, %+6.1f%%] %s\n",
+			   i, a->util * 100, b->util * 100, (b->util - a->util) * 100,
+			   (a->ops / 1e3) / a->secs, (b->ops / 1e3) / b->secs,
+			   100.0 * (1 / ab[i].ratio - 1), lo, hi,
+			   (lo > 0 || hi < 0) ? "*" : "");
+		for (s = 0; s < 2; s++)
+		{
+			util[s] += stats[s][i].util;
+			secs[s] += stats[s][i].secs;
+		}
+		ops += a->ops;
+	}
+	if (!valid)
+		return;
+	printf("%-5s%8.1f%%%8.1f%%%+8.1f%10.0f%10.0f%+8.1f%%\n", "Total",
+		   util[0] / n * 100, util[1] / n * 100, (util[1] - util[0]) / n * 100,
+		   (ops / 1e3) / secs[0], (ops / 1e3) / secs[1],
+		   100.0 * (secs[0] / secs[1] - 1));
+	printf("Perf index A = %.0f", perf_index(n, stats[0], &p1, &p2));
+	printf(", B = %.0f\n", perf_index(n, stats[1], &p1, &p2));
+}
+
+/*
+ * print_latency - Print the latency percentiles of every trace, one row
+ *     per request type and size class that occurs in it
+ */
+static void print_latency(int n, latstat_t *lat)
+{
+	static char *ops[3] = {"malloc", "free", "realloc"};
+	static char *classes[LAT_NCLASSES] = {"1-64", "65-512", "513-4K", ">4K"};
+	latsum_t *s;
+	int i, type, k;
+
+	printf("\nLatency per request in ns (timer overhead subtracted):\n");
+	printf("%5s  %-8s%-8s%9s%9s%9s%9s%9s%10s\n", "trace", "op", "size",
+		   "count", "p50", "p90", "p99", "p99.9", "max");
+	for (i = 0; i < n; i++)
+		for (type = 0; type < 3; type++)
+			for (k = 0; k < LAT_NCLASSES; k++)
+			{
+				s = &lat[i].s[type][k];
+				if (s->n == 0)
+					continue;
+				printf("%2d     %-8s%-8s%9lu%9.0f%9.0f%9.0f%9.0f%10.0f\n",
+					   i, ops[type], classes[k], (unsigned long)s->n,
+					   s->pct[0], s->pct[1], s->pct[2], s->pct[3], s->max);
+			}
+	printf("\n");
+}
+
+/*
+ * print_perfctr - Print the hardware counts of the timed run of every
+ *     valid trace, per op, next to its throughput. Events that could not
+ *     be counted show as "-".
+ */
+static void print_perfctr(int n, stats_t *stats, pcstat_t *pc)
+{
+	static char *names[PC_NEVENTS] = {"cyc/op", "instr/op", "LLCmiss/op",
+									  "dTLBmiss/op", "brmiss/op"};
+	pcstat_t total;
+	double ops = 0, secs = 0;
+	int i, e;
+
+	printf("\nHardware counters per op (one timed run per trace):\n");
+	printf("%5s%8s", "trace", "Kops");
+	for (e = 0; e < PC_NEVENTS; e++)
+		printf("%12s", names[e]);
+	printf("%7s\n", "IPC");
+	memset(&total, 0, sizeof(total));
+	for (i = 0; i < n; i++)
+	{
+		if (!stats[i].valid)
+			continue;
+		printf("%2d%11.0f", i, (stats[i].ops / 1e3) / stats[i].secs);
+		print_pcrow(&pc[i], stats[i].ops);
+		for (e = 0; e < PC_NEVENTS; e++)
+			if (pc[i].count[e] < 0 || total.count[e] < 0)
+				total.count[e] = -1;
+			else
+				total.count[e] += pc[i].count[e];
+		ops += stats[i].ops;
+		secs += stats[i].secs;
+	}
+	if (ops == 0)
+		return;
+	printf("%-5s%8.0f", "Total", (ops / 1e3) / secs);
+	print_pcrow(&total, ops);
+	printf("\n");
+}
+
+/*
+ * print_pcrow - Print the counts in *pc divided by ops, and the IPC
+ */
+static void print_pcrow(pcstat_t *pc, double ops)
+{
+	int e;
+
+	for (e = 0; e < PC_NEVENTS; e++)
+		if (pc->count[e] < 0)
+			printf("%12s", "-");
+		else
+			printf("%12.2f", pc->count[e] / ops);
+	if (pc->count[PC_CYCLES] > 0 && pc->count[PC_INSTR] >= 0)
+		printf("%7.2f\n", pc->count[PC_INSTR] / pc->count[PC_CYCLES]);
+	else
+		printf("%7s\n", "-");
+}
+
+/*
+ * eval_mm_cachesim - Replay the trace once on an empty heap with the
+ *    cache model on, counting the allocator's metadata accesses after
+ *    mm_init into *cs. Only mdriver-cachesim feeds the model.
+ */
+static void eval_mm_cachesim(trace_t *trace, csstat_t *cs)
+{
+	mem_reset_brk();
+	if (init_mm(trace) < 0)
+		app_error("mm_init failed in eval_mm_cachesim");
+	cs_start(mem_heap_lo());
+	mm_replay(trace, 0, trace->num_ops);
+	cs_stop(cs);
+}
+
+/*
+ * print_cachesim - Print the simulated metadata accesses and misses per
+ *    op of every valid trace, and over all of them
+ */
+static void print_cachesim(int n, stats_t *stats, csstat_t *cs)
+{
+	csstat_t total;
+	double ops = 0;
+	int i;
+
+	printf("\nSimulated metadata accesses per op (%s):\n", cs_describe());
+	printf("%5s%10s%10s%10s%10s%10s\n",
+		   "trace", "loads", "stores", "L1miss", "L2miss", "TLBmiss");
+	memset(&total, 0, sizeof(total));
+	for (i = 0; i <= n; i++)
+	{
+		csstat_t *c = (i < n) ? &cs[i] : &total;
+		double k = (i < n) ? stats[i].ops : ops;
+
+		if (i < n && !stats[i].valid)
+			continue;
+		if (i == n && ops == 0)
+			break;
+		if (i < n)
+			printf("%2d   ", i);
+		else
+			printf("%-5s", "Total");
+		printf("%10.2f%10.2f%10.3f%10.3f%10.3f\n", c->loads / k,
+			   c->stores / k, c->l1_miss / k, c->l2_miss / k, c->tlb_miss / k);
+		if (i < n)
+		{
+			total.loads += c->loads;
+			total.stores += c->stores;
+			total.l1_miss += c->l1_miss;
+			total.l2_miss += c->l2_miss;
+			total.tlb_miss += c->tlb_miss;
+			ops += k;
+		}
+	}
+	printf("\n");
+}
+
+/*
+ * now_secs - wall clock time in seconds
+ */
+static double now_secs(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + 1E-6 * tv.tv_usec;
+}
+
 /*
  * app_error - Report an arbitrary application error
  */
@@ -1058,14 +3079,44 @@ void malloc_error(int tracenum, int opnum, char *msg)
  */
 static void usage(void)
 {
-	fprintf(stderr, "Usage: mdriver [-hvVal] [-f <file>] [-t <dir>]\n");
+	fprintf(stderr, "Usage: mdriver [-hvValLPsS] [-A <backend>] [-f <file>] [-t <dir>] [-H sugg|peak] [-j <n>] [-R <n>] [-T <n>] [-U <k>]\n");
+	fprintf(stderr, "               [--json <file>] [--csv <file>] [--compare <baseline.json>] [--threshold <pct>]\n");
+	fprintf(stderr, "               [--timeline <file>] [--steady <pct>] [--steady-fork]\n");
+	fprintf(stderr, "               [--warmup <n>] [--calibrate] [--cpu <n>] [--ab <a.so>,<b.so>]\n");
+	fprintf(stderr, "               [--cachesim[=<geom>]]\n");
 	fprintf(stderr, "Options\n");
 	fprintf(stderr, "\t-a         Don't check the team structure.\n");
+	fprintf(stderr, "\t-A <name>  Evaluate this allocator: mm, seg, sdfs or libc (default %s).\n",
+			DEFAULT_BACKEND);
 	fprintf(stderr, "\t-f <file>  Use <file> as the trace file.\n");
 	fprintf(stderr, "\t-g         Generate summary info for autograder.\n");
 	fprintf(stderr, "\t-h         Print this message.\n");
+	fprintf(stderr, "\t-H <hint>  Pre-size the heap with mm_init_hint (sugg: trace header, peak: measured).\n");
+	fprintf(stderr, "\t-j <n>     Evaluate the mm traces in n worker processes.\n");
 	fprintf(stderr, "\t-l         Run libc malloc as well.\n");
+	fprintf(stderr, "\t-L         Print per-request latency percentiles for mm malloc.\n");
+	fprintf(stderr, "\t-P         Count cache/dTLB/branch misses per op with perf_event_open.\n");
+	fprintf(stderr, "\t-R <n>     Time each trace n times and report the median and its 95%% CI.\n");
+	fprintf(stderr, "\t-s         With -j, re-measure throughput serially afterwards.\n");
+	fprintf(stderr, "\t-S         Stream the traces instead of loading them (no overlap checks).\n");
+	fprintf(stderr, "\t-U <k>     Sample live bytes, heap size and free blocks every k ops.\n");
 	fprintf(stderr, "\t-t <dir>   Directory to find default traces.\n");
+	fprintf(stderr, "\t-T <n>     Measure scaling with 1..n threads (with -l for libc too).\n");
 	fprintf(stderr, "\t-v         Print per-trace performance breakdowns.\n");
 	fprintf(stderr, "\t-V         Print additional debug info.\n");
+	fprintf(stderr, "\t--json <file>      Write the per-trace results and environment as JSON.\n");
+	fprintf(stderr, "\t--csv <file>       Write the per-trace results as CSV.\n");
+	fprintf(stderr, "\t--compare <file>   Flag regressions against a --json baseline (exit status 2).\n");
+	fprintf(stderr, "\t--threshold <pct>  Smallest slowdown or util loss that counts (default 5).\n");
+	fprintf(stderr, "\t--timeline <file>  Write the -U samples as CSV (default -U 100).\n");
+	fprintf(stderr, "\t--steady <pct>     Replay the first pct%% of each trace once and time only the\n");
+	fprintf(stderr, "\t                   rest, restarting each run from a heap checkpoint.\n");
+	fprintf(stderr, "\t--steady-fork      Restart each run from a fork instead (default --steady 50).\n");
+	fprintf(stderr, "\t--warmup <n>       Run each trace n times untimed before timing it (default 0).\n");
+	fprintf(stderr, "\t--calibrate        Subtract the time of the same replay on a null allocator.\n");
+	fprintf(stderr, "\t--cpu <n>          Pin the driver to CPU n (-j workers to n, n+1, ...).\n");
+	fprintf(stderr, "\t--ab <a.so>,<b.so> Compare two allocator libraries (make ablibs) head to head.\n");
+	fprintf(stderr, "\t--cachesim[=<geom>] Simulated L1/L2/TLB misses of the allocator's metadata\n");
+	fprintf(stderr, "\t                   accesses per op (mdriver-cachesim only). geom: l1=32k/8,\n");
+	fprintf(stderr, "\t                   l2=1m/16,line=64,tlb=64/4,page=4k (the defaults).\n");
 }
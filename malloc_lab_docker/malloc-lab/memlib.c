@@ -2,44 +2,245 @@
  * memlib.c - a module that simulates the memory system.  Needed because it 
  *            allows us to interleave calls from the student's malloc package 
  *            with the system's malloc package in libc.
+ *
+ *            The default heap is anonymous memory that the OS backs
+ *            lazily (mem_init_anon, which mmshim.c also uses to run real
+ *            programs on mm.c with a larger reservation). The heap can
+ *            also be mapped from a file (mem_init_file) or from a POSIX
+ *            shared memory object (mem_init_shared). In that case a small
+ *            header page in front of the heap records the brk, so every
+ *            process that maps the same object sees the same heap.
  */
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <string.h>
 #include <errno.h>
 
 #include "memlib.h"
 #include "config.h"
 
+/* Header stored in the first page of a mapped heap */
+#define MEM_MAGIC 0x4d454d4c49423031UL /* "MEMLIB01" */
+#define MEM_HDR_USED 64 /* bytes of the header page memlib keeps for itself */
+
+typedef struct {
+    unsigned long magic;   /* MEM_MAGIC once the mapping is initialized */
+    unsigned long mapsize; /* size of the whole mapping in bytes */
+    unsigned long brk;     /* heap size in bytes (brk - heap start) */
+} mem_hdr_t;
+
 /* private variables */
 static char *mem_start_brk;  /* points to first byte of heap */
 static char *mem_brk;        /* points to last byte of heap */
 static char *mem_max_addr;   /* largest legal heap address */ 
 
+static mem_hdr_t *mem_hdr = NULL;   /* header of a mapped heap (NULL if malloc'd) */
+static size_t mem_maplen = 0;       /* length of the mapping, header included */
+static size_t mem_mapsize = PERSIST_HEAP; /* requested size of mapped heaps */
+static size_t mem_nsbrk = 0;        /* number of successful mem_sbrk calls */
+static size_t mem_maxheap = MAX_HEAP; /* size of the default heap model */
+static size_t mem_anonlen = 0;      /* length of an anonymous heap (0 if none) */
+static char *mem_ckpt = NULL;       /* copy of the heap saved by mem_checkpoint */
+static size_t mem_ckpt_len = 0;     /* its length (the brk when it was saved) */
+
 /* 
- * mem_init - initialize the memory system model
+ * mem_init - initialize the memory system model. The storage is mapped
+ *     rather than malloc'd, so that it starts page aligned and untouched
+ *     and mem_resident_pages counts only what the allocator touched.
+ *     Huge pages are turned off, since one fault would back 2 MB at once.
  */
 void mem_init(void)
 {
     /* allocate the storage we will use to model the available VM */
-    if ((mem_start_brk = (char *)malloc(MAX_HEAP)) == NULL) {
-	fprintf(stderr, "mem_init_vm: malloc error\n");
+    if (mem_init_anon(mem_maxheap) < 0) {
+	fprintf(stderr, "mem_init_vm: mmap error\n");
 	exit(1);
     }
+#ifdef MADV_NOHUGEPAGE
+    madvise(mem_start_brk, mem_maxheap, MADV_NOHUGEPAGE);
+#endif
+}
+
+/*
+ * mem_init_anon - reserve reserve bytes of anonymous memory for the
+ *     heap. Pages are only backed by RAM once the heap grows into them
+ *     and they are touched, so the reservation can be far larger than
+ *     the heap ever gets. Returns 0, or -1 on error.
+ */
+int mem_init_anon(size_t reserve)
+{
+    char *map;
+
+    map = mmap(NULL, reserve, PROT_READ | PROT_WRITE,
+	       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (map == MAP_FAILED)
+	return -1;
+    mem_anonlen = reserve;
+    mem_start_brk = map;
+    mem_max_addr = map + reserve;
+    mem_brk = mem_start_brk;
+    return 0;
+}
+
+/*
+ * mem_set_maxheap - set the heap size used by the next mem_init
+ *     (MAX_HEAP by default), e.g. to fit several copies of a trace.
+ */
+void mem_set_maxheap(size_t bytes)
+{
+    mem_maxheap = bytes;
+}
+
+/*
+ * mem_set_mapsize - set the heap size used by the next mem_init_file.
+ *     An existing file that is larger than this keeps its size.
+ */
+void mem_set_mapsize(size_t bytes)
+{
+    mem_mapsize = bytes;
+}
+
+/*
+ * mem_map_fd - map the heap from the already opened file fd (helper
+ *     for mem_init_file and mem_init_shared). Returns 1 if the file
+ *     already held a heap, 0 if a fresh heap was created, -1 on error.
+ */
+static int mem_map_fd(int fd, int create)
+{
+    int restored;
+    struct stat st;
+    size_t pagesize = mem_pagesize();
+    size_t len = pagesize + ((mem_mapsize + pagesize - 1) & ~(pagesize - 1));
+    char *map;
+
+    if (fstat(fd, &st) < 0)
+	return -1;
+    if (!create) {
+	/* Someone else creates the mapping; wait until it has a size */
+	while (st.st_size == 0) {
+	    usleep(1000);
+	    if (fstat(fd, &st) < 0)
+		return -1;
+	}
+	len = (size_t)st.st_size;
+    }
+    else if ((size_t)st.st_size > len)
+	len = (size_t)st.st_size;
+    else if ((size_t)st.st_size < len && ftruncate(fd, len) < 0) {
+	fprintf(stderr, "mem_map_fd: ftruncate: %s\n", strerror(errno));
+	return -1;
+    }
+
+    map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+	fprintf(stderr, "mem_map_fd: mmap: %s\n", strerror(errno));
+	return -1;
+    }
+
+    mem_hdr = (mem_hdr_t *)map;
+    mem_maplen = len;
+    mem_start_brk = map + pagesize;
+    mem_max_addr = map + len;
+
+    if (!create) {
+	/* The creator writes the header right after sizing the file */
+	while (mem_hdr->magic != MEM_MAGIC)
+	    usleep(1000);
+	restored = 1;
+    }
+    else {
+	restored = (mem_hdr->magic == MEM_MAGIC &&
+		    mem_hdr->brk <= (unsigned long)(len - pagesize));
+	if (!restored) {
+	    mem_hdr->brk = 0;
+	    mem_hdr->magic = MEM_MAGIC;
+	}
+	mem_hdr->mapsize = len;
+    }
+    mem_brk = mem_start_brk + mem_hdr->brk;
+    return restored;
+}
+
+/*
+ * mem_init_file - map the heap from the file at path. Returns 1 if the
+ *     file already held a heap (brk is restored), 0 if a fresh empty
+ *     heap was created, and -1 on error.
+ */
+int mem_init_file(const char *path)
+{
+    int fd, rc;
+
+    if ((fd = open(path, O_RDWR | O_CREAT, 0644)) < 0) {
+	fprintf(stderr, "mem_init_file: open %s: %s\n", path, strerror(errno));
+	return -1;
+    }
+    rc = mem_map_fd(fd, 1);
+    close(fd); /* the mapping keeps the file alive */
+    return rc;
+}
+
+/*
+ * mem_init_shared - map the heap from the POSIX shared memory object
+ *     name, creating it if it does not exist yet. Several processes
+ *     may map the same object; the brk lives in the shared header.
+ *     Returns 0 if this process created the heap, 1 if it attached
+ *     to an existing one, and -1 on error.
+ */
+int mem_init_shared(const char *name)
+{
+    int fd, rc, create = 1;
+
+    if ((fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600)) < 0) {
+	create = 0;
+	if (errno != EEXIST || (fd = shm_open(name, O_RDWR, 0600)) < 0) {
+	    fprintf(stderr, "mem_init_shared: shm_open %s: %s\n",
+		    name, strerror(errno));
+	    return -1;
+	}
+    }
+    rc = mem_map_fd(fd, create);
+    close(fd);
+    return rc;
+}
 
-    mem_max_addr = mem_start_brk + MAX_HEAP;  /* max legal heap address */
-    mem_brk = mem_start_brk;                  /* heap is empty initially */
+/*
+ * mem_hdr_spare - the unused rest of a mapped heap's header page, which
+ *     every process mapping the heap sees, outside the heap itself (for
+ *     the allocator's process-shared lock). Its size goes in *len.
+ *     Returns NULL if the heap is not mapped from a file or object.
+ */
+void *mem_hdr_spare(size_t *len)
+{
+    if (mem_hdr == NULL)
+	return NULL;
+    *len = mem_pagesize() - MEM_HDR_USED;
+    return (char *)mem_hdr + MEM_HDR_USED;
 }
 
 /* 
- * mem_deinit - free the storage used by the memory system model
+ * mem_deinit - free the storage used by the memory system model.
+ *     A mapped heap is flushed back to its file and unmapped.
  */
 void mem_deinit(void)
 {
-    free(mem_start_brk);
+    if (mem_hdr != NULL) {
+	msync(mem_hdr, mem_maplen, MS_SYNC);
+	munmap(mem_hdr, mem_maplen);
+	mem_hdr = NULL;
+	mem_maplen = 0;
+    }
+    else if (mem_anonlen != 0) {
+	munmap(mem_start_brk, mem_anonlen);
+	mem_anonlen = 0;
+    }
+    else
+	free(mem_start_brk);
+    mem_start_brk = mem_brk = mem_max_addr = NULL;
 }
 
 /*
@@ -48,6 +249,8 @@ void mem_deinit(void)
 void mem_reset_brk()
 {
     mem_brk = mem_start_brk;
+    if (mem_hdr != NULL)
+	mem_hdr->brk = 0;
 }
 
 /* 
@@ -57,7 +260,11 @@ void mem_reset_brk()
  */
 void *mem_sbrk(int incr) 
 {
-    char *old_brk = mem_brk;
+    char *old_brk;
+
+    if (mem_hdr != NULL) /* another process may have moved a shared brk */
+	mem_brk = mem_start_brk + mem_hdr->brk;
+    old_brk = mem_brk;
 
     if ( (incr < 0) || ((mem_brk + incr) > mem_max_addr)) {
 	errno = ENOMEM;
@@ -65,9 +272,90 @@ void *mem_sbrk(int incr)
 	return (void *)-1;
     }
     mem_brk += incr;
+    if (mem_hdr != NULL)
+	mem_hdr->brk = (unsigned long)(mem_brk - mem_start_brk);
+    mem_nsbrk++;
     return (void *)old_brk;
 }
 
+/*
+ * mem_sbrk_calls - number of successful mem_sbrk calls so far
+ */
+size_t mem_sbrk_calls(void)
+{
+    return mem_nsbrk;
+}
+
+/*
+ * mem_discard_pages - give the pages of the whole heap area back to the
+ *     OS, so that the next run starts on fresh, untouched pages (as a new
+ *     process would). Only meaningful on an empty heap.
+ */
+void mem_discard_pages(void)
+{
+    size_t pagesize = mem_pagesize();
+    char *lo = (char *)(((unsigned long)mem_start_brk + pagesize - 1) & ~(pagesize - 1));
+    char *hi = (char *)((unsigned long)mem_max_addr & ~(pagesize - 1));
+
+    if (mem_hdr == NULL && lo < hi)
+	madvise(lo, hi - lo, MADV_DONTNEED);
+}
+
+/*
+ * mem_resident_pages - number of pages of the heap, up to the brk, that
+ *     are backed by RAM (touched since the last mem_discard_pages)
+ */
+size_t mem_resident_pages(void)
+{
+    size_t pagesize = mem_pagesize();
+    char *lo = (char *)((unsigned long)mem_start_brk & ~(pagesize - 1));
+    size_t n, i, pages = 0;
+    unsigned char *vec;
+
+    if (mem_heapsize() == 0)
+	return 0;
+    n = (mem_brk - lo + pagesize - 1) / pagesize;
+    if ((vec = malloc(n)) == NULL || mincore(lo, n * pagesize, vec) < 0) {
+	free(vec);
+	return 0;
+    }
+    for (i = 0; i < n; i++)
+	pages += vec[i] & 1;
+    free(vec);
+    return pages;
+}
+
+/*
+ * mem_checkpoint - save a copy of the heap, up to the brk, that
+ *     mem_rollback can restore any number of times. mm.c keeps all of
+ *     its state in the heap, so this saves the allocator as well.
+ *     Returns 0, or -1 if there is no memory for the copy.
+ */
+int mem_checkpoint(void)
+{
+    size_t len = mem_heapsize();
+    char *copy;
+
+    if ((copy = realloc(mem_ckpt, len ? len : 1)) == NULL)
+	return -1;
+    mem_ckpt = copy;
+    mem_ckpt_len = len;
+    memcpy(mem_ckpt, mem_start_brk, len);
+    return 0;
+}
+
+/*
+ * mem_rollback - return the heap (its bytes and the brk) to the state
+ *     saved by the last mem_checkpoint
+ */
+void mem_rollback(void)
+{
+    memcpy(mem_start_brk, mem_ckpt, mem_ckpt_len);
+    mem_brk = mem_start_brk + mem_ckpt_len;
+    if (mem_hdr != NULL)
+	mem_hdr->brk = mem_ckpt_len;
+}
+
 /*
  * mem_heap_lo - return address of the first heap byte
  */
@@ -81,6 +369,8 @@ void *mem_heap_lo()
  */
 void *mem_heap_hi()
 {
+    if (mem_hdr != NULL)
+	mem_brk = mem_start_brk + mem_hdr->brk;
     return (void *)(mem_brk - 1);
 }
 
@@ -89,6 +379,8 @@ void *mem_heap_hi()
  */
 size_t mem_heapsize() 
 {
+    if (mem_hdr != NULL)
+	mem_brk = mem_start_brk + mem_hdr->brk;
     return (size_t)(mem_brk - mem_start_brk);
 }
 
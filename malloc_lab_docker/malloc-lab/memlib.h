@@ -1,6 +1,7 @@
 #include <unistd.h>
 
 void mem_init(void);               
+void mem_set_maxheap(size_t bytes);
 void mem_deinit(void);
 void *mem_sbrk(int incr);
 void mem_reset_brk(void); 
@@ -8,4 +9,21 @@ void *mem_heap_lo(void);
 void *mem_heap_hi(void);
 size_t mem_heapsize(void);
 size_t mem_pagesize(void);
+size_t mem_sbrk_calls(void);
+void mem_discard_pages(void);
+size_t mem_resident_pages(void);
 
+/* Saving and restoring the heap (mdriver --steady) */
+int mem_checkpoint(void);
+void mem_rollback(void);
+
+/* File-backed heap (persists across processes) */
+void mem_set_mapsize(size_t bytes);
+int mem_init_file(const char *path);
+
+/* Heap in a POSIX shared memory object (shared by several processes) */
+int mem_init_shared(const char *name);
+void *mem_hdr_spare(size_t *len);
+
+/* Lazily backed anonymous memory (for running real programs on mm.c) */
+int mem_init_anon(size_t reserve);
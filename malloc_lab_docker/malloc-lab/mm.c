@@ -4,6 +4,7 @@
 #include <unistd.h>
 #include <string.h>
 #include <stdbool.h>
+#include <pthread.h>
 
 
 #include "mm.h"
@@ -20,10 +21,10 @@
 #define PACK(size, alloc) ((size) | (alloc))
 
 // 메모리 p가 가리키는 위치에서 8바이트 읽기
-#define GET(p) (*(unsigned long *)(p))  
+#define GET(p) (*(unsigned long *)MM_REF((p), sizeof(unsigned long), 0))
 
 // 메모리 p가 가리키는 위치에 8바이트 값 쓰기
-#define PUT(p, val) (*(unsigned long *)(p) = (val))
+#define PUT(p, val) (*(unsigned long *)MM_REF((p), sizeof(unsigned long), 1) = (val))
 
 // 포인터 p로부터 size(상위 비트들) 추출 (하위 4비트는 무시)
 #define GET_SIZE(p) (GET(p) & ~(size_t)0xF) 
@@ -43,11 +44,18 @@
 // 블록 포인터 bp로부터 이전 블록의 포인터 계산
 #define PREV_BLKP(bp) ((char *)(bp) - GET_SIZE(((char *)(bp) - DSIZE)))
 
+// 힙 안에 저장되는 포인터는 heap base 기준 offset으로 변환 (0 = NULL)
+// 파일/공유 메모리에 매핑된 힙이 다른 주소에 붙어도 그대로 유효하다
+#define TO_OFF(p) ((p) ? (unsigned long)((char *)(p) - heap_base) : 0UL)
+#define TO_PTR(off) ((off) ? (void *)(heap_base + (off)) : NULL)
+
 // 가용 리스트(free list)에서 현재 블록 bp의 이전 블록 포인터 접근
-#define PRED(bp) (*(void **)(bp)) 
+#define PRED(bp) TO_PTR(GET(bp))
+#define SET_PRED(bp, p) PUT((bp), TO_OFF(p))
 
 // 가용 리스트(free list)에서 현재 블록 bp의 다음 블록 포인터 접근
-#define SUCC(bp) (*(void **)((char *)(bp) + WSIZE))
+#define SUCC(bp) TO_PTR(GET((char *)(bp) + WSIZE))
+#define SET_SUCC(bp, p) PUT((char *)(bp) + WSIZE, TO_OFF(p))
 
 // 메모리 정렬 관련 상수 및 매크로
 #define ALIGNMENT 16 // 16바이트 단위로 정렬 (x86-64 규약 때문)
@@ -82,9 +90,40 @@ static void place(void *bp, size_t asize);
 static void *coalesce(void *bp);
 static void insert_node(void *bp);
 static void remove_node(void *bp);
+static int find_size_class(size_t size);
+
+#define MM_MAGIC 0x6d6d5f7374617432UL // "mm_stat2": 힙 맨 앞의 상태가 유효한지 표시
+
+// allocator 상태는 프로세스 전역 변수가 아니라 힙 맨 앞(offset 0)에 저장한다.
+// 그래서 힙을 파일에서 다시 매핑하기만 하면 allocator 전체가 복원된다.
+typedef struct {
+    unsigned long magic;                   // MM_MAGIC이면 초기화된 힙
+    unsigned long heap_listp;              // prologue payload의 offset
+    unsigned long free_lists[NUM_CLASSES]; // size class별 첫 free 블록의 offset (0 = 빈 리스트)
+} mm_state_t;
+
+// 상태 영역 크기 (뒤따르는 블록들의 16바이트 정렬 유지)
+// 힙 크기에 포함되므로 utilization이 그만큼 낮아진다: 96바이트로, 힙이 작은
+// coalescing-bal(trace 4)에서 99% -> 98%. 힙을 다시 매핑만 해서 복원하려면 감수해야 하는 비용
+#define STATE_SIZE ALIGN(sizeof(mm_state_t))
 
-void *heap_listp;   // 항상 heap의 첫 payload를 가리키는 포인터 (heap base)
-static void *segregated_free_lists[NUM_CLASSES];
+void *heap_listp;   // 항상 heap의 첫 payload를 가리키는 포인터 (mm_state->heap_listp에서 계산)
+static char *heap_base;       // 현재 프로세스에서 힙이 매핑된 시작 주소
+static mm_state_t *mm_state;  // 힙 안의 allocator 상태 (== heap_base)
+static int mm_locking;        // 1이면 malloc/free/realloc 전체를 *mm_lock으로 보호
+
+// lock은 힙 밖에 둔다. 공유하지 않는 힙(mdriver가 채점하는 힙 포함)은 프로세스 안의 lock을 쓰고,
+// 공유 힙만 memlib 헤더 페이지의 남는 공간에 둔 process-shared lock을 쓴다 (mm_open_shared)
+static pthread_mutex_t mm_private_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t *mm_lock = &mm_private_lock;
+
+// 공유 모드나 mm_set_threadsafe(1)일 때만 lock을 잡는다 (기본 모드는 분기 하나만 추가됨)
+#define MM_LOCK() do { if (mm_locking) pthread_mutex_lock(mm_lock); } while (0)
+#define MM_UNLOCK() do { if (mm_locking) pthread_mutex_unlock(mm_lock); } while (0)
+
+// size class의 free list 첫 블록 읽기/쓰기
+#define LIST_HEAD(i) TO_PTR(mm_state->free_lists[i])
+#define SET_LIST_HEAD(i, p) (mm_state->free_lists[i] = TO_OFF(p))
 
 // 주어진 크기에 맞는 size class를 반환하는 함수
 static int find_size_class(size_t size) {
@@ -129,12 +168,13 @@ static int find_size_class(size_t size) {
 // segregated free list에 새 free 블록을 삽입하는 함수 (정렬 X 버전)
 static void insert_node(void *bp) {
     int class_idx = find_size_class(GET_SIZE(HDRP(bp)));
+    void *head = LIST_HEAD(class_idx);
     
-    SUCC(bp) = segregated_free_lists[class_idx]; // 현재 리스트의 첫 번째 노드를 successor로 설정
-    PRED(bp) = NULL; // predecessor는 NULL
-    if (segregated_free_lists[class_idx] != NULL)
-        PRED(segregated_free_lists[class_idx]) = bp; // 기존 첫 번째 노드가 있으면 그 노드의 predecessor를 bp로 설정
-    segregated_free_lists[class_idx] = bp; // 리스트의 첫 번째에 bp를 삽입
+    SET_SUCC(bp, head); // 현재 리스트의 첫 번째 노드를 successor로 설정
+    SET_PRED(bp, NULL); // predecessor는 NULL
+    if (head != NULL)
+        SET_PRED(head, bp); // 기존 첫 번째 노드가 있으면 그 노드의 predecessor를 bp로 설정
+    SET_LIST_HEAD(class_idx, bp); // 리스트의 첫 번째에 bp를 삽입
 }
 
 // segregated free list에서 free 블록을 제거하는 함수
@@ -144,12 +184,12 @@ static void remove_node(void *bp) {
     void *succ = SUCC(bp);
 
     if (prev)
-        SUCC(prev) = succ; // 이전 노드가 있으면, 이전 노드의 successor를 갱신
+        SET_SUCC(prev, succ); // 이전 노드가 있으면, 이전 노드의 successor를 갱신
     else
-        segregated_free_lists[class_idx] = succ; // 없으면 리스트의 시작 노드를 successor로 변경
+        SET_LIST_HEAD(class_idx, succ); // 없으면 리스트의 시작 노드를 successor로 변경
 
     if (succ)
-        PRED(succ) = prev; // 다음 노드가 있으면, 다음 노드의 predecessor를 갱신
+        SET_PRED(succ, prev); // 다음 노드가 있으면, 다음 노드의 predecessor를 갱신
 }
 
 // 인접한 free 블록들과 병합(coalescing)하는 함수
@@ -207,24 +247,36 @@ static void *extend_heap(size_t words)
     return coalesce(bp);
 }
 
-// allocator 초기화 함수
-int mm_init(void)
+// allocator 상태와 prologue/epilogue만 있는 빈 힙을 만드는 함수
+static int create_heap(void)
 {
-    // 1. 힙 생성 (초기 padding + prologue header/footer + epilogue header)
-    heap_listp = mem_sbrk(4 * WSIZE);
-    if (heap_listp == (void *)-1) {
+    // 힙 생성 (allocator 상태 + 초기 padding + prologue header/footer + epilogue header)
+    heap_base = mem_sbrk(STATE_SIZE + 4 * WSIZE);
+    if (heap_base == (void *)-1) {
         return -1;
     }
+    mm_state = (mm_state_t *)heap_base;
+    mm_state->magic = 0; // 초기화가 끝나기 전에는 유효하지 않은 힙
 
+    heap_listp = heap_base + STATE_SIZE;
     PUT(heap_listp, 0);                                 // 패딩
     PUT(heap_listp + (1 * WSIZE), PACK(DSIZE, 1));       // prologue header
     PUT(heap_listp + (2 * WSIZE), PACK(DSIZE, 1));       // prologue footer
     PUT(heap_listp + (3 * WSIZE), PACK(0, 1));           // epilogue header
 
     heap_listp += (2 * WSIZE); // payload 영역으로 이동
+    mm_state->heap_listp = TO_OFF(heap_listp);
 
     for (int i = 0; i < NUM_CLASSES; i++)
-        segregated_free_lists[i] = NULL; // segregated list 초기화
+        mm_state->free_lists[i] = 0; // segregated list 초기화
+    return 0;
+}
+
+// allocator 초기화 함수
+int mm_init(void)
+{
+    if (create_heap() < 0)
+        return -1;
 
     void *bp = extend_heap(CHUNKSIZE/WSIZE); // 초기 힙 확장
     if (bp == NULL)
@@ -232,6 +284,159 @@ int mm_init(void)
     if (extend_heap(4) == NULL) // 추가로 작은 블록 확보
         return -1;
 
+    mm_state->magic = MM_MAGIC;
+    return 0;
+}
+
+// 최대 사용량(expected_peak)을 미리 알 때 쓰는 초기화 함수.
+// 첫 free 블록을 expected_peak 크기로 한 번에 잡고 그 페이지들을 미리 건드려서(pre-fault)
+// 실행 초반의 extend_heap(mem_sbrk) 호출과 page fault를 초기화 시점으로 옮긴다
+int mm_init_hint(size_t expected_peak)
+{
+    if (expected_peak <= CHUNKSIZE)
+        return mm_init();
+    if (create_heap() < 0)
+        return -1;
+
+    size_t size = ALIGN(expected_peak + DSIZE); // header/footer 포함
+    char *bp = extend_heap(size/WSIZE);
+    if (bp == NULL && (bp = extend_heap(CHUNKSIZE/WSIZE)) == NULL) // 힌트가 너무 크면 기본 크기로
+        return -1;
+
+    // free 블록의 링크(PRED/SUCC)와 footer 사이의 페이지마다 한 번씩 써서 미리 fault
+    size_t pagesize = mem_pagesize();
+    char *lo = bp + DSIZE;
+    char *hi = FTRP(bp);
+    char *page = (char *)(((unsigned long)lo + pagesize - 1) & ~(pagesize - 1));
+    if (lo < hi)
+        *(volatile char *)lo = 0;
+    for (; page < hi; page += pagesize)
+        *(volatile char *)page = 0;
+
+    mm_state->magic = MM_MAGIC;
+    return 0;
+}
+
+// 파일에 매핑된 힙을 연다. 이전 프로세스가 남긴 힙이 있으면 그대로 복원하고,
+// 없으면 새 힙을 만든다. 성공하면 0, 실패하면 -1
+int mm_open(const char *path)
+{
+    int restored = mem_init_file(path);
+    if (restored < 0)
+        return -1;
+
+    mm_state = (mm_state_t *)mem_heap_lo();
+    if (restored && mem_heapsize() >= STATE_SIZE + 4 * WSIZE && mm_state->magic == MM_MAGIC) {
+        // 상태가 힙 안에 있으므로 base 주소만 다시 계산하면 된다
+        heap_base = mem_heap_lo();
+        heap_listp = TO_PTR(mm_state->heap_listp);
+        return 0;
+    }
+
+    mem_reset_brk(); // 유효한 힙이 아니면 처음부터 다시 만든다
+    if (mm_init() < 0) {
+        mem_deinit();
+        return -1;
+    }
+    return 0;
+}
+
+// 여러 프로세스가 공유하는 POSIX shared memory 힙을 연다.
+// 처음 여는 프로세스가 힙을 초기화하고, 나머지는 초기화가 끝날 때까지 기다렸다가 붙는다.
+// 이후 malloc/free/realloc은 process-shared lock으로 보호된다. 성공하면 0, 실패하면 -1
+int mm_open_shared(const char *name)
+{
+    int attached = mem_init_shared(name);
+    if (attached < 0)
+        return -1;
+
+    size_t len;
+    pthread_mutex_t *lock = mem_hdr_spare(&len);
+    if (lock == NULL || len < sizeof(*lock)) {
+        mem_deinit();
+        return -1;
+    }
+
+    if (!attached) {
+        // 힙을 매핑한 모든 프로세스가 같은 lock을 쓸 수 있도록 process-shared로 초기화.
+        // 붙는 쪽은 magic이 설정될 때까지 기다리므로 mm_init 전에 해 둔다
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+        pthread_mutex_init(lock, &attr);
+        pthread_mutexattr_destroy(&attr);
+
+        mem_reset_brk();
+        if (mm_init() < 0) {
+            mem_deinit();
+            return -1;
+        }
+    }
+    else {
+        mm_state = (mm_state_t *)mem_heap_lo();
+        while (mm_state->magic != MM_MAGIC) // 생성한 프로세스의 mm_init이 끝날 때까지 대기
+            usleep(1000);
+        heap_base = mem_heap_lo();
+        heap_listp = TO_PTR(mm_state->heap_listp);
+    }
+    mm_lock = lock;
+    mm_locking = 1;
+    return 0;
+}
+
+// 블록 포인터 <-> heap offset 변환. 프로세스마다 힙이 다른 주소에 매핑되므로
+// 다른 프로세스에 블록을 넘길 때는 offset을 보낸다
+size_t mm_ptr_to_offset(void *ptr)
+{
+    return TO_OFF(ptr);
+}
+
+void *mm_offset_to_ptr(size_t offset)
+{
+    return TO_PTR(offset);
+}
+
+// 여러 스레드가 같은 힙을 쓸 때 malloc/free/realloc을 lock으로 보호할지 정한다.
+// lock은 힙 밖에 있으므로 mm_init 전후 어느 쪽에서 켜도 된다
+void mm_set_threadsafe(int on)
+{
+    mm_locking = on;
+}
+
+// 모든 free list를 훑어 가용 블록 수, 총 크기, 가장 큰 블록 크기를 구한다 (mdriver -U).
+// 가용 블록 수에 비례하는 시간이 걸리므로 측정 구간 밖에서만 부른다
+int mm_heapstats(mm_heapstats_t *hs)
+{
+    if (mm_state == NULL)
+        return -1;
+    MM_LOCK();
+    hs->free_blocks = 0;
+    hs->free_bytes = 0;
+    hs->largest_free = 0;
+    for (int i = 0; i < NUM_CLASSES; i++) {
+        for (void *bp = LIST_HEAD(i); bp != NULL; bp = SUCC(bp)) {
+            size_t size = GET_SIZE(HDRP(bp));
+            hs->free_blocks++;
+            hs->free_bytes += size;
+            if (size > hs->largest_free)
+                hs->largest_free = size;
+        }
+    }
+    MM_UNLOCK();
+    return 0;
+}
+
+// mm_open/mm_open_shared로 연 힙을 파일에 기록하고 매핑을 해제한다
+int mm_close(void)
+{
+    if (mm_state == NULL)
+        return -1;
+    mem_deinit();
+    mm_locking = 0;
+    mm_lock = &mm_private_lock;
+    heap_base = NULL;
+    heap_listp = NULL;
+    mm_state = NULL;
     return 0;
 }
 
@@ -251,7 +456,7 @@ int mm_init(void)
 // segregated free list에서 크기에 맞는 블록을 찾는 함수 (best-fit 방식)
 static void *find_fit(size_t asize) {
     for (int i = find_size_class(asize); i < NUM_CLASSES; i++) {
-        void *bp = segregated_free_lists[i];
+        void *bp = LIST_HEAD(i);
         void *best_bp = NULL;
         size_t best_size = (size_t)-1;
 
@@ -294,8 +499,8 @@ static void place(void *bp, size_t asize) {
     }
 }
 
-// 메모리 블록을 할당하는 함수
-void *mm_malloc(size_t size)
+// 메모리 블록을 할당하는 함수 (lock은 호출하는 쪽에서 잡는다)
+static void *malloc_block(size_t size)
 {
     size_t asize;
     size_t extendsize;
@@ -326,8 +531,8 @@ void *mm_malloc(size_t size)
     return bp;
 }
 
-// 메모리 블록을 해제하는 함수
-void mm_free(void *ptr)
+// 메모리 블록을 해제하는 함수 (lock은 호출하는 쪽에서 잡는다)
+static void free_block(void *ptr)
 {
     if (ptr == NULL)
         return;
@@ -339,13 +544,13 @@ void mm_free(void *ptr)
 }
 
 
-// 메모리 블록을 재할당하는 함수 (in-place 최적화)
-void *mm_realloc(void *ptr, size_t size)
+// 메모리 블록을 재할당하는 함수 (in-place 최적화, lock은 호출하는 쪽에서 잡는다)
+static void *realloc_block(void *ptr, size_t size)
 {
     if (ptr == NULL)
-        return mm_malloc(size);
+        return malloc_block(size);
     if (size == 0) {
-        mm_free(ptr);
+        free_block(ptr);
         return NULL;
     }
 
@@ -365,7 +570,7 @@ void *mm_realloc(void *ptr, size_t size)
     }
 
     // 새 블록 할당 후 데이터 복사
-    void *newptr = mm_malloc(size);
+    void *newptr = malloc_block(size);
     if (newptr == NULL)
         return NULL;
 
@@ -373,6 +578,104 @@ void *mm_realloc(void *ptr, size_t size)
     if (size < copySize)
         copySize = size;
     memcpy(newptr, ptr, copySize); // 데이터 복사
-    mm_free(ptr); // 기존 블록 해제
+    free_block(ptr); // 기존 블록 해제
+    return newptr;
+}
+
+void *mm_malloc(size_t size)
+{
+    MM_LOCK();
+    void *bp = malloc_block(size);
+    MM_UNLOCK();
+    return bp;
+}
+
+void mm_free(void *ptr)
+{
+    MM_LOCK();
+    free_block(ptr);
+    MM_UNLOCK();
+}
+
+void *mm_realloc(void *ptr, size_t size)
+{
+    MM_LOCK();
+    void *newptr = realloc_block(ptr, size);
+    MM_UNLOCK();
     return newptr;
-}
\ No newline at end of file
+}
+
+// alignment(2의 거듭제곱) 경계에 맞춘 블록을 할당한다. alignment만큼 여유를 두고
+// 할당한 뒤, 정렬된 위치 앞부분과 남는 뒷부분을 free 블록으로 떼어 돌려준다
+void *mm_memalign(size_t alignment, size_t size)
+{
+    if (alignment <= ALIGNMENT)
+        return mm_malloc(size);
+    if (size == 0)
+        return NULL;
+
+    MM_LOCK();
+    // 앞부분이 최소 블록(2*DSIZE) 이상이 되도록 여유를 둔다
+    char *bp = malloc_block(size + alignment + 2 * DSIZE);
+    if (bp == NULL) {
+        MM_UNLOCK();
+        return NULL;
+    }
+    char *abp = (char *)(((unsigned long)bp + alignment - 1) & ~(alignment - 1));
+    if (abp != bp) {
+        while (abp - bp < 2 * DSIZE)
+            abp += alignment;
+        size_t total = GET_SIZE(HDRP(bp));
+        size_t lead = abp - bp;
+        PUT(HDRP(abp), PACK(total - lead, 1));
+        PUT(FTRP(abp), PACK(total - lead, 1));
+        PUT(HDRP(bp), PACK(lead, 0));
+        PUT(FTRP(bp), PACK(lead, 0));
+        coalesce(bp);
+    }
+
+    // 뒷부분이 최소 블록 이상 남으면 분할해서 free로 돌려준다
+    size_t asize = (size <= DSIZE) ? (2 * DSIZE) : DSIZE * ((size + (DSIZE) + (DSIZE-1)) / DSIZE);
+    size_t csize = GET_SIZE(HDRP(abp));
+    if (csize - asize >= 2 * DSIZE) {
+        PUT(HDRP(abp), PACK(asize, 1));
+        PUT(FTRP(abp), PACK(asize, 1));
+        char *rest = NEXT_BLKP(abp);
+        PUT(HDRP(rest), PACK(csize - asize, 0));
+        PUT(FTRP(rest), PACK(csize - asize, 0));
+        coalesce(rest);
+    }
+    MM_UNLOCK();
+    return abp;
+}
+
+// 블록에 실제로 쓸 수 있는 바이트 수 (header/footer를 뺀 크기)
+size_t mm_usable_size(void *ptr)
+{
+    if (ptr == NULL)
+        return 0;
+    return GET_SIZE(HDRP(ptr)) - DSIZE;
+}
+
+// fork 중에 다른 스레드가 lock을 잡은 채로 자식에게 힙이 복사되지 않도록
+// fork 직전에 lock을 잡고, 부모와 자식 양쪽에서 놓는다 (mmshim.c의 pthread_atfork)
+void mm_fork_prepare(void)
+{
+    MM_LOCK();
+}
+
+void mm_fork_parent(void)
+{
+    MM_UNLOCK();
+}
+
+void mm_fork_child(void)
+{
+    MM_UNLOCK();
+}
+
+// mdriver -A가 고를 수 있도록 mm.c를 등록 (힙 밖에 상태가 없으므로 INHEAP)
+const mm_ops_t mm_ops = {
+    "mm", mm_init, mm_malloc, mm_free, mm_realloc,
+    mm_init_hint, mm_heapstats, mm_set_threadsafe,
+    MM_OPS_MEMLIB | MM_OPS_INHEAP};
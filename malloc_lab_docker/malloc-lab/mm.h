@@ -3,16 +3,87 @@
 
 
 extern int mm_init (void);
+extern int mm_init_hint(size_t expected_peak);
 extern void *mm_malloc (size_t size);
 extern void mm_free (void *ptr);
 extern void *mm_realloc(void *ptr, size_t size);
-static void *extend_heap(size_t words);
-static void *coalesce(void *bp);          /* 인접 가용 블록 병합 */
-static void *find_fit(size_t asize);      /* 가용 블록 탐색 */
-static void place(void *bp, size_t asize);
-static void remove_node(void *bp);
-static void insert_node(void *bp);
-static int find_size_class(size_t size);
+extern void mm_set_threadsafe(int on);
+extern void *mm_memalign(size_t alignment, size_t size);
+extern size_t mm_usable_size(void *ptr);
+extern void mm_fork_prepare(void);
+extern void mm_fork_parent(void);
+extern void mm_fork_child(void);
+extern int mm_open(const char *path);
+extern int mm_close(void);
+extern int mm_open_shared(const char *name);
+extern size_t mm_ptr_to_offset(void *ptr);
+extern void *mm_offset_to_ptr(size_t offset);
+
+/* Every metadata load and store of the allocators' GET/PUT macros goes
+   through MM_REF(p, size, store). In the cache simulation build
+   (-DMM_CACHESIM, make mdriver-cachesim) that reports the access to
+   cachesim.c; otherwise it is just p. */
+#ifdef MM_CACHESIM
+#include "cachesim.h"
+#define MM_REF(p, size, store) cs_ref((void *)(p), (size), (store))
+#else
+#define MM_REF(p, size, store) ((void *)(p))
+#endif
+
+/* Free-block statistics for mdriver -U. Declared weak so that an mm.c
+   without it still links; the driver checks for NULL before calling. */
+typedef struct {
+    size_t free_blocks;  /* blocks on the free lists */
+    size_t free_bytes;   /* their total size, headers included */
+    size_t largest_free; /* size of the largest one */
+} mm_heapstats_t;
+extern int mm_heapstats(mm_heapstats_t *hs) __attribute__((weak));
+
+/* An allocator as mdriver -A sees it. Each implementation registers one
+   table (mm.c: mm_ops, mm_seg.c: seg_ops, sdfs.c: sdfs_ops); entries an
+   implementation lacks are NULL. */
+#define MM_OPS_MEMLIB 1 /* allocates from the memlib heap */
+#define MM_OPS_INHEAP 2 /* keeps all of its state in that heap */
+typedef struct {
+    const char *name;
+    int (*init)(void);
+    void *(*malloc)(size_t size);
+    void (*free)(void *ptr);
+    void *(*realloc)(void *ptr, size_t size);
+    int (*init_hint)(size_t expected_peak);   /* optional */
+    int (*heapstats)(mm_heapstats_t *hs);     /* optional */
+    void (*set_threadsafe)(int on);          /* optional */
+    int flags;                               /* MM_OPS_* */
+} mm_ops_t;
+extern const mm_ops_t mm_ops;
+extern const mm_ops_t seg_ops;
+extern const mm_ops_t sdfs_ops;
+
+/* The other implementations' functions, called directly by mdriver's
+   per-backend replay loops */
+extern int seg_init(void);
+extern void *seg_malloc(size_t size);
+extern void seg_free(void *ptr);
+extern void *seg_realloc(void *ptr, size_t size);
+extern int sdfs_init(void);
+extern void *sdfs_malloc(size_t size);
+extern void sdfs_free(void *ptr);
+extern void *sdfs_realloc(void *ptr, size_t size);
+
+/* Arena (region) allocation on top of mm_malloc, see mm_arena.c */
+typedef struct mm_arena mm_arena_t;
+extern mm_arena_t *mm_arena_create(void);
+extern void *mm_arena_alloc(mm_arena_t *a, size_t size);
+extern void mm_arena_reset(mm_arena_t *a);
+extern void mm_arena_destroy(mm_arena_t *a);
+
+/* Fixed-size object pools on top of mm_malloc, see mm_pool.c */
+typedef struct mm_pool mm_pool_t;
+extern mm_pool_t *mm_pool_create(size_t obj_size, size_t align);
+extern void *mm_pool_alloc(mm_pool_t *p);
+extern void mm_pool_free(mm_pool_t *p, void *obj);
+extern size_t mm_pool_trim(mm_pool_t *p);
+extern void mm_pool_destroy(mm_pool_t *p);
 /* 
  * Students work in teams of one or two.  Teams enter their team name, 
  * personal names and login IDs in a struct of this
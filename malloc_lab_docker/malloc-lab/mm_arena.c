@@ -0,0 +1,130 @@
+/*
+ * mm_arena.c - 요청 단위(request-scoped) 할당을 위한 arena(region) allocator
+ *
+ * mm_malloc으로 받은 큰 chunk 안에서 포인터만 밀어 올리며(bump pointer) 할당하고,
+ * 개별 해제 없이 mm_arena_reset/mm_arena_destroy로 chunk 단위로 한꺼번에 돌려준다.
+ * 객체마다 mm_free(+coalesce)를 부르는 대신 chunk 개수만큼만 mm_free를 부른다.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mm.h"
+
+#define ARENA_ALIGN 16           // arena 할당 정렬 단위 (mm_malloc과 동일)
+#define ARENA_CHUNK (1 << 14)    // 기본 chunk 크기: 16KB
+
+#define ARENA_ROUND(size) (((size) + (ARENA_ALIGN-1)) & ~(size_t)(ARENA_ALIGN-1))
+
+// chunk 맨 앞의 header. 뒤따르는 데이터 영역이 16바이트 정렬되도록 크기를 맞춘다
+typedef struct arena_chunk {
+    struct arena_chunk *next; // arena의 다음 chunk
+    size_t size;              // header를 제외한 데이터 영역 크기
+} arena_chunk_t;
+
+#define CHUNK_HDR ARENA_ROUND(sizeof(arena_chunk_t))
+#define CHUNK_DATA(c) ((char *)(c) + CHUNK_HDR)
+
+struct mm_arena {
+    arena_chunk_t *chunks; // 할당받은 chunk 리스트 (가장 최근 것이 맨 앞)
+    char *cur;             // 현재 chunk에서 다음 할당 위치
+    char *end;             // 현재 chunk 데이터 영역의 끝
+};
+
+// 데이터 영역이 size 바이트인 chunk를 mm_malloc으로 받아 리스트에 연결하는 함수
+static arena_chunk_t *new_chunk(mm_arena_t *a, size_t size, int make_current)
+{
+    arena_chunk_t *c = mm_malloc(CHUNK_HDR + size);
+    if (c == NULL)
+        return NULL;
+    c->size = size;
+
+    if (make_current) { // 새 bump 대상이면 맨 앞에
+        c->next = a->chunks;
+        a->chunks = c;
+        a->cur = CHUNK_DATA(c);
+        a->end = a->cur + size;
+    }
+    else if (a->chunks != NULL) { // 큰 객체 전용 chunk는 현재 chunk 뒤에 끼워서 bump 위치를 유지
+        c->next = a->chunks->next;
+        a->chunks->next = c;
+    }
+    else { // 아직 bump 대상 chunk가 없으면 리스트에만 연결
+        c->next = NULL;
+        a->chunks = c;
+    }
+    return c;
+}
+
+// 빈 arena를 만든다. chunk는 첫 할당 때 받는다
+mm_arena_t *mm_arena_create(void)
+{
+    mm_arena_t *a = mm_malloc(sizeof(mm_arena_t));
+    if (a == NULL)
+        return NULL;
+    a->chunks = NULL;
+    a->cur = a->end = NULL;
+    return a;
+}
+
+// arena에서 size 바이트를 할당한다. 대부분 포인터 비교와 덧셈 한 번으로 끝난다
+void *mm_arena_alloc(mm_arena_t *a, size_t size)
+{
+    size_t asize = ARENA_ROUND(size ? size : 1);
+    char *p = a->cur;
+
+    if (asize <= (size_t)(a->end - p)) { // fast path: 현재 chunk에 자리가 있음
+        a->cur = p + asize;
+        return p;
+    }
+
+    // chunk 크기의 1/4보다 큰 객체는 전용 chunk를 받아 현재 chunk의 남은 공간을 버리지 않는다
+    if (asize > ARENA_CHUNK / 4) {
+        arena_chunk_t *c = new_chunk(a, asize, 0);
+        return c ? CHUNK_DATA(c) : NULL;
+    }
+
+    if (new_chunk(a, ARENA_CHUNK, 1) == NULL)
+        return NULL;
+    p = a->cur;
+    a->cur = p + asize;
+    return p;
+}
+
+// arena에서 할당한 모든 객체를 한꺼번에 해제한다 (chunk 개수에 비례).
+// 다음 요청에서 바로 쓸 수 있도록 기본 크기 chunk 하나는 남겨 둔다
+void mm_arena_reset(mm_arena_t *a)
+{
+    arena_chunk_t *c = a->chunks, *next, *keep = NULL;
+
+    for (; c != NULL; c = next) {
+        next = c->next;
+        if (keep == NULL && c->size == ARENA_CHUNK)
+            keep = c;
+        else
+            mm_free(c);
+    }
+
+    a->chunks = keep;
+    if (keep != NULL) {
+        keep->next = NULL;
+        a->cur = CHUNK_DATA(keep);
+        a->end = a->cur + keep->size;
+    }
+    else
+        a->cur = a->end = NULL;
+}
+
+// arena의 모든 chunk와 arena 자체를 해제한다
+void mm_arena_destroy(mm_arena_t *a)
+{
+    arena_chunk_t *c, *next;
+
+    if (a == NULL)
+        return;
+    for (c = a->chunks; c != NULL; c = next) {
+        next = c->next;
+        mm_free(c);
+    }
+    mm_free(a);
+}
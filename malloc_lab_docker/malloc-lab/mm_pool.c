@@ -0,0 +1,204 @@
+/*
+ * mm_pool.c - 크기가 같은 객체를 위한 pool allocator
+ *
+ * mm_malloc으로 큰 chunk를 받아 같은 크기의 slot으로 잘라 쓰고, 해제된 slot은
+ * 객체 자리에 다음 포인터를 저장하는 LIFO free list(intrusive)로 관리한다.
+ * 그래서 할당/해제는 포인터 pop/push 한 번이고 find_size_class, find_fit, place를 거치지 않는다.
+ * free slot이 많이 쌓이면 mm_pool_trim이 완전히 빈 chunk를 찾아 mm_free로 메인 힙에 돌려준다.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mm.h"
+
+#define POOL_CHUNK (1 << 14)   // chunk 하나의 목표 크기: 16KB
+#define POOL_MIN_OBJS 32       // chunk 하나에 들어가는 최소 객체 수
+#define POOL_MIN_ALIGN 16      // mm_malloc이 보장하는 정렬
+
+#define ROUND_UP(x, a) (((x) + ((a)-1)) & ~(size_t)((a)-1))
+
+typedef struct {
+    void *base;  // mm_malloc이 돌려준 주소 (mm_free할 때 사용)
+    char *start; // 정렬된 첫 slot 주소
+} pool_chunk_t;
+
+struct mm_pool {
+    void *free_list;       // 해제된 slot의 LIFO 리스트 (slot 첫 word가 다음 포인터)
+    char *bump;            // 가장 최근 chunk에서 아직 한 번도 나가지 않은 slot 시작
+    char *bump_end;        // 그 chunk의 끝
+    size_t stride;         // slot 크기 (객체 크기를 정렬 단위로 올림)
+    size_t align;          // slot 정렬
+    size_t objs_per_chunk; // chunk 하나의 slot 개수
+    size_t nfree;          // free_list 길이
+    size_t trim_at;        // nfree가 이 값을 넘으면 mm_pool_trim 실행
+    pool_chunk_t *chunks;  // chunk 배열 (start 주소 오름차순)
+    size_t nchunks;
+    size_t cap;            // chunks 배열 용량
+};
+
+// obj_size 바이트 객체를 align 단위로 정렬해서 주는 pool을 만든다 (align은 2의 거듭제곱)
+mm_pool_t *mm_pool_create(size_t obj_size, size_t align)
+{
+    mm_pool_t *p;
+
+    if (align < sizeof(void *))
+        align = sizeof(void *);
+    if ((align & (align - 1)) != 0)
+        return NULL;
+
+    if ((p = mm_malloc(sizeof(mm_pool_t))) == NULL)
+        return NULL;
+    memset(p, 0, sizeof(mm_pool_t));
+    p->align = align;
+    p->stride = ROUND_UP(obj_size < sizeof(void *) ? sizeof(void *) : obj_size, align);
+    p->objs_per_chunk = POOL_CHUNK / p->stride;
+    if (p->objs_per_chunk < POOL_MIN_OBJS)
+        p->objs_per_chunk = POOL_MIN_OBJS;
+    p->trim_at = 2 * p->objs_per_chunk;
+    return p;
+}
+
+// 주소 obj가 들어 있는 chunk의 index를 이진 탐색으로 찾는 함수
+static size_t find_chunk(mm_pool_t *p, char *obj)
+{
+    size_t lo = 0, hi = p->nchunks;
+
+    while (hi - lo > 1) { // chunks[lo].start <= obj < chunks[hi].start 유지
+        size_t mid = (lo + hi) / 2;
+        if (p->chunks[mid].start <= obj)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// 새 chunk를 받아 주소 순서를 유지하며 chunks 배열에 넣고 bump 영역으로 삼는 함수
+static int add_chunk(mm_pool_t *p)
+{
+    size_t bytes = p->objs_per_chunk * p->stride;
+    size_t extra = p->align > POOL_MIN_ALIGN ? p->align - POOL_MIN_ALIGN : 0;
+    char *base, *start;
+    size_t i;
+
+    if (p->nchunks == p->cap) {
+        size_t cap = p->cap ? 2 * p->cap : 16;
+        pool_chunk_t *chunks = mm_realloc(p->chunks, cap * sizeof(pool_chunk_t));
+        if (chunks == NULL)
+            return -1;
+        p->chunks = chunks;
+        p->cap = cap;
+    }
+    if ((base = mm_malloc(bytes + extra)) == NULL)
+        return -1;
+    start = (char *)ROUND_UP((unsigned long)base, p->align);
+
+    // chunk는 대부분 주소가 증가하는 순서로 오므로 뒤에서부터 자리를 찾는다
+    for (i = p->nchunks; i > 0 && p->chunks[i - 1].start > start; i--)
+        p->chunks[i] = p->chunks[i - 1];
+    p->chunks[i].base = base;
+    p->chunks[i].start = start;
+    p->nchunks++;
+
+    p->bump = start;
+    p->bump_end = start + bytes;
+    return 0;
+}
+
+// 객체 하나를 할당한다: free list pop, 없으면 최근 chunk에서 다음 slot
+void *mm_pool_alloc(mm_pool_t *p)
+{
+    void *obj = p->free_list;
+
+    if (obj != NULL) { // fast path: LIFO pop
+        p->free_list = *(void **)obj;
+        p->nfree--;
+        return obj;
+    }
+    if (p->bump == p->bump_end && add_chunk(p) < 0)
+        return NULL;
+    obj = p->bump;
+    p->bump += p->stride;
+    return obj;
+}
+
+// 객체를 pool에 돌려준다: free list push. free slot이 많이 쌓이면 빈 chunk를 반납
+void mm_pool_free(mm_pool_t *p, void *obj)
+{
+    if (obj == NULL)
+        return;
+    *(void **)obj = p->free_list;
+    p->free_list = obj;
+    if (++p->nfree > p->trim_at)
+        mm_pool_trim(p);
+}
+
+// 모든 slot이 free인 chunk를 메인 힙에 돌려주고, 돌려준 chunk 수를 반환한다.
+// free list 길이 F, chunk 수 C에 대해 O(F log C). 자동 실행 기준(trim_at)을 두 배씩 늘려
+// 반납할 것이 없을 때 반복 호출되는 비용을 상쇄한다
+size_t mm_pool_trim(mm_pool_t *p)
+{
+    size_t *nfree_in, i, j, released = 0;
+    size_t cur = p->nchunks; // bump 영역이 있는 chunk의 index (없으면 nchunks)
+    void *obj, *next, **tail;
+
+    if (p->nchunks == 0)
+        return 0;
+    if ((nfree_in = mm_malloc(p->nchunks * sizeof(size_t))) == NULL)
+        return 0;
+    memset(nfree_in, 0, p->nchunks * sizeof(size_t));
+
+    // 1. chunk마다 free slot 수 세기 (아직 나가지 않은 bump 영역도 free로 센다)
+    for (obj = p->free_list; obj != NULL; obj = *(void **)obj)
+        nfree_in[find_chunk(p, obj)]++;
+    if (p->bump != NULL) {
+        cur = find_chunk(p, p->bump_end - p->stride);
+        nfree_in[cur] += (p->bump_end - p->bump) / p->stride;
+    }
+
+    // 2. 완전히 빈 chunk의 slot을 free list에서 빼기 (순서는 유지)
+    tail = &p->free_list;
+    for (obj = p->free_list; obj != NULL; obj = next) {
+        next = *(void **)obj;
+        if (nfree_in[find_chunk(p, obj)] == p->objs_per_chunk)
+            p->nfree--;
+        else {
+            *tail = obj;
+            tail = (void **)obj;
+        }
+    }
+    *tail = NULL;
+
+    // 3. 빈 chunk를 mm_free하고 배열을 앞으로 당기기
+    for (i = j = 0; i < p->nchunks; i++) {
+        if (nfree_in[i] == p->objs_per_chunk) {
+            mm_free(p->chunks[i].base);
+            if (i == cur)
+                p->bump = p->bump_end = NULL;
+            released++;
+        }
+        else
+            p->chunks[j++] = p->chunks[i];
+    }
+    p->nchunks = j;
+    mm_free(nfree_in);
+
+    p->trim_at = 2 * p->nfree;
+    if (p->trim_at < 2 * p->objs_per_chunk)
+        p->trim_at = 2 * p->objs_per_chunk;
+    return released;
+}
+
+// pool의 모든 chunk와 pool 자체를 해제한다
+void mm_pool_destroy(mm_pool_t *p)
+{
+    size_t i;
+
+    if (p == NULL)
+        return;
+    for (i = 0; i < p->nchunks; i++)
+        mm_free(p->chunks[i].base);
+    mm_free(p->chunks);
+    mm_free(p);
+}
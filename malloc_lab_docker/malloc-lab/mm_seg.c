@@ -19,8 +19,9 @@
 #define PACK(size, alloc) ((size) | (alloc))
 
 // Read and write a word at address p
-#define GET(p) (*(unsigned long *)(p))  
-#define PUT(p, val) (*(unsigned long *)(p) = (val))
+// MM_REF: mdriver-cachesim에서 메타데이터 접근을 캐시 시뮬레이터로 보냄 (mm.h)
+#define GET(p) (*(unsigned long *)MM_REF((p), sizeof(unsigned long), 0))
+#define PUT(p, val) (*(unsigned long *)MM_REF((p), sizeof(unsigned long), 1) = (val))
 
 // Read the size and allocated fields from address p
 #define GET_SIZE(p) (GET(p) & ~(size_t)0xF) // 0xF로 하자 (하위 4비트 사용)
@@ -34,23 +35,13 @@
 #define NEXT_BLKP(bp) ((char *)(bp) + GET_SIZE(((char *)(bp) - WSIZE)))
 #define PREV_BLKP(bp) ((char *)(bp) - GET_SIZE(((char *)(bp) - DSIZE)))
 
-#define PRED(bp) (*(void **)(bp))                        // 이전 free block 포인터
-#define SUCC(bp) (*(void **)((char *)(bp) + WSIZE))       // 다음 free block 포인터
-/*********************************************************
- * NOTE TO STUDENTS: Before you do anything else, please
- * provide your team information in the following struct.
- ********************************************************/
-team_t team = {
-    /* Team name */
-    "puddingjelly",
-    /* First member's full name */
-    "sweetpotatooo",
-    /* First member's email address */
-    "sehyun5004@naver.com",
-    /* Second member's full name (leave blank if none) */
-    "minmoooya",
-    /* Second member's email address (leave blank if none) */
-    "minhyay01@gmail.com"};
+// 가용 리스트에서 bp의 이전/다음 free block 포인터 (읽기)
+#define PRED(bp) (*(void **)MM_REF((bp), sizeof(void *), 0))
+#define SUCC(bp) (*(void **)MM_REF((char *)(bp) + WSIZE, sizeof(void *), 0))
+
+// 쓰기는 따로 두어 캐시 시뮬레이터에 store로 기록되게 함
+#define SET_PRED(bp, p) (*(void **)MM_REF((bp), sizeof(void *), 1) = (p))
+#define SET_SUCC(bp, p) (*(void **)MM_REF((char *)(bp) + WSIZE, sizeof(void *), 1) = (p))
 
     #define ALIGNMENT 16
     #define NUM_CLASSES 10
@@ -65,7 +56,7 @@ team_t team = {
     static void insert_node(void *bp);
     static void remove_node(void *bp);
     
-    void *heap_listp;   // 항상 heap의 첫 payload를 가리키는 포인터 (heap base)
+    static void *heap_listp;   // 항상 heap의 첫 payload를 가리키는 포인터 (heap base)
     static void *segregated_free_lists[NUM_CLASSES];
     
     // find size class
@@ -85,10 +76,10 @@ team_t team = {
     static void insert_node(void *bp) {
         int class_idx = find_size_class(GET_SIZE(HDRP(bp)));
         
-        SUCC(bp) = segregated_free_lists[class_idx];
-        PRED(bp) = NULL;
+        SET_SUCC(bp, segregated_free_lists[class_idx]);
+        SET_PRED(bp, NULL);
         if (segregated_free_lists[class_idx] != NULL)
-            PRED(segregated_free_lists[class_idx]) = bp;
+            SET_PRED(segregated_free_lists[class_idx], bp);
         segregated_free_lists[class_idx] = bp;
     }
     
@@ -97,18 +88,18 @@ team_t team = {
         int class_idx = find_size_class(GET_SIZE(HDRP(bp)));
     
         if (PRED(bp))
-            SUCC(PRED(bp)) = SUCC(bp);
+            SET_SUCC(PRED(bp), SUCC(bp));
         else
             segregated_free_lists[class_idx] = SUCC(bp);
     
         if (SUCC(bp))
-            PRED(SUCC(bp)) = PRED(bp);
+            SET_PRED(SUCC(bp), PRED(bp));
     }
     
     // coalesce
     static void *coalesce(void *bp) {
-        bool prev_alloc = (PREV_BLKP(bp) < (void *)mem_heap_lo()) || GET_ALLOC(HDRP(PREV_BLKP(bp)));
-        bool next_alloc = (NEXT_BLKP(bp) > (void *)mem_heap_hi()) || GET_ALLOC(HDRP(NEXT_BLKP(bp)));
+        bool prev_alloc = ((char *)PREV_BLKP(bp) < (char *)mem_heap_lo()) || GET_ALLOC(HDRP(PREV_BLKP(bp)));
+        bool next_alloc = ((char *)NEXT_BLKP(bp) > (char *)mem_heap_hi()) || GET_ALLOC(HDRP(NEXT_BLKP(bp)));
         size_t size = GET_SIZE(HDRP(bp));
     
         if (prev_alloc && next_alloc) {
@@ -155,7 +146,7 @@ team_t team = {
         return coalesce(bp);
     }
     
-    int mm_init(void)
+    int seg_init(void)
     {
         //  1. 힙을 위한 최소 공간 16바이트 확보 (padding + prologue header/footer + epilogue header)
         heap_listp = mem_sbrk(4 * WSIZE);
@@ -228,7 +219,7 @@ team_t team = {
         }
     }
     
-    void *mm_malloc(size_t size)
+    void *seg_malloc(size_t size)
     {
         size_t asize;
         size_t extendsize;
@@ -260,9 +251,9 @@ team_t team = {
     }
     
     /*
-     * mm_free - Freeing a block does nothing.
+     * seg_free - Freeing a block does nothing.
      */
-    void mm_free(void *ptr)
+    void seg_free(void *ptr)
     {
         if (ptr == NULL)
             return;
@@ -273,13 +264,13 @@ team_t team = {
         coalesce(ptr);
     }
     
-    /* mm_realloc - in-place 최적화 */
-    void *mm_realloc(void *ptr, size_t size)
+    /* seg_realloc - in-place 최적화 */
+    void *seg_realloc(void *ptr, size_t size)
     {
         if (ptr == NULL)
-            return mm_malloc(size);
+            return seg_malloc(size);
         if (size == 0) {
-            mm_free(ptr);
+            seg_free(ptr);
             return NULL;
         }
     
@@ -298,7 +289,7 @@ team_t team = {
             return ptr;
         }
     
-        void *newptr = mm_malloc(size);
+        void *newptr = seg_malloc(size);
         if (newptr == NULL)
             return NULL;
     
@@ -306,6 +297,12 @@ team_t team = {
         if (size < copySize)
             copySize = size;
         memcpy(newptr, ptr, copySize);
-        mm_free(ptr);
+        seg_free(ptr);
         return newptr;
-    }
\ No newline at end of file
+    }
+
+    // mdriver -A seg로 고를 수 있도록 등록 (free list 배열이 힙 밖에 있으므로 INHEAP 아님)
+    const mm_ops_t seg_ops = {
+        "seg", seg_init, seg_malloc, seg_free, seg_realloc,
+        NULL, NULL, NULL,
+        MM_OPS_MEMLIB};
@@ -0,0 +1,559 @@
+/*
+ * mmbench.c - Micro-benchmarks for the extra interfaces in mm.c that
+ *     the trace-driven mdriver cannot exercise.
+ *
+ *     mmbench shm [-n <msgs>] [-s <bytes>]
+ *         Passes messages from a producer process to a consumer process,
+ *         once by copying them through a pipe and once by allocating
+ *         them in a shared mm heap and sending only the heap offset.
+ *
+ *     mmbench arena [-n <requests>] [-k <objs>] [-s <bytes>]
+ *         Models request-scoped lifetimes: every request allocates objs
+ *         objects of 16..bytes bytes and drops them all at its end, once
+ *         with one mm_free per object and once with mm_arena_reset.
+ *
+ *     mmbench pool [-n <objs>] [-k <rounds>]
+ *         Allocates and frees (in shuffled order) objs objects of each
+ *         size from 16 to 256 bytes, with mm_malloc/mm_free and with a
+ *         fixed-size mm_pool.
+ */
+#define _GNU_SOURCE /* F_GETPIPE_SZ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "mm.h"
+#include "memlib.h"
+
+#define SHM_NAME "/mmbench-shm"
+
+/* Benchmark parameters (set from the command line) */
+static long nmsgs = -1;       /* number of messages/requests */
+static size_t msgsize = 0;    /* payload bytes per message / max object size */
+static long nobjs = -1;       /* objects per request (arena) / rounds (pool) */
+
+static void usage(void);
+static void unix_error(char *msg);
+
+/*
+ * now - current time in seconds from a monotonic clock
+ */
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+/*
+ * read_full/write_full - pipe I/O that retries short transfers
+ */
+static int read_full(int fd, void *buf, size_t n)
+{
+    char *p = buf;
+    ssize_t r;
+
+    while (n > 0) {
+	if ((r = read(fd, p, n)) <= 0) {
+	    if (r < 0 && errno == EINTR)
+		continue;
+	    return -1;
+	}
+	p += r;
+	n -= r;
+    }
+    return 0;
+}
+
+static void write_full(int fd, const void *buf, size_t n)
+{
+    const char *p = buf;
+    ssize_t r;
+
+    while (n > 0) {
+	if ((r = write(fd, p, n)) < 0) {
+	    if (errno == EINTR)
+		continue;
+	    unix_error("write failed in mmbench");
+	}
+	p += r;
+	n -= r;
+    }
+}
+
+/*
+ * checksum - touch every byte of a received message, as a real consumer would
+ */
+static unsigned long checksum(const unsigned char *p, size_t n)
+{
+    unsigned long sum = 0;
+    size_t i;
+
+    for (i = 0; i < n; i++)
+	sum += p[i];
+    return sum;
+}
+
+/*
+ * msg_sum - the checksum message i must have; the producer fills it
+ *     with (i & 0xFF) | 1
+ */
+static unsigned long msg_sum(long i)
+{
+    return msgsize * (unsigned long)((i & 0xFF) | 1);
+}
+
+/*
+ * wait_consumer - reap the consumer, and fail the benchmark if it saw a
+ *     bad or missing message
+ */
+static void wait_consumer(pid_t pid, const char *bench)
+{
+    int status;
+
+    if (waitpid(pid, &status, 0) < 0)
+	unix_error("waitpid failed in mmbench");
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+	printf("%s: the consumer got a corrupt or missing message\n", bench);
+	exit(1);
+    }
+}
+
+/*
+ * report - print one result line and return messages per second
+ */
+static double report(const char *name, double secs)
+{
+    double rate = nmsgs / secs;
+
+    printf("%-12s%10ld%10zu%10.3f%12.0f%10.1f\n", name, nmsgs, msgsize,
+	   secs, rate, rate * msgsize / (1 << 20));
+    return rate;
+}
+
+/*
+ * bench_pipe - the consumer reads every message body from a pipe
+ */
+static double bench_pipe(void)
+{
+    int fds[2];
+    long i;
+    pid_t pid;
+    char *buf;
+    double start, secs;
+
+    if (pipe(fds) < 0)
+	unix_error("pipe failed in bench_pipe");
+    if ((buf = malloc(msgsize)) == NULL)
+	unix_error("malloc failed in bench_pipe");
+
+    start = now();
+    if ((pid = fork()) == 0) {
+	long bad = 0;
+
+	close(fds[1]);
+	for (i = 0; i < nmsgs; i++) {
+	    if (read_full(fds[0], buf, msgsize) < 0)
+		_exit(1);
+	    bad += checksum((unsigned char *)buf, msgsize) != msg_sum(i);
+	}
+	_exit(bad != 0);
+    }
+    close(fds[0]);
+    for (i = 0; i < nmsgs; i++) {
+	memset(buf, (int)(i & 0xFF) | 1, msgsize);
+	write_full(fds[1], buf, msgsize);
+    }
+    close(fds[1]);
+    wait_consumer(pid, "bench_pipe");
+    secs = now() - start;
+
+    free(buf);
+    return secs;
+}
+
+/*
+ * bench_shm - the producer mm_mallocs each message in the shared heap and
+ *     sends its offset; the consumer maps the heap on its own, reads the
+ *     message in place and mm_frees it.
+ */
+static double bench_shm(void)
+{
+    int fds[2];
+    long i;
+    pid_t pid;
+    size_t off;
+    char *p;
+    long inflight;
+    int status;
+    double start, secs;
+
+    if (pipe(fds) < 0)
+	unix_error("pipe failed in bench_shm");
+
+    /*
+     * The producer can run ahead of the consumer by as many offsets as
+     * the pipe buffers, so size the heap to hold that many messages.
+     */
+    if ((inflight = fcntl(fds[1], F_GETPIPE_SZ)) < 0)
+	inflight = 1 << 16;
+    inflight = inflight / sizeof(size_t) + 1;
+    mem_set_mapsize(2 * inflight * (msgsize + 64) + (1 << 20));
+
+    shm_unlink(SHM_NAME); /* drop a segment left by an earlier crash */
+    if (mm_open_shared(SHM_NAME) < 0)
+	unix_error("mm_open_shared failed in bench_shm");
+
+    start = now();
+    if ((pid = fork()) == 0) {
+	long bad = 0;
+
+	/* Attach like an unrelated process would, at a new address */
+	mm_close();
+	if (mm_open_shared(SHM_NAME) < 0)
+	    _exit(1);
+	close(fds[1]);
+	for (i = 0; i < nmsgs; i++) {
+	    if (read_full(fds[0], &off, sizeof(off)) < 0)
+		_exit(1);
+	    p = mm_offset_to_ptr(off);
+	    bad += checksum((unsigned char *)p, msgsize) != msg_sum(i);
+	    mm_free(p);
+	}
+	mm_close();
+	_exit(bad != 0);
+    }
+    close(fds[0]);
+    for (i = 0; i < nmsgs; i++) {
+	/* The consumer frees concurrently; wait for room if the heap is full */
+	while ((p = mm_malloc(msgsize)) == NULL) {
+	    if (waitpid(pid, &status, WNOHANG) != 0) {
+		printf("bench_shm: the consumer exited with the heap full\n");
+		mm_close();
+		shm_unlink(SHM_NAME);
+		exit(1);
+	    }
+	    usleep(100);
+	}
+	memset(p, (int)(i & 0xFF) | 1, msgsize);
+	off = mm_ptr_to_offset(p);
+	write_full(fds[1], &off, sizeof(off));
+    }
+    close(fds[1]);
+    wait_consumer(pid, "bench_shm");
+    secs = now() - start;
+
+    mm_close();
+    shm_unlink(SHM_NAME);
+    return secs;
+}
+
+static void run_shm(void)
+{
+    double pipe_rate, shm_rate;
+
+    if (nmsgs < 0)
+	nmsgs = 200000;
+    if (msgsize == 0)
+	msgsize = 4096;
+
+    printf("%-12s%10s%10s%10s%12s%10s\n",
+	   "mode", "msgs", "bytes", "secs", "msgs/sec", "MB/sec");
+    pipe_rate = report("pipe copy", bench_pipe());
+    shm_rate = report("shm offset", bench_shm());
+    printf("shm offset passing is %.2fx pipe copying\n", shm_rate / pipe_rate);
+}
+
+/*
+ * gen_sizes - n deterministic pseudo-random sizes in [16, max]
+ */
+static size_t *gen_sizes(long n, size_t max)
+{
+    size_t *sizes;
+    unsigned long x = 12345;
+    long i;
+
+    if ((sizes = malloc(n * sizeof(size_t))) == NULL)
+	unix_error("malloc failed in gen_sizes");
+    for (i = 0; i < n; i++) {
+	x = x * 6364136223846793005UL + 1442695040888963407UL;
+	sizes[i] = 16 + (x >> 33) % (max - 15);
+    }
+    return sizes;
+}
+
+/*
+ * bench_request_free - every request frees its objects one by one
+ */
+static double bench_request_free(size_t *sizes)
+{
+    long r, i;
+    char **objs;
+    double start;
+
+    if ((objs = malloc(nobjs * sizeof(char *))) == NULL)
+	unix_error("malloc failed in bench_request_free");
+    mem_reset_brk();
+    if (mm_init() < 0)
+	unix_error("mm_init failed in bench_request_free");
+
+    start = now();
+    for (r = 0; r < nmsgs; r++) {
+	for (i = 0; i < nobjs; i++) {
+	    if ((objs[i] = mm_malloc(sizes[r * nobjs + i])) == NULL)
+		unix_error("mm_malloc failed in bench_request_free");
+	    objs[i][0] = (char)i;
+	}
+	for (i = 0; i < nobjs; i++)
+	    mm_free(objs[i]);
+    }
+    start = now() - start;
+
+    free(objs);
+    return start;
+}
+
+/*
+ * bench_request_arena - every request resets its arena at the end
+ */
+static double bench_request_arena(size_t *sizes)
+{
+    long r, i;
+    char *p;
+    mm_arena_t *a;
+    double start;
+
+    mem_reset_brk();
+    if (mm_init() < 0 || (a = mm_arena_create()) == NULL)
+	unix_error("mm_init failed in bench_request_arena");
+
+    start = now();
+    for (r = 0; r < nmsgs; r++) {
+	for (i = 0; i < nobjs; i++) {
+	    if ((p = mm_arena_alloc(a, sizes[r * nobjs + i])) == NULL)
+		unix_error("mm_arena_alloc failed in bench_request_arena");
+	    p[0] = (char)i;
+	}
+	mm_arena_reset(a);
+    }
+    start = now() - start;
+
+    mm_arena_destroy(a);
+    return start;
+}
+
+static void run_arena(void)
+{
+    size_t *sizes;
+    double free_secs, arena_secs;
+
+    if (nmsgs < 0)
+	nmsgs = 20000;
+    if (msgsize == 0)
+	msgsize = 512;
+    if (nobjs < 0)
+	nobjs = 200;
+    sizes = gen_sizes(nmsgs * nobjs, msgsize);
+    mem_init();
+
+    printf("%-12s%10s%10s%10s%10s%12s\n",
+	   "mode", "requests", "objs/req", "maxbytes", "secs", "Mobjs/sec");
+    free_secs = bench_request_free(sizes);
+    printf("%-12s%10ld%10ld%10zu%10.3f%12.2f\n", "mm_free", nmsgs, nobjs,
+	   msgsize, free_secs, nmsgs * nobjs / free_secs / 1e6);
+    arena_secs = bench_request_arena(sizes);
+    printf("%-12s%10ld%10ld%10zu%10.3f%12.2f\n", "arena reset", nmsgs, nobjs,
+	   msgsize, arena_secs, nmsgs * nobjs / arena_secs / 1e6);
+    printf("arena reset is %.2fx per-object mm_free\n", free_secs / arena_secs);
+
+    mem_deinit();
+    free(sizes);
+}
+
+/*
+ * gen_order - a deterministic random permutation of 0..n-1
+ */
+static long *gen_order(long n)
+{
+    long *order, i, j, t;
+    unsigned long x = 54321;
+
+    if ((order = malloc(n * sizeof(long))) == NULL)
+	unix_error("malloc failed in gen_order");
+    for (i = 0; i < n; i++)
+	order[i] = i;
+    for (i = n - 1; i > 0; i--) {
+	x = x * 6364136223846793005UL + 1442695040888963407UL;
+	j = (x >> 33) % (i + 1);
+	t = order[i];
+	order[i] = order[j];
+	order[j] = t;
+    }
+    return order;
+}
+
+/*
+ * bench_pool_malloc - objs objects of size bytes from mm_malloc/mm_free
+ */
+static double bench_pool_malloc(size_t size, long *order, char **objs)
+{
+    long r, i;
+    double start;
+
+    mem_reset_brk();
+    if (mm_init() < 0)
+	unix_error("mm_init failed in bench_pool_malloc");
+
+    start = now();
+    for (r = 0; r < nobjs; r++) {
+	for (i = 0; i < nmsgs; i++) {
+	    if ((objs[i] = mm_malloc(size)) == NULL)
+		unix_error("mm_malloc failed in bench_pool_malloc");
+	    objs[i][0] = (char)i;
+	}
+	for (i = 0; i < nmsgs; i++)
+	    mm_free(objs[order[i]]);
+    }
+    return now() - start;
+}
+
+/*
+ * bench_pool - the same workload on a fixed-size pool. *heap is set to
+ *     the heap size the pool needed, and *released to the number of
+ *     empty chunks a final mm_pool_trim handed back to the heap.
+ */
+static double bench_pool(size_t size, long *order, char **objs,
+			 size_t *heap, size_t *released)
+{
+    long r, i;
+    double start;
+    mm_pool_t *pool;
+
+    mem_reset_brk();
+    if (mm_init() < 0 || (pool = mm_pool_create(size, 16)) == NULL)
+	unix_error("mm_pool_create failed in bench_pool");
+
+    start = now();
+    for (r = 0; r < nobjs; r++) {
+	for (i = 0; i < nmsgs; i++) {
+	    if ((objs[i] = mm_pool_alloc(pool)) == NULL)
+		unix_error("mm_pool_alloc failed in bench_pool");
+	    objs[i][0] = (char)i;
+	}
+	for (i = 0; i < nmsgs; i++)
+	    mm_pool_free(pool, objs[order[i]]);
+    }
+    start = now() - start;
+
+    *released = mm_pool_trim(pool);
+    *heap = mem_heapsize();
+    mm_pool_destroy(pool);
+    return start;
+}
+
+static void run_pool(void)
+{
+    size_t size, mheap, pheap, released;
+    long *order;
+    char **objs;
+    double msecs, psecs, mops;
+
+    if (nmsgs < 0)
+	nmsgs = 50000;
+    if (nobjs < 0)
+	nobjs = 10;
+    order = gen_order(nmsgs);
+    if ((objs = malloc(nmsgs * sizeof(char *))) == NULL)
+	unix_error("malloc failed in run_pool");
+    mem_init();
+
+    mops = 2.0 * nmsgs * nobjs / 1e6; /* one alloc and one free per object */
+    printf("%6s%10s%8s%13s%11s%9s%13s%11s%10s\n", "bytes", "objs", "rounds",
+	   "malloc Mops", "pool Mops", "speedup", "malloc heap", "pool heap",
+	   "released");
+    for (size = 16; size <= 256; size *= 2) {
+	msecs = bench_pool_malloc(size, order, objs);
+	mheap = mem_heapsize();
+	psecs = bench_pool(size, order, objs, &pheap, &released);
+	printf("%6zu%10ld%8ld%13.2f%11.2f%8.2fx%13zu%11zu%10zu\n", size, nmsgs,
+	       nobjs, mops / msecs, mops / psecs, msecs / psecs, mheap, pheap,
+	       released);
+    }
+
+    mem_deinit();
+    free(objs);
+    free(order);
+}
+
+int main(int argc, char **argv)
+{
+    int c;
+
+    if (argc < 2) {
+	usage();
+	exit(1);
+    }
+    optind = 2;
+    while ((c = getopt(argc, argv, "n:s:k:h")) != EOF) {
+	switch (c) {
+	case 'n':
+	    nmsgs = atol(optarg);
+	    break;
+	case 's':
+	    msgsize = (size_t)atol(optarg);
+	    break;
+	case 'k':
+	    nobjs = atol(optarg);
+	    break;
+	case 'h':
+	    usage();
+	    exit(0);
+	default:
+	    usage();
+	    exit(1);
+	}
+    }
+
+    if (!strcmp(argv[1], "shm"))
+	run_shm();
+    else if (!strcmp(argv[1], "arena"))
+	run_arena();
+    else if (!strcmp(argv[1], "pool"))
+	run_pool();
+    else {
+	usage();
+	exit(1);
+    }
+    exit(0);
+}
+
+/*
+ * unix_error - Report a Unix-style error
+ */
+static void unix_error(char *msg)
+{
+    printf("%s: %s\n", msg, strerror(errno));
+    exit(1);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: mmbench <benchmark> [options]\n");
+    fprintf(stderr, "Benchmarks\n");
+    fprintf(stderr, "\tshm [-n <msgs>] [-s <bytes>]\n");
+    fprintf(stderr, "\t           Pass messages between processes: pipe copy vs shared mm heap.\n");
+    fprintf(stderr, "\tarena [-n <requests>] [-k <objs>] [-s <bytes>]\n");
+    fprintf(stderr, "\t           Request-scoped lifetimes: per-object mm_free vs mm_arena_reset.\n");
+    fprintf(stderr, "\tpool [-n <objs>] [-k <rounds>]\n");
+    fprintf(stderr, "\t           16-256 byte objects: mm_malloc/mm_free vs mm_pool_alloc/mm_pool_free.\n");
+}
@@ -0,0 +1,119 @@
+/*
+ * mmdl.c - Loads allocator shared objects for mdriver --ab.
+ *
+ * A library is opened with RTLD_LOCAL, so its mm_* and mem_* symbols
+ * stay out of the global namespace and a second library with the same
+ * symbols loads next to it. The same file cannot be loaded twice this
+ * way (dlopen hands back the first copy, heap and all); to compare a
+ * library with itself, compare it with a copy under another name.
+ *
+ * The allocator functions come from the library's mm_ops_t table if it
+ * registers one (mm_seg.c and sdfs.c export no mm_* functions), and
+ * from its mm_* symbols otherwise.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <dlfcn.h>
+
+#include "mm.h"
+#include "mmdl.h"
+
+#define MAXLINE 1024
+#define MMDL_MAX 2 /* libraries open at once */
+
+static char errbuf[MAXLINE];
+static void *loaded[MMDL_MAX]; /* handles of the open libraries */
+
+/* Names of the mm_ops_t tables a library may register */
+static const char *ops_tables[] = {"mm_ops", "seg_ops", "sdfs_ops"};
+
+/* Look up symbol name of lib into the function pointer fp */
+#define SYM(lib, fp, name) \
+	((*(void **)&(fp) = dlsym((lib)->handle, name)) != NULL)
+
+/*
+ * mmdl_open - Load the allocator at path into *lib and set up its heap.
+ *     A path without a slash is taken relative to the current directory
+ *     rather than searched for. Returns 0, or -1 with mmdl_error set.
+ */
+int mmdl_open(mmdl_t *lib, const char *path)
+{
+	char file[MAXLINE];
+	const mm_ops_t *ops = NULL;
+	int i, k;
+
+	memset(lib, 0, sizeof(*lib));
+	lib->path = path;
+	snprintf(file, sizeof(file), "%s%s", strchr(path, '/') ? "" : "./", path);
+	if ((lib->handle = dlopen(file, RTLD_NOW | RTLD_LOCAL)) == NULL)
+	{
+		snprintf(errbuf, sizeof(errbuf), "%s", dlerror());
+		return -1;
+	}
+	for (i = 0; i < MMDL_MAX && loaded[i] != NULL && loaded[i] != lib->handle; i++)
+		;
+	if (i == MMDL_MAX || loaded[i] != NULL)
+	{
+		if (i == MMDL_MAX)
+			snprintf(errbuf, sizeof(errbuf), "%s: too many libraries", path);
+		else
+			snprintf(errbuf, sizeof(errbuf), "%s: already loaded "
+											 "(compare a copy of it instead)",
+					 path);
+		dlclose(lib->handle);
+		lib->handle = NULL;
+		return -1;
+	}
+	for (k = 0; ops == NULL && k < (int)(sizeof(ops_tables) / sizeof(char *)); k++)
+		ops = (const mm_ops_t *)dlsym(lib->handle, ops_tables[k]);
+	if (ops != NULL)
+	{
+		lib->mm_init = ops->init;
+		lib->mm_malloc = ops->malloc;
+		lib->mm_free = ops->free;
+		lib->mm_realloc = ops->realloc;
+	}
+	if ((ops == NULL &&
+		 (!SYM(lib, lib->mm_init, "mm_init") ||
+		  !SYM(lib, lib->mm_malloc, "mm_malloc") ||
+		  !SYM(lib, lib->mm_free, "mm_free") ||
+		  !SYM(lib, lib->mm_realloc, "mm_realloc"))) ||
+		!SYM(lib, lib->mem_init, "mem_init") ||
+		!SYM(lib, lib->mem_reset_brk, "mem_reset_brk") ||
+		!SYM(lib, lib->mem_heap_lo, "mem_heap_lo") ||
+		!SYM(lib, lib->mem_heap_hi, "mem_heap_hi") ||
+		!SYM(lib, lib->mem_heapsize, "mem_heapsize"))
+	{
+		snprintf(errbuf, sizeof(errbuf), "%s: %s", path, dlerror());
+		dlclose(lib->handle);
+		lib->handle = NULL;
+		return -1;
+	}
+	loaded[i] = lib->handle;
+	lib->mem_init();
+	return 0;
+}
+
+/*
+ * mmdl_close - Unload a library opened by mmdl_open
+ */
+void mmdl_close(mmdl_t *lib)
+{
+	int i;
+
+	if (lib->handle == NULL)
+		return;
+	for (i = 0; i < MMDL_MAX; i++)
+		if (loaded[i] == lib->handle)
+			loaded[i] = NULL;
+	dlclose(lib->handle);
+	lib->handle = NULL;
+}
+
+/*
+ * mmdl_error - What went wrong in the last failed mmdl_open
+ */
+const char *mmdl_error(void)
+{
+	return errbuf;
+}
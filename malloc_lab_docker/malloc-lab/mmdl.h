@@ -0,0 +1,37 @@
+/*
+ * mmdl.h - Loads an allocator built as a shared object (libmm.so,
+ *          libmm_seg.so, ...) for mdriver --ab.
+ *
+ * Each library carries its own copy of memlib.c and is linked with
+ * -Bsymbolic, so two of them loaded side by side have two separate
+ * simulated heaps, and neither touches the driver's own.
+ */
+#ifndef __MMDL_H_
+#define __MMDL_H_
+
+#include <stddef.h>
+
+typedef struct
+{
+	const char *path;
+	void *handle;
+
+	/* the mm.h interface */
+	int (*mm_init)(void);
+	void *(*mm_malloc)(size_t size);
+	void (*mm_free)(void *ptr);
+	void *(*mm_realloc)(void *ptr, size_t size);
+
+	/* the library's own memlib */
+	void (*mem_init)(void);
+	void (*mem_reset_brk)(void);
+	void *(*mem_heap_lo)(void);
+	void *(*mem_heap_hi)(void);
+	size_t (*mem_heapsize)(void);
+} mmdl_t;
+
+int mmdl_open(mmdl_t *lib, const char *path);
+void mmdl_close(mmdl_t *lib);
+const char *mmdl_error(void);
+
+#endif /* __MMDL_H_ */
@@ -0,0 +1,379 @@
+/*
+ * mmrecord.c - Allocation recorder, preloaded into a program to capture
+ *     its malloc/calloc/realloc/free/posix_memalign calls:
+ *
+ *         MMREC_FILE=app.log LD_PRELOAD=./libmmrecord.so app ...
+ *         rec2rep app.log app.rep
+ *
+ * Each thread buffers REC_BUF records in memory of its own and flushes
+ * them with a single write to the O_APPEND log, so the threads only
+ * share the sequence counter that orders the calls. The counter is read
+ * before a block is released (free) and after it is obtained (malloc),
+ * so a block freed by one thread and handed to another by malloc is
+ * always freed first in the log. realloc releases and obtains in one
+ * call, so rec2rep tolerates the rare allocation of a still-live block.
+ *
+ * The log goes to $MMREC_FILE (default mmrec.<pid>.log); a forked child
+ * records to <file>.<pid>. Calls made before the library constructor
+ * ran, and the recorder's own calls, are passed through unrecorded.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <dlfcn.h>
+#include <sys/mman.h>
+
+#include "mmrecord.h"
+
+#define REC_BUF 4096	/* records buffered per thread */
+#define BOOT_HEAP 16384 /* bytes for calloc calls made by dlsym */
+
+/* The records of one thread */
+typedef struct recbuf
+{
+	recop_t ops[REC_BUF];
+	int n;
+	uint32_t tid;
+	struct recbuf *next; /* list of all live buffers */
+} recbuf_t;
+
+/* Recorder states */
+enum
+{
+	REC_OFF,		/* constructor has not run */
+	REC_RESOLVING,	/* looking up the real functions */
+	REC_ON,			/* recording */
+	REC_DONE		/* destructor ran */
+};
+
+static void *(*real_malloc)(size_t);
+static void *(*real_calloc)(size_t, size_t);
+static void *(*real_realloc)(void *, size_t);
+static void (*real_free)(void *);
+static int (*real_posix_memalign)(void **, size_t, size_t);
+
+static int rec_state = REC_OFF;
+static int rec_fd = -1;
+static char rec_path[4096];
+static uint64_t rec_seq = 0;	/* next sequence number */
+static uint32_t rec_ntids = 0;	/* threads seen so far */
+static recbuf_t *rec_bufs = NULL;
+static pthread_mutex_t rec_lock = PTHREAD_MUTEX_INITIALIZER; /* rec_bufs, rec_fd */
+static pthread_key_t rec_key;
+
+static char boot_heap[BOOT_HEAP];
+static size_t boot_used = 0;
+
+static __thread recbuf_t *my_buf = NULL;
+static __thread int in_rec = 0; /* nonzero inside the recorder */
+
+static void rec_resolve(void);
+static void rec_open(const char *path);
+static void record(uint32_t type, uint64_t seq, void *ptr, void *oldptr,
+				   size_t size);
+static void flush(recbuf_t *b);
+static void thread_exit(void *arg);
+static void before_fork(void);
+static void after_fork_parent(void);
+static void after_fork_child(void);
+static uint64_t now_ns(void);
+
+#define RECORDING() (rec_state == REC_ON && !in_rec)
+#define NEXT_SEQ() __atomic_fetch_add(&rec_seq, 1, __ATOMIC_SEQ_CST)
+
+/*
+ * rec_init - Find the real allocator and start recording
+ */
+__attribute__((constructor)) static void rec_init(void)
+{
+	const char *path;
+	char def[64];
+
+	rec_resolve();
+	if ((path = getenv("MMREC_FILE")) == NULL)
+	{
+		snprintf(def, sizeof(def), "mmrec.%d.log", (int)getpid());
+		path = def;
+	}
+	in_rec++;
+	rec_open(path);
+	pthread_key_create(&rec_key, thread_exit);
+	pthread_atfork(before_fork, after_fork_parent, after_fork_child);
+	in_rec--;
+	if (rec_fd >= 0)
+		rec_state = REC_ON;
+}
+
+/*
+ * rec_fini - Flush what every thread still has buffered
+ */
+__attribute__((destructor)) static void rec_fini(void)
+{
+	recbuf_t *b;
+
+	if (rec_state != REC_ON)
+		return;
+	pthread_mutex_lock(&rec_lock);
+	rec_state = REC_DONE;
+	for (b = rec_bufs; b != NULL; b = b->next)
+		flush(b);
+	close(rec_fd);
+	rec_fd = -1;
+	pthread_mutex_unlock(&rec_lock);
+}
+
+void *malloc(size_t size)
+{
+	void *p;
+
+	if (real_malloc == NULL)
+		rec_resolve();
+	if (!RECORDING())
+		return real_malloc(size);
+	if ((p = real_malloc(size)) != NULL)
+		record(REC_MALLOC, NEXT_SEQ(), p, NULL, size);
+	return p;
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	void *p;
+
+	if (real_calloc == NULL)
+	{
+		/* dlsym itself calls calloc while we look up the real one */
+		if (rec_state == REC_RESOLVING)
+		{
+			size_t n = (nmemb * size + 15) & ~(size_t)15;
+
+			if (boot_used + n > BOOT_HEAP)
+				return NULL;
+			p = boot_heap + boot_used;
+			boot_used += n;
+			return p;
+		}
+		rec_resolve();
+	}
+	if (!RECORDING())
+		return real_calloc(nmemb, size);
+	if ((p = real_calloc(nmemb, size)) != NULL)
+		record(REC_MALLOC, NEXT_SEQ(), p, NULL, nmemb * size);
+	return p;
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	void *p;
+
+	if (real_realloc == NULL)
+		rec_resolve();
+	if (!RECORDING())
+		return real_realloc(ptr, size);
+	if ((p = real_realloc(ptr, size)) != NULL || size == 0)
+		record(REC_REALLOC, NEXT_SEQ(), p, ptr, size);
+	return p;
+}
+
+void free(void *ptr)
+{
+	if (ptr == NULL ||
+		((char *)ptr >= boot_heap && (char *)ptr < boot_heap + BOOT_HEAP))
+		return;
+	if (real_free == NULL)
+		rec_resolve();
+	if (RECORDING())
+		record(REC_FREE, NEXT_SEQ(), ptr, NULL, 0);
+	real_free(ptr);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+	int ret;
+
+	if (real_posix_memalign == NULL)
+		rec_resolve();
+	if (!RECORDING())
+		return real_posix_memalign(memptr, alignment, size);
+	if ((ret = real_posix_memalign(memptr, alignment, size)) == 0)
+		record(REC_MALLOC, NEXT_SEQ(), *memptr, NULL, size);
+	return ret;
+}
+
+/*
+ * rec_resolve - Look up the next definitions of the hooked functions
+ */
+static void rec_resolve(void)
+{
+	int state = rec_state;
+
+	rec_state = REC_RESOLVING;
+	real_malloc = dlsym(RTLD_NEXT, "malloc");
+	real_calloc = dlsym(RTLD_NEXT, "calloc");
+	real_realloc = dlsym(RTLD_NEXT, "realloc");
+	real_free = dlsym(RTLD_NEXT, "free");
+	real_posix_memalign = dlsym(RTLD_NEXT, "posix_memalign");
+	rec_state = state;
+	if (real_malloc == NULL || real_calloc == NULL || real_realloc == NULL ||
+		real_free == NULL || real_posix_memalign == NULL)
+	{
+		fprintf(stderr, "mmrecord: cannot find the real allocator\n");
+		_exit(1);
+	}
+}
+
+/*
+ * rec_open - Create the log file and write its header
+ */
+static void rec_open(const char *path)
+{
+	rechdr_t hdr;
+
+	snprintf(rec_path, sizeof(rec_path), "%s", path);
+	if ((rec_fd = open(rec_path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644)) < 0)
+	{
+		fprintf(stderr, "mmrecord: cannot create %s: %s\n", rec_path, strerror(errno));
+		return;
+	}
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, REC_MAGIC, sizeof(hdr.magic));
+	hdr.version = REC_VERSION;
+	hdr.recsize = sizeof(recop_t);
+	hdr.pid = getpid();
+	hdr.start_ns = now_ns();
+	if (write(rec_fd, &hdr, sizeof(hdr)) != sizeof(hdr))
+	{
+		close(rec_fd);
+		rec_fd = -1;
+	}
+}
+
+/*
+ * record - Append one call to the calling thread's buffer, creating the
+ *     buffer on the thread's first call
+ */
+static void record(uint32_t type, uint64_t seq, void *ptr, void *oldptr,
+				   size_t size)
+{
+	recbuf_t *b = my_buf;
+	recop_t *op;
+
+	in_rec++;
+	if (b == NULL)
+	{
+		b = mmap(NULL, sizeof(recbuf_t), PROT_READ | PROT_WRITE,
+				 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (b == MAP_FAILED)
+		{
+			in_rec--;
+			return;
+		}
+		b->tid = __atomic_add_fetch(&rec_ntids, 1, __ATOMIC_SEQ_CST);
+		pthread_mutex_lock(&rec_lock);
+		b->next = rec_bufs;
+		rec_bufs = b;
+		pthread_mutex_unlock(&rec_lock);
+		pthread_setspecific(rec_key, b);
+		my_buf = b;
+	}
+	op = &b->ops[b->n++];
+	op->seq = seq;
+	op->ns = now_ns();
+	op->ptr = (uint64_t)(uintptr_t)ptr;
+	op->oldptr = (uint64_t)(uintptr_t)oldptr;
+	op->size = size;
+	op->tid = b->tid;
+	op->type = type;
+	if (b->n == REC_BUF)
+		flush(b);
+	in_rec--;
+}
+
+/*
+ * flush - Write out and empty a buffer
+ */
+static void flush(recbuf_t *b)
+{
+	size_t len = b->n * sizeof(recop_t);
+
+	if (b->n > 0 && rec_fd >= 0 && write(rec_fd, b->ops, len) != (ssize_t)len)
+		fprintf(stderr, "mmrecord: short write to %s\n", rec_path);
+	b->n = 0;
+}
+
+/*
+ * thread_exit - Flush and release the buffer of an exiting thread
+ */
+static void thread_exit(void *arg)
+{
+	recbuf_t *b = (recbuf_t *)arg, **pp;
+
+	in_rec++;
+	pthread_mutex_lock(&rec_lock);
+	flush(b);
+	for (pp = &rec_bufs; *pp != NULL; pp = &(*pp)->next)
+		if (*pp == b)
+		{
+			*pp = b->next;
+			break;
+		}
+	pthread_mutex_unlock(&rec_lock);
+	my_buf = NULL;
+	munmap(b, sizeof(recbuf_t));
+	in_rec--;
+}
+
+/*
+ * Fork handling: the parent keeps its log, and the child drops the
+ * records it inherited (the parent writes them) and starts a log of its
+ * own with only the forking thread's buffer.
+ */
+static void before_fork(void)
+{
+	pthread_mutex_lock(&rec_lock);
+}
+
+static void after_fork_parent(void)
+{
+	pthread_mutex_unlock(&rec_lock);
+}
+
+static void after_fork_child(void)
+{
+	char path[sizeof(rec_path) + 32];
+
+	in_rec++;
+	rec_bufs = NULL;
+	if (my_buf != NULL)
+	{
+		my_buf->n = 0;
+		my_buf->next = NULL;
+		rec_bufs = my_buf;
+	}
+	if (rec_fd >= 0)
+	{
+		close(rec_fd);
+		snprintf(path, sizeof(path), "%s.%d", rec_path, (int)getpid());
+		rec_open(path);
+		if (rec_fd < 0)
+			rec_state = REC_DONE;
+	}
+	pthread_mutex_unlock(&rec_lock);
+	in_rec--;
+}
+
+/*
+ * now_ns - CLOCK_MONOTONIC in nanoseconds
+ */
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
@@ -0,0 +1,45 @@
+/*
+ * mmrecord.h - Log format of the allocation recorder (libmmrecord.so),
+ *              read back by rec2rep.
+ *
+ * A log is a rechdr_t followed by recop_t records in the order the
+ * threads flushed their buffers. The seq field gives the global order
+ * of the calls; rec2rep sorts by it.
+ */
+#ifndef __MMRECORD_H_
+#define __MMRECORD_H_
+
+#include <stdint.h>
+
+#define REC_MAGIC "MMREC\0\0"
+#define REC_VERSION 1
+
+/* Recorded calls */
+enum
+{
+	REC_MALLOC,	 /* malloc, calloc, posix_memalign: ptr, size */
+	REC_FREE,	 /* free: ptr */
+	REC_REALLOC	 /* realloc: ptr (new), oldptr, size */
+};
+
+typedef struct
+{
+	char magic[8];		/* REC_MAGIC */
+	uint32_t version;	/* REC_VERSION */
+	uint32_t recsize;	/* sizeof(recop_t) */
+	uint64_t pid;		/* recorded process */
+	uint64_t start_ns;	/* CLOCK_MONOTONIC when recording began */
+} rechdr_t;
+
+typedef struct
+{
+	uint64_t seq;	 /* global order of the call */
+	uint64_t ns;	 /* CLOCK_MONOTONIC time of the call */
+	uint64_t ptr;	 /* block returned (or freed) */
+	uint64_t oldptr; /* realloc: block passed in */
+	uint64_t size;	 /* requested size */
+	uint32_t tid;	 /* recording thread (1 = first thread seen) */
+	uint32_t type;	 /* REC_* */
+} recop_t;
+
+#endif /* __MMRECORD_H_ */
@@ -0,0 +1,206 @@
+/*
+ * mmshim.c - Runs real programs on mm.c: a malloc replacement library
+ *     (libmmshim.so) for LD_PRELOAD that serves malloc, free, calloc,
+ *     realloc, memalign, posix_memalign, aligned_alloc, valloc and
+ *     malloc_usable_size with mm_malloc and friends.
+ *
+ *         LD_PRELOAD=$PWD/libmmshim.so app ...
+ *
+ * The heap is a lazily backed anonymous reservation (mem_init_anon) of
+ * $MMSHIM_HEAP bytes (default SHIM_HEAP), so the RSS of the program is
+ * what mm.c really touches. mm.c runs with its lock on, since any
+ * program may be threaded, and the lock is held across fork so that a
+ * child never inherits a heap in the middle of an update.
+ *
+ * The first call initializes the heap. Initialization neither allocates
+ * nor re-enters malloc; a thread that calls malloc while another one is
+ * initializing waits for it. Pointers that are not in the heap (blocks
+ * handed out by the dynamic linker before the library was loaded) are
+ * never freed.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "mm.h"
+#include "memlib.h"
+
+#define SHIM_HEAP (64UL << 30) /* default reservation: 64 GB */
+#define SHIM_MAX ((size_t)1 << 30) /* largest request (mem_sbrk takes an int) */
+
+#define EXPORT __attribute__((visibility("default")))
+
+/* Initialization states */
+enum
+{
+	SHIM_UNINIT,
+	SHIM_INITIALIZING,
+	SHIM_READY
+};
+
+static int shim_state = SHIM_UNINIT;
+
+static void shim_init(void);
+static int in_heap(void *ptr);
+
+EXPORT void *malloc(size_t size)
+{
+	void *p;
+
+	if (shim_state != SHIM_READY)
+		shim_init();
+	if (size > SHIM_MAX)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+	if ((p = mm_malloc(size ? size : 1)) == NULL)
+		errno = ENOMEM;
+	return p;
+}
+
+EXPORT void free(void *ptr)
+{
+	if (ptr != NULL && in_heap(ptr))
+		mm_free(ptr);
+}
+
+EXPORT void *calloc(size_t nmemb, size_t size)
+{
+	void *p;
+
+	if (size != 0 && nmemb > SHIM_MAX / size)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+	if ((p = malloc(nmemb * size)) != NULL)
+		memset(p, 0, nmemb * size);
+	return p;
+}
+
+EXPORT void *realloc(void *ptr, size_t size)
+{
+	void *p;
+
+	if (ptr == NULL)
+		return malloc(size);
+	if (size == 0)
+	{
+		free(ptr);
+		return NULL;
+	}
+	if (size > SHIM_MAX)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+	if (!in_heap(ptr))
+	{
+		/* Not ours, and its size is unknown: nothing safe to copy */
+		errno = ENOMEM;
+		return NULL;
+	}
+	if ((p = mm_realloc(ptr, size)) == NULL)
+		errno = ENOMEM;
+	return p;
+}
+
+EXPORT void *memalign(size_t alignment, size_t size)
+{
+	void *p;
+
+	if (shim_state != SHIM_READY)
+		shim_init();
+	if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+	{
+		errno = EINVAL;
+		return NULL;
+	}
+	if (size > SHIM_MAX || alignment > SHIM_MAX)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+	if ((p = mm_memalign(alignment, size ? size : 1)) == NULL)
+		errno = ENOMEM;
+	return p;
+}
+
+EXPORT int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+	void *p;
+
+	if (alignment < sizeof(void *) || (alignment & (alignment - 1)) != 0)
+		return EINVAL;
+	if ((p = memalign(alignment, size)) == NULL)
+		return ENOMEM;
+	*memptr = p;
+	return 0;
+}
+
+EXPORT void *aligned_alloc(size_t alignment, size_t size)
+{
+	return memalign(alignment, size);
+}
+
+EXPORT void *valloc(size_t size)
+{
+	return memalign(mem_pagesize(), size);
+}
+
+EXPORT size_t malloc_usable_size(void *ptr)
+{
+	if (ptr == NULL || !in_heap(ptr))
+		return 0;
+	return mm_usable_size(ptr);
+}
+
+/*
+ * shim_init - Reserve the heap and start mm.c, once. Threads that get
+ *     here while another one initializes wait until it is done.
+ */
+static void shim_init(void)
+{
+	int expected = SHIM_UNINIT;
+	size_t reserve = SHIM_HEAP;
+	char *env;
+
+	if (!__atomic_compare_exchange_n(&shim_state, &expected, SHIM_INITIALIZING,
+									 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+	{
+		while (__atomic_load_n(&shim_state, __ATOMIC_ACQUIRE) != SHIM_READY)
+			sched_yield();
+		return;
+	}
+
+	if ((env = getenv("MMSHIM_HEAP")) != NULL && strtoul(env, NULL, 0) > 0)
+		reserve = strtoul(env, NULL, 0);
+	if (mem_init_anon(reserve) < 0)
+	{
+		fprintf(stderr, "mmshim: cannot reserve %zu bytes for the heap\n", reserve);
+		abort();
+	}
+	mm_set_threadsafe(1);
+	if (mm_init() < 0)
+	{
+		fprintf(stderr, "mmshim: mm_init failed\n");
+		abort();
+	}
+	__atomic_store_n(&shim_state, SHIM_READY, __ATOMIC_RELEASE);
+
+	/* May allocate, so only once malloc works */
+	pthread_atfork(mm_fork_prepare, mm_fork_parent, mm_fork_child);
+}
+
+/*
+ * in_heap - Is ptr a payload in the mm.c heap?
+ */
+static int in_heap(void *ptr)
+{
+	return shim_state == SHIM_READY && ptr >= mem_heap_lo() &&
+		   ptr <= mem_heap_hi();
+}
@@ -0,0 +1,286 @@
+/*
+ * mthread.c - Multi-threaded trace replay for measuring how an
+ *     allocator scales (mdriver -T).
+ *
+ * MT_COPY: each thread replays the whole trace with its own blocks
+ *     array, so the threads share nothing but the allocator.
+ *
+ * MT_PARTITION: the ops of the trace are split among the threads by id.
+ *     Allocs and reallocs of id i run on thread i % nthreads and the free
+ *     on thread (i + 1) % nthreads, so with two or more threads every
+ *     block is freed by a different thread than the one that allocated
+ *     it. The ops on one id are kept in trace order with a per-id counter
+ *     of completed ops: an op waits until the counter reaches its own
+ *     sequence number. Each thread runs its ops in trace order, so the
+ *     earliest unfinished op of the trace can always run and the replay
+ *     never deadlocks.
+ *
+ * The threads start together at a barrier and replay the trace reps
+ * times, which the caller uses to get measurable run times out of short
+ * traces. Blocks still live at the end of a pass are freed (copy mode
+ * only; the partitioned mode expects balanced traces).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "mthread.h"
+
+/* State shared by the threads of one replay */
+typedef struct
+{
+	trace_t *trace;
+	const mt_alloc_t *a;
+	int mode;
+	int nthreads;
+	int reps;
+	pthread_barrier_t barrier;
+	uint32_t *op_seq;	/* partition: ops on the same id before each op */
+	uint32_t *id_nops;	/* partition: ops on each id in one pass */
+	uint64_t *id_done;	/* partition: ops on each id completed so far */
+	char **blocks;		/* partition: blocks array shared by all threads */
+} mt_shared_t;
+
+/* One replay thread */
+typedef struct
+{
+	mt_shared_t *sh;
+	int tid;
+	long *myops;   /* partition: indices of this thread's ops */
+	long nmyops;   /* number of ops this thread does per pass */
+	double start;  /* when the thread left the barrier */
+	double end;	   /* when it finished its last pass */
+	pthread_t thread;
+} mt_thread_t;
+
+static void *copy_thread(void *arg);
+static void *partition_thread(void *arg);
+static int owner(traceop_t *op, int nthreads);
+static double now(void);
+static void mt_error(const mt_alloc_t *a, char *msg);
+
+/*
+ * mt_replay - Replay trace reps times on nthreads threads in the given
+ *     mode and return the timings in *res. The allocator must already be
+ *     initialized (and thread-safe).
+ */
+void mt_replay(trace_t *trace, const mt_alloc_t *a, int mode,
+			   int nthreads, int reps, mt_result_t *res)
+{
+	mt_shared_t sh;
+	mt_thread_t *th;
+	long i, id, *next;
+	double first, last;
+	int t;
+
+	memset(&sh, 0, sizeof(sh));
+	sh.trace = trace;
+	sh.a = a;
+	sh.mode = mode;
+	sh.nthreads = nthreads;
+	sh.reps = reps;
+	if ((th = (mt_thread_t *)calloc(nthreads, sizeof(mt_thread_t))) == NULL)
+		mt_error(a, "calloc failed in mt_replay");
+
+	if (mode == MT_PARTITION)
+	{
+		/* Number the ops of each id and deal them out to the threads */
+		if ((sh.op_seq = (uint32_t *)malloc(trace->num_ops * sizeof(uint32_t))) == NULL ||
+			(sh.id_nops = (uint32_t *)calloc(trace->num_ids, sizeof(uint32_t))) == NULL ||
+			(sh.id_done = (uint64_t *)calloc(trace->num_ids, sizeof(uint64_t))) == NULL ||
+			(sh.blocks = (char **)calloc(trace->num_ids, sizeof(char *))) == NULL ||
+			(next = (long *)calloc(nthreads, sizeof(long))) == NULL)
+			mt_error(a, "malloc failed in mt_replay");
+		for (i = 0; i < trace->num_ops; i++)
+		{
+			id = trace->ops[i].index;
+			sh.op_seq[i] = sh.id_nops[id]++;
+			th[owner(&trace->ops[i], nthreads)].nmyops++;
+		}
+		for (t = 0; t < nthreads; t++)
+			if ((th[t].myops = (long *)malloc((th[t].nmyops + 1) * sizeof(long))) == NULL)
+				mt_error(a, "malloc failed in mt_replay");
+		for (i = 0; i < trace->num_ops; i++)
+		{
+			t = owner(&trace->ops[i], nthreads);
+			th[t].myops[next[t]++] = i;
+		}
+		free(next);
+	}
+
+	pthread_barrier_init(&sh.barrier, NULL, nthreads);
+	for (t = 0; t < nthreads; t++)
+	{
+		th[t].sh = &sh;
+		th[t].tid = t;
+		if (mode == MT_COPY)
+			th[t].nmyops = trace->num_ops;
+		if (pthread_create(&th[t].thread, NULL,
+						   mode == MT_COPY ? copy_thread : partition_thread,
+						   &th[t]) != 0)
+			mt_error(a, "pthread_create failed in mt_replay");
+	}
+
+	memset(res, 0, sizeof(*res));
+	first = last = 0;
+	for (t = 0; t < nthreads; t++)
+	{
+		pthread_join(th[t].thread, NULL);
+		if (t == 0 || th[t].start < first)
+			first = th[t].start;
+		if (th[t].end > last)
+			last = th[t].end;
+		res->ops += (double)th[t].nmyops * reps;
+		res->thread_secs += th[t].end - th[t].start;
+		free(th[t].myops);
+	}
+	res->wall_secs = last - first;
+
+	pthread_barrier_destroy(&sh.barrier);
+	free(sh.op_seq);
+	free(sh.id_nops);
+	free(sh.id_done);
+	free(sh.blocks);
+	free(th);
+}
+
+/*
+ * copy_thread - Replay the whole trace with a private blocks array
+ */
+static void *copy_thread(void *arg)
+{
+	mt_thread_t *me = (mt_thread_t *)arg;
+	mt_shared_t *sh = me->sh;
+	trace_t *trace = sh->trace;
+	const mt_alloc_t *a = sh->a;
+	traceop_t *op;
+	char **blocks, *p;
+	long i;
+	int r;
+
+	if ((blocks = (char **)calloc(trace->num_ids, sizeof(char *))) == NULL)
+		mt_error(a, "calloc failed in copy_thread");
+
+	pthread_barrier_wait(&sh->barrier);
+	me->start = now();
+	for (r = 0; r < sh->reps; r++)
+	{
+		for (i = 0; i < trace->num_ops; i++)
+		{
+			op = &trace->ops[i];
+			switch (op->type)
+			{
+			case ALLOC:
+				if ((p = a->malloc_fn(op->size)) == NULL)
+					mt_error(a, "malloc failed in copy_thread");
+				blocks[op->index] = p;
+				break;
+			case REALLOC:
+				if ((p = a->realloc_fn(blocks[op->index], op->size)) == NULL)
+					mt_error(a, "realloc failed in copy_thread");
+				blocks[op->index] = p;
+				break;
+			case FREE:
+				a->free_fn(blocks[op->index]);
+				blocks[op->index] = NULL;
+				break;
+			}
+		}
+		for (i = 0; i < trace->num_ids; i++)
+			if (blocks[i] != NULL)
+			{
+				a->free_fn(blocks[i]);
+				blocks[i] = NULL;
+			}
+	}
+	me->end = now();
+
+	free(blocks);
+	return NULL;
+}
+
+/*
+ * partition_thread - Replay this thread's share of the ops, each one
+ *     after the earlier ops on the same id
+ */
+static void *partition_thread(void *arg)
+{
+	mt_thread_t *me = (mt_thread_t *)arg;
+	mt_shared_t *sh = me->sh;
+	trace_t *trace = sh->trace;
+	const mt_alloc_t *a = sh->a;
+	traceop_t *op;
+	char *p;
+	long i, k;
+	uint64_t id, target;
+	int r;
+
+	pthread_barrier_wait(&sh->barrier);
+	me->start = now();
+	for (r = 0; r < sh->reps; r++)
+	{
+		for (k = 0; k < me->nmyops; k++)
+		{
+			i = me->myops[k];
+			op = &trace->ops[i];
+			id = op->index;
+			target = (uint64_t)r * sh->id_nops[id] + sh->op_seq[i];
+			while (__atomic_load_n(&sh->id_done[id], __ATOMIC_ACQUIRE) != target)
+				sched_yield();
+
+			switch (op->type)
+			{
+			case ALLOC:
+				if ((p = a->malloc_fn(op->size)) == NULL)
+					mt_error(a, "malloc failed in partition_thread");
+				sh->blocks[id] = p;
+				break;
+			case REALLOC:
+				if ((p = a->realloc_fn(sh->blocks[id], op->size)) == NULL)
+					mt_error(a, "realloc failed in partition_thread");
+				sh->blocks[id] = p;
+				break;
+			case FREE:
+				a->free_fn(sh->blocks[id]);
+				sh->blocks[id] = NULL;
+				break;
+			}
+			__atomic_store_n(&sh->id_done[id], target + 1, __ATOMIC_RELEASE);
+		}
+	}
+	me->end = now();
+	return NULL;
+}
+
+/*
+ * owner - The thread that runs op in MT_PARTITION mode
+ */
+static int owner(traceop_t *op, int nthreads)
+{
+	if (op->type == FREE)
+		return (op->index + 1) % nthreads;
+	return op->index % nthreads;
+}
+
+/*
+ * now - current time in seconds from a monotonic clock
+ */
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+/*
+ * mt_error - Report a failed request and terminate
+ */
+static void mt_error(const mt_alloc_t *a, char *msg)
+{
+	fprintf(stderr, "ERROR [%s, threaded replay]: %s\n", a->name, msg);
+	exit(1);
+}
@@ -0,0 +1,36 @@
+/*
+ * mthread.h - Replays a trace on several threads at once (mdriver -T).
+ */
+#ifndef __MTHREAD_H_
+#define __MTHREAD_H_
+
+#include "trace.h"
+
+/* The allocator under test */
+typedef struct
+{
+	char *name;
+	void *(*malloc_fn)(size_t size);
+	void (*free_fn)(void *ptr);
+	void *(*realloc_fn)(void *ptr, size_t size);
+} mt_alloc_t;
+
+/* Replay modes */
+enum
+{
+	MT_COPY,	 /* every thread replays its own copy of the trace */
+	MT_PARTITION /* the ops of one trace are split among the threads */
+};
+
+/* Result of one multi-threaded replay */
+typedef struct
+{
+	double wall_secs;	/* first thread start to last thread end */
+	double ops;			/* ops done by all threads */
+	double thread_secs; /* sum over threads of the time each one ran */
+} mt_result_t;
+
+void mt_replay(trace_t *trace, const mt_alloc_t *a, int mode,
+			   int nthreads, int reps, mt_result_t *res);
+
+#endif /* __MTHREAD_H_ */
@@ -0,0 +1,30 @@
+/*
+ * nullmm.c - The null allocator of mdriver --calibrate. Every request
+ *     returns the same non-NULL pointer and nothing is ever written to
+ *     it, so a replay against it costs only the loop, the trace reads,
+ *     the block table updates and the calls themselves.
+ *
+ * It lives in its own file so that the compiler cannot inline the
+ * calls into the replay loop or drop them: timed against it, the loop
+ * must do exactly the work it does around mm_malloc and friends.
+ */
+#include "nullmm.h"
+
+static char null_block[16];
+
+void *null_malloc(size_t size)
+{
+	(void)size;
+	return null_block;
+}
+
+void *null_realloc(void *ptr, size_t size)
+{
+	(void)size;
+	return ptr ? ptr : null_block;
+}
+
+void null_free(void *ptr)
+{
+	(void)ptr;
+}
@@ -0,0 +1,14 @@
+/*
+ * nullmm.h - An allocator that does nothing, for measuring what the
+ *            driver's replay loop itself costs (mdriver --calibrate).
+ */
+#ifndef __NULLMM_H_
+#define __NULLMM_H_
+
+#include <stddef.h>
+
+void *null_malloc(size_t size);
+void *null_realloc(void *ptr, size_t size);
+void null_free(void *ptr);
+
+#endif /* __NULLMM_H_ */
@@ -0,0 +1,136 @@
+/*
+ * perfctr.c - Grouped perf_event_open counters (mdriver -P).
+ *
+ * The counters belong to the process that opened them, so a process
+ * forked by mdriver -j opens its own group on first use. Only user-mode
+ * events are counted, which is what perf_event_paranoid <= 2 allows an
+ * unprivileged user to see. If the PMU is overcommitted and the kernel
+ * multiplexes the group, the counts are scaled up by enabled/running.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "perfctr.h"
+
+/* The event behind each PC_* slot */
+static const struct
+{
+	uint32_t type;
+	uint64_t config;
+} events[PC_NEVENTS] = {
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+	{PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB |
+							 (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+							 (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+static pid_t owner = 0;			 /* process the group was opened in */
+static int leader = -1;			 /* fd of the group leader */
+static int fds[PC_NEVENTS];		 /* fd of each event, -1 if not counted */
+static int slot[PC_NEVENTS];	 /* position of each event in a group read */
+static int nopen = 0;			 /* events in the group */
+static char errbuf[128] = "";	 /* why the first event failed to open */
+
+static int open_event(int e, int group_fd);
+
+/*
+ * pc_open - Open the counter group in the calling process (again, after
+ *     a fork) and return the number of events in it, 0 if none
+ */
+int pc_open(void)
+{
+	int e;
+
+	if (owner == getpid())
+		return nopen;
+	for (e = 0; e < PC_NEVENTS; e++)
+		if (owner != 0 && fds[e] >= 0)
+			close(fds[e]);
+	owner = getpid();
+	leader = -1;
+	nopen = 0;
+
+	for (e = 0; e < PC_NEVENTS; e++)
+	{
+		fds[e] = open_event(e, leader);
+		if (fds[e] < 0)
+		{
+			if (errbuf[0] == '\0')
+				snprintf(errbuf, sizeof(errbuf), "perf_event_open: %s",
+						 strerror(errno));
+			continue;
+		}
+		if (leader < 0)
+			leader = fds[e];
+		slot[e] = nopen++;
+	}
+	return nopen;
+}
+
+/*
+ * pc_error - Why an event could not be opened ("" if they all were)
+ */
+const char *pc_error(void)
+{
+	return errbuf;
+}
+
+/*
+ * pc_measure - Call f(argp) once with the counter group running and
+ *     store the counts in *pc. Without counters f is not called at all
+ *     and every count is -1.
+ */
+void pc_measure(void (*f)(void *), void *argp, pcstat_t *pc)
+{
+	uint64_t buf[3 + PC_NEVENTS]; /* nr, time_enabled, time_running, values */
+	double scale;
+	int e;
+
+	for (e = 0; e < PC_NEVENTS; e++)
+		pc->count[e] = -1;
+	if (pc_open() == 0)
+		return;
+
+	ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	f(argp);
+	ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+	if (read(leader, buf, sizeof(buf)) < (ssize_t)(3 + nopen) * 8 ||
+		buf[2] == 0)
+		return;
+	scale = (double)buf[1] / (double)buf[2];
+	for (e = 0; e < PC_NEVENTS; e++)
+		if (fds[e] >= 0)
+			pc->count[e] = buf[3 + slot[e]] * scale;
+}
+
+/*
+ * open_event - Open event e of the calling process, in the group of
+ *     group_fd (-1 to start a group). Returns the fd or -1.
+ */
+static int open_event(int e, int group_fd)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = events[e].type;
+	attr.config = events[e].config;
+	attr.disabled = (group_fd < 0); /* the leader starts the group */
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_GROUP |
+					   PERF_FORMAT_TOTAL_TIME_ENABLED |
+					   PERF_FORMAT_TOTAL_TIME_RUNNING;
+	return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
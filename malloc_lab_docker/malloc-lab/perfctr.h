@@ -0,0 +1,35 @@
+/*
+ * perfctr.h - Hardware performance counters around a timed function
+ *             (mdriver -P).
+ *
+ * The events are opened as one perf_event_open group, so they are
+ * scheduled onto the PMU together and all count the same stretch of
+ * execution. Events the machine (or the container) does not offer are
+ * left out of the group; if none can be opened, pc_open reports why and
+ * the caller carries on without counters.
+ */
+#ifndef __PERFCTR_H_
+#define __PERFCTR_H_
+
+/* Counted events */
+enum
+{
+	PC_CYCLES,
+	PC_INSTR,
+	PC_CACHE_MISS,	/* last level cache misses */
+	PC_DTLB_MISS,	/* data TLB load misses */
+	PC_BRANCH_MISS, /* mispredicted branches */
+	PC_NEVENTS
+};
+
+/* Counts of one measured run; an event that could not be counted is < 0 */
+typedef struct
+{
+	double count[PC_NEVENTS];
+} pcstat_t;
+
+int pc_open(void);
+const char *pc_error(void);
+void pc_measure(void (*f)(void *), void *argp, pcstat_t *pc);
+
+#endif /* __PERFCTR_H_ */
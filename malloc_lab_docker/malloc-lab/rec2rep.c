@@ -0,0 +1,303 @@
+/*
+ * rec2rep.c - Turns a log of libmmrecord.so into a trace for mdriver.
+ *
+ *     rec2rep [-t] <log> <out.rep>
+ *         Orders the recorded calls, numbers the blocks and writes a
+ *         .rep trace with the usual four-line header. The trace is
+ *         balanced the way checktrace.pl does it: frees of every block
+ *         still live at the end are appended. With -t the thread id and
+ *         time (ns since recording began) of each op are written to
+ *         <out.rep>.tid, one "tid ns" line per op.
+ *
+ *     Calls that cannot be replayed are adapted: frees of blocks that
+ *     were allocated before recording began are dropped, a realloc of
+ *     such a block becomes an alloc, realloc(p, 0) becomes a free, zero
+ *     sizes become 1, and an allocation of an address that is still
+ *     live (a realloc racing with another thread) frees the old block
+ *     first.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+#include "mmrecord.h"
+#include "trace.h"
+#include "tstream.h"
+
+/* One op of the trace being built, with where it came from */
+typedef struct
+{
+    traceop_t op;
+    uint32_t tid;
+    uint64_t ns;
+} repop_t;
+
+/* The trace being built */
+static repop_t *ops = NULL;
+static long num_ops = 0, max_ops = 0;
+static uint64_t num_ids = 0;
+static size_t live_bytes = 0, peak_bytes = 0;
+static long implicit = 0; /* frees inserted before a reused live address */
+
+static void emit(int type, uint64_t id, uint64_t size, recop_t *r);
+static uint64_t alloc_id(idmap_t *live, recop_t *r, uint64_t addr);
+static void free_id(idmap_t *live, idmap_ent_t *e, recop_t *r);
+static int by_seq(const void *a, const void *b);
+static int by_id(const void *a, const void *b);
+static void usage(void);
+static void rec_error(char *msg, char *path);
+
+int main(int argc, char **argv)
+{
+    int c, tids = 0;
+    FILE *fp;
+    rechdr_t hdr;
+    recop_t *recs, *r, *ends;
+    long nrecs, maxrecs = 1 << 16, i, n;
+    long dropped = 0, balanced = 0;
+    idmap_t live;
+    idmap_ent_t *e;
+    uint64_t id, *left;
+    uint32_t maxtid = 0;
+    char sidecar[4096];
+
+    while ((c = getopt(argc, argv, "th")) != EOF) {
+	switch (c) {
+	case 't':
+	    tids = 1;
+	    break;
+	case 'h':
+	    usage();
+	    exit(0);
+	default:
+	    usage();
+	    exit(1);
+	}
+    }
+    if (argc - optind != 2) {
+	usage();
+	exit(1);
+    }
+
+    /* Read and order the log */
+    if ((fp = fopen(argv[optind], "r")) == NULL)
+	rec_error(strerror(errno), argv[optind]);
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1 ||
+	memcmp(hdr.magic, REC_MAGIC, sizeof(hdr.magic)) != 0)
+	rec_error("not a libmmrecord log", argv[optind]);
+    if (hdr.version != REC_VERSION || hdr.recsize != sizeof(recop_t))
+	rec_error("log written by an incompatible libmmrecord", argv[optind]);
+    if ((recs = malloc(maxrecs * sizeof(recop_t))) == NULL)
+	rec_error("out of memory", argv[optind]);
+    for (nrecs = 0; (n = fread(recs + nrecs, sizeof(recop_t),
+			       maxrecs - nrecs, fp)) > 0; nrecs += n)
+	if (nrecs + n == maxrecs &&
+	    (recs = realloc(recs, (maxrecs *= 2) * sizeof(recop_t))) == NULL)
+	    rec_error("out of memory", argv[optind]);
+    fclose(fp);
+    qsort(recs, nrecs, sizeof(recop_t), by_seq);
+
+    /*
+     * Replay the calls against a table of the live addresses. The table
+     * is keyed by address; its p field holds the trace id of the block.
+     */
+    idmap_init(&live);
+    for (i = 0; i < nrecs; i++) {
+	r = &recs[i];
+	if (r->tid > maxtid)
+	    maxtid = r->tid;
+	switch (r->type) {
+	case REC_MALLOC:
+	    emit(ALLOC, alloc_id(&live, r, r->ptr), r->size ? r->size : 1, r);
+	    break;
+
+	case REC_FREE:
+	    if ((e = idmap_find(&live, r->ptr)) == NULL) {
+		dropped++;
+		break;
+	    }
+	    free_id(&live, e, r);
+	    break;
+
+	case REC_REALLOC:
+	    e = r->oldptr ? idmap_find(&live, r->oldptr) : NULL;
+	    if (r->ptr == 0) {		/* realloc(p, 0) */
+		if (e != NULL)
+		    free_id(&live, e, r);
+		else
+		    dropped++;
+		break;
+	    }
+	    if (e == NULL) {		/* realloc(NULL, n) or unknown block */
+		emit(ALLOC, alloc_id(&live, r, r->ptr), r->size ? r->size : 1, r);
+		break;
+	    }
+	    id = (uint64_t)(uintptr_t)e->p;
+	    live_bytes -= e->size;
+	    idmap_remove(&live, e);
+	    if ((e = idmap_find(&live, r->ptr)) != NULL) {
+		free_id(&live, e, r);
+		implicit++;
+	    }
+	    e = idmap_insert(&live, r->ptr);
+	    e->p = (char *)(uintptr_t)id;
+	    e->size = r->size ? r->size : 1;
+	    live_bytes += e->size;
+	    peak_bytes = (live_bytes > peak_bytes) ? live_bytes : peak_bytes;
+	    emit(REALLOC, id, e->size, r);
+	    break;
+
+	default:
+	    rec_error("bad record type in", argv[optind]);
+	}
+    }
+
+    /* Balance the trace: free what is still live, in id order */
+    if ((left = malloc((live.count + 1) * sizeof(uint64_t))) == NULL ||
+	(ends = malloc((num_ids + 1) * sizeof(recop_t))) == NULL)
+	rec_error("out of memory", argv[optind]);
+    for (i = 0; i < num_ops; i++) {	/* last op on each id */
+	ends[ops[i].op.index].tid = ops[i].tid;
+	ends[ops[i].op.index].ns = ops[i].ns;
+    }
+    for (n = 0, i = 0; i <= (long)live.mask; i++)
+	if (live.slots[i].id != IDMAP_EMPTY)
+	    left[n++] = (uint64_t)(uintptr_t)live.slots[i].p;
+    qsort(left, n, sizeof(uint64_t), by_id);
+    for (i = 0; i < n; i++) {
+	emit(FREE, left[i], 0, &ends[left[i]]);
+	balanced++;
+    }
+
+    /* Write the trace and the sidecar */
+    if ((fp = fopen(argv[optind + 1], "w")) == NULL)
+	rec_error(strerror(errno), argv[optind + 1]);
+    fprintf(fp, "%zu\n%lu\n%ld\n%d\n", peak_bytes, (unsigned long)num_ids,
+	    num_ops, 1);
+    for (i = 0; i < num_ops; i++) {
+	traceop_t *op = &ops[i].op;
+
+	if (op->type == ALLOC)
+	    fprintf(fp, "a %lu %lu\n", (unsigned long)op->index, (unsigned long)op->size);
+	else if (op->type == REALLOC)
+	    fprintf(fp, "r %lu %lu\n", (unsigned long)op->index, (unsigned long)op->size);
+	else
+	    fprintf(fp, "f %lu\n", (unsigned long)op->index);
+    }
+    if (fclose(fp) != 0)
+	rec_error(strerror(errno), argv[optind + 1]);
+    if (tids) {
+	snprintf(sidecar, sizeof(sidecar), "%s.tid", argv[optind + 1]);
+	if ((fp = fopen(sidecar, "w")) == NULL)
+	    rec_error(strerror(errno), sidecar);
+	for (i = 0; i < num_ops; i++)
+	    fprintf(fp, "%u %lu\n", ops[i].tid,
+		    (unsigned long)(ops[i].ns - hdr.start_ns));
+	if (fclose(fp) != 0)
+	    rec_error(strerror(errno), sidecar);
+    }
+
+    printf("%s: %ld calls from %u threads -> %s: %ld ops, %lu ids, "
+	   "peak %zu bytes\n", argv[optind], nrecs, maxtid, argv[optind + 1],
+	   num_ops, (unsigned long)num_ids, peak_bytes);
+    printf("  %ld frees of unrecorded blocks dropped, %ld implicit frees, "
+	   "%ld balancing frees\n", dropped, implicit, balanced);
+
+    idmap_destroy(&live);
+    free(left);
+    free(ends);
+    free(recs);
+    free(ops);
+    exit(0);
+}
+
+/*
+ * emit - Append an op to the trace, attributed to record r
+ */
+static void emit(int type, uint64_t id, uint64_t size, recop_t *r)
+{
+    repop_t *o;
+
+    if (num_ops == max_ops) {
+	max_ops = max_ops ? 2 * max_ops : 1 << 16;
+	if ((ops = realloc(ops, max_ops * sizeof(repop_t))) == NULL)
+	    rec_error("out of memory", "");
+    }
+    o = &ops[num_ops++];
+    o->op.type = type;
+    o->op.pad = 0;
+    o->op.index = id;
+    o->op.size = size;
+    o->tid = r->tid;
+    o->ns = r->ns;
+}
+
+/*
+ * alloc_id - Give the block that r allocated at addr a new id. An older
+ *     block still live at addr is freed first.
+ */
+static uint64_t alloc_id(idmap_t *live, recop_t *r, uint64_t addr)
+{
+    idmap_ent_t *e;
+
+    if ((e = idmap_find(live, addr)) != NULL) {
+	free_id(live, e, r);
+	implicit++;
+    }
+    e = idmap_insert(live, addr);
+    e->p = (char *)(uintptr_t)num_ids;
+    e->size = r->size ? r->size : 1;
+    live_bytes += e->size;
+    peak_bytes = (live_bytes > peak_bytes) ? live_bytes : peak_bytes;
+    return num_ids++;
+}
+
+/*
+ * free_id - Emit the free of the live block e and forget it
+ */
+static void free_id(idmap_t *live, idmap_ent_t *e, recop_t *r)
+{
+    emit(FREE, (uint64_t)(uintptr_t)e->p, 0, r);
+    live_bytes -= e->size;
+    idmap_remove(live, e);
+}
+
+/*
+ * by_seq, by_id - qsort comparators
+ */
+static int by_seq(const void *a, const void *b)
+{
+    uint64_t x = ((const recop_t *)a)->seq, y = ((const recop_t *)b)->seq;
+
+    return (x > y) - (x < y);
+}
+
+static int by_id(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: rec2rep [-th] <log> <out.rep>\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-h         Print this message.\n");
+    fprintf(stderr, "\t-t         Also write <out.rep>.tid with the thread id and\n");
+    fprintf(stderr, "\t           time in ns of every op.\n");
+}
+
+/*
+ * rec_error - Report a problem with a file and terminate
+ */
+static void rec_error(char *msg, char *path)
+{
+    fprintf(stderr, "rec2rep: %s: %s\n", path, msg);
+    exit(1);
+}
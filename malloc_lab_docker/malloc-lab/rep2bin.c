@@ -0,0 +1,66 @@
+/*
+ * rep2bin.c - Converts a malloc trace to the binary trace format that
+ *     mdriver can load without parsing (see trace.h).
+ *
+ *     rep2bin [-z] <in> <out>
+ *         Reads <in> (a text .rep file, or a binary trace) and writes
+ *         it to <out> as fixed-width records, or with -z as the more
+ *         compact delta/varint encoding.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+#include "trace.h"
+
+static void usage(void);
+
+int main(int argc, char **argv)
+{
+    int c;
+    int encoding = TRACE_FIXED;
+    trace_t *trace;
+
+    while ((c = getopt(argc, argv, "zh")) != EOF) {
+	switch (c) {
+	case 'z':
+	    encoding = TRACE_VARINT;
+	    break;
+	case 'h':
+	    usage();
+	    exit(0);
+	default:
+	    usage();
+	    exit(1);
+	}
+    }
+    if (argc - optind != 2) {
+	usage();
+	exit(1);
+    }
+
+    trace = read_trace("", argv[optind]);
+    if (write_trace(trace, argv[optind + 1], encoding) < 0) {
+	printf("%s: %s\n", argv[optind + 1], strerror(errno));
+	exit(1);
+    }
+    printf("%s: %ld ops, %ld ids -> %s (%s)\n", argv[optind],
+	   trace->num_ops, trace->num_ids, argv[optind + 1],
+	   encoding == TRACE_FIXED ? "fixed" : "varint");
+    free_trace(trace);
+    exit(0);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: rep2bin [-zh] <in> <out>\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-h         Print this message.\n");
+    fprintf(stderr, "\t-z         Delta/varint encode the ops (decoded on load).\n");
+    fprintf(stderr, "\t           Default is fixed-width records that are mmap'd as is.\n");
+}
@@ -0,0 +1,453 @@
+/*
+ * results.c - The performance index, and the results of a run as JSON
+ *     or CSV for tracking an allocator across commits.
+ *
+ * The JSON file holds an "env" object describing the machine and the
+ * timer, the performance index, and one array of per-trace objects per
+ * allocator ("mm", and "libc" with -l), one trace object per line.
+ * compare_results reads the "mm" array of such a file back; it is not a
+ * general JSON parser and expects the layout write_json produces.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sys/utsname.h>
+
+#include "config.h"
+#include "results.h"
+
+#define MAXLINE 1024
+#define SIG_Z 2.0 /* standard errors a timing change must exceed */
+
+/* One trace of a baseline file */
+typedef struct
+{
+	char file[MAXLINE];
+	int valid;
+	double util; /* < 0 if null (a backend without a heap, -A libc) */
+	double ops, secs, secs_sd;
+	double secs_lo, secs_hi; /* < 0 if the baseline predates intervals */
+	int reps;
+} basetrace_t;
+
+static void json_stats(FILE *fp, const char *name, char **tracefiles,
+					   int n, stats_t *stats);
+static void csv_stats(FILE *fp, const char *name, char **tracefiles, int n,
+					  stats_t *stats, runinfo_t *info);
+static void json_string(FILE *fp, const char *s);
+static const char *cpu_model(void);
+static char *read_file(const char *path);
+static int parse_trace(char *obj, basetrace_t *b);
+static char *field(char *obj, const char *key);
+static double kops(double ops, double secs);
+static const char *fmt_util(char *buf, double util, const char *none);
+static void results_error(char *msg, const char *path);
+
+/*
+ * perf_index - The performance index of a run, out of 100: UTIL_WEIGHT
+ *     of it for the average utilization and the rest for the throughput
+ *     over all traces relative to AVG_LIBC_THRUPUT (capped at 1). The two
+ *     parts are returned in *util_pts and *thru_pts.
+ */
+double perf_index(int n, stats_t *stats, double *util_pts, double *thru_pts)
+{
+	double secs = 0, ops = 0, util = 0, thru, p1, p2;
+	int i;
+
+	for (i = 0; i < n; i++)
+	{
+		secs += stats[i].secs;
+		ops += stats[i].ops;
+		util += stats[i].util;
+	}
+	thru = ops / secs;
+
+	p1 = UTIL_WEIGHT * (util / n);
+	if (thru > AVG_LIBC_THRUPUT)
+		p2 = (double)(1.0 - UTIL_WEIGHT);
+	else
+		p2 = ((double)(1.0 - UTIL_WEIGHT)) * (thru / AVG_LIBC_THRUPUT);
+
+	*util_pts = p1 * 100.0;
+	*thru_pts = p2 * 100.0;
+	return (p1 + p2) * 100.0;
+}
+
+/*
+ * write_json - Write the results of the run to path as JSON. libc may be
+ *     NULL if libc malloc was not run.
+ */
+void write_json(const char *path, char **tracefiles, int n, stats_t *mm,
+				stats_t *libc, runinfo_t *info)
+{
+	struct utsname u;
+	char date[64];
+	time_t now = time(NULL);
+	FILE *fp;
+
+	if ((fp = fopen(path, "w")) == NULL)
+		results_error("Could not open", path);
+	uname(&u);
+	strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+	fprintf(fp, "{\n  \"env\": {\n");
+	fprintf(fp, "    \"date\": \"%s\",\n", date);
+	fprintf(fp, "    \"host\": ");
+	json_string(fp, u.nodename);
+	fprintf(fp, ",\n    \"os\": ");
+	json_string(fp, u.sysname);
+	fprintf(fp, ",\n    \"release\": ");
+	json_string(fp, u.release);
+	fprintf(fp, ",\n    \"machine\": ");
+	json_string(fp, u.machine);
+	fprintf(fp, ",\n    \"cpu\": ");
+	json_string(fp, cpu_model());
+	fprintf(fp, ",\n    \"compiler\": ");
+	json_string(fp, __VERSION__);
+	fprintf(fp, ",\n    \"timer\": \"%s\",\n", info->timer);
+	fprintf(fp, "    \"mhz\": %.1f,\n", info->mhz);
+	fprintf(fp, "    \"jobs\": %d\n  },\n", info->jobs);
+	if (info->perfindex < 0)
+		fprintf(fp, "  \"perfindex\": null,\n");
+	else
+		fprintf(fp, "  \"perfindex\": %.2f,\n", info->perfindex);
+	json_stats(fp, "mm", tracefiles, n, mm);
+	if (libc != NULL)
+	{
+		fprintf(fp, ",\n");
+		json_stats(fp, "libc", tracefiles, n, libc);
+	}
+	fprintf(fp, "\n}\n");
+	if (fclose(fp) != 0)
+		results_error("Could not write", path);
+}
+
+/*
+ * write_csv - Write the results of the run to path as CSV, one row per
+ *     allocator and trace with the environment repeated on every row
+ */
+void write_csv(const char *path, char **tracefiles, int n, stats_t *mm,
+			   stats_t *libc, runinfo_t *info)
+{
+	FILE *fp;
+
+	if ((fp = fopen(path, "w")) == NULL)
+		results_error("Could not open", path);
+	fprintf(fp, "allocator,trace,file,valid,util,ops,secs,secs_sd,secs_lo,"
+				"secs_hi,secs_null,kops,reps,tutil,faults,pages,run_faults,"
+				"run_pages,timer,mhz,cpu\n");
+	csv_stats(fp, "mm", tracefiles, n, mm, info);
+	if (libc != NULL)
+		csv_stats(fp, "libc", tracefiles, n, libc, info);
+	if (fclose(fp) != 0)
+		results_error("Could not write", path);
+}
+
+/*
+ * compare_results - Compare the mm results of this run to the "mm" array
+ *     of a JSON baseline, trace by trace (matched by file name), and
+ *     print a table. A trace regressed if it is no longer valid, if its
+ *     utilization fell by more than threshold percent, or if its run
+ *     time grew by more than threshold percent and, when both runs have
+ *     two or more reps, the confidence intervals of the two medians do
+ *     not overlap (or, against a baseline without intervals, by more
+ *     than SIG_Z standard errors of the difference). Returns the number
+ *     of regressed traces.
+ */
+int compare_results(const char *baseline, char **tracefiles, int n,
+					stats_t *mm, double threshold)
+{
+	char *buf, *p, *end, *name;
+	basetrace_t *base, *b;
+	int nbase = 0, maxbase = 0, i, j, regressed = 0, slower, lessutil;
+	double se, dthru;
+	char bu[32], mu[32], du[32];
+
+	buf = read_file(baseline);
+	if ((p = strstr(buf, "\"mm\": [")) == NULL)
+		results_error("No \"mm\" results in", baseline);
+	for (end = p; (end = strchr(end, '{')) != NULL; end++)
+		maxbase++;
+	if ((base = (basetrace_t *)calloc(maxbase + 1, sizeof(basetrace_t))) == NULL)
+		results_error("Out of memory reading", baseline);
+	while ((p = strchr(p, '{')) != NULL)
+	{
+		if ((end = strchr(p, '}')) == NULL)
+			results_error("Truncated trace object in", baseline);
+		*end = '\0';
+		if (parse_trace(p + 1, &base[nbase]) < 0)
+			results_error("Malformed trace object in", baseline);
+		nbase++;
+		p = end + 1;
+		while (*p == ',' || *p == ' ' || *p == '\n')
+			p++;
+		if (*p == ']')
+			break;
+	}
+
+	printf("\nComparison with %s (threshold %.1f%%):\n", baseline, threshold);
+	printf("%5s%10s%10s%9s%8s%8s%9s  %s\n", "trace", "base Kops", "Kops",
+		   "change", "base", "util", "change", "");
+	for (i = 0; i < n; i++)
+	{
+		name = strrchr(tracefiles[i], '/') ? strrchr(tracefiles[i], '/') + 1
+										   : tracefiles[i];
+		for (b = NULL, j = 0; j < nbase && b == NULL; j++)
+			if (!strcmp(base[j].file, name))
+				b = &base[j];
+		if (b == NULL || !b->valid)
+		{
+			printf("%2d%57s  %s\n", i, "", b ? "invalid in baseline"
+											 : "not in baseline");
+			continue;
+		}
+		snprintf(bu, sizeof(bu), "%.0f%%", b->util * 100);
+		if (!mm[i].valid)
+		{
+			printf("%2d%13.0f%10s%9s%8s%8s%9s  REGRESSED (invalid)\n",
+				   i, kops(b->ops, b->secs), "-", "-", b->util < 0 ? "-" : bu,
+				   "-", "-");
+			regressed++;
+			continue;
+		}
+
+		dthru = 100.0 * (kops(mm[i].ops, mm[i].secs) / kops(b->ops, b->secs) - 1);
+		slower = (mm[i].secs - b->secs) > threshold / 100.0 * b->secs;
+		if (slower && mm[i].reps > 1 && b->reps > 1 && b->secs_hi >= 0)
+			slower = mm[i].secs_lo > b->secs_hi;
+		else if (slower && mm[i].reps > 1 && b->reps > 1)
+		{
+			se = sqrt(mm[i].secs_sd * mm[i].secs_sd / mm[i].reps +
+					  b->secs_sd * b->secs_sd / b->reps);
+			slower = (mm[i].secs - b->secs) > SIG_Z * se;
+		}
+		/* util is compared only if both runs measured it (not -A libc) */
+		snprintf(mu, sizeof(mu), "%.0f%%", mm[i].util * 100);
+		snprintf(du, sizeof(du), "%+.1f%%", 100.0 * (mm[i].util / b->util - 1));
+		lessutil = b->util > 0 && mm[i].util >= 0 &&
+				   (b->util - mm[i].util) > threshold / 100.0 * b->util;
+		printf("%2d%13.0f%10.0f%+8.1f%%%8s%8s%9s  %s\n",
+			   i, kops(b->ops, b->secs), kops(mm[i].ops, mm[i].secs), dthru,
+			   b->util < 0 ? "-" : bu, mm[i].util < 0 ? "-" : mu,
+			   b->util > 0 && mm[i].util >= 0 ? du : "-",
+			   slower && lessutil ? "REGRESSED (thru, util)"
+			   : slower			  ? "REGRESSED (thru)"
+			   : lessutil		  ? "REGRESSED (util)"
+								  : "");
+		regressed += slower || lessutil;
+	}
+	printf("%d of %d traces regressed\n", regressed, n);
+
+	free(base);
+	free(buf);
+	return regressed;
+}
+
+/*
+ * json_stats - Write the per-trace array of one allocator
+ */
+static void json_stats(FILE *fp, const char *name, char **tracefiles,
+					   int n, stats_t *stats)
+{
+	const char *file;
+	char ubuf[32], tbuf[32];
+	int i;
+
+	fprintf(fp, "  \"%s\": [\n", name);
+	for (i = 0; i < n; i++)
+	{
+		file = strrchr(tracefiles[i], '/') ? strrchr(tracefiles[i], '/') + 1
+										   : tracefiles[i];
+		fprintf(fp, "    {\"trace\": %d, \"file\": ", i);
+		json_string(fp, file);
+		fprintf(fp, ", \"valid\": %s, \"util\": %s, \"ops\": %.0f, "
+					"\"secs\": %.9f, \"secs_sd\": %.9f, \"secs_lo\": %.9f, "
+					"\"secs_hi\": %.9f, \"secs_null\": %.9f, \"kops\": %.1f, "
+					"\"reps\": %d, \"tutil\": %s, \"faults\": %.0f, "
+					"\"pages\": %.0f, \"run_faults\": %.1f, \"run_pages\": %.0f}%s\n",
+				stats[i].valid ? "true" : "false",
+				fmt_util(ubuf, stats[i].util, "null"),
+				stats[i].ops, stats[i].secs, stats[i].secs_sd,
+				stats[i].secs_lo, stats[i].secs_hi, stats[i].secs_null,
+				stats[i].valid ? kops(stats[i].ops, stats[i].secs) : 0.0,
+				stats[i].reps, fmt_util(tbuf, stats[i].tutil, "null"),
+				stats[i].faults, stats[i].pages, stats[i].run_faults,
+				stats[i].run_pages, (i < n - 1) ? "," : "");
+	}
+	fprintf(fp, "  ]");
+}
+
+/*
+ * csv_stats - Write the rows of one allocator
+ */
+static void csv_stats(FILE *fp, const char *name, char **tracefiles, int n,
+					  stats_t *stats, runinfo_t *info)
+{
+	const char *file;
+	char ubuf[32], tbuf[32];
+	int i;
+
+	for (i = 0; i < n; i++)
+	{
+		file = strrchr(tracefiles[i], '/') ? strrchr(tracefiles[i], '/') + 1
+										   : tracefiles[i];
+		fprintf(fp, "%s,%d,%s,%d,%s,%.0f,%.9f,%.9f,%.9f,%.9f,%.9f,%.1f,%d,"
+					"%s,%.0f,%.0f,%.1f,%.0f,%s,%.1f,\"%s\"\n",
+				name, i, file, stats[i].valid, fmt_util(ubuf, stats[i].util, ""),
+				stats[i].ops,
+				stats[i].secs, stats[i].secs_sd, stats[i].secs_lo,
+				stats[i].secs_hi, stats[i].secs_null,
+				stats[i].valid ? kops(stats[i].ops, stats[i].secs) : 0.0,
+				stats[i].reps, fmt_util(tbuf, stats[i].tutil, ""), stats[i].faults,
+				stats[i].pages, stats[i].run_faults, stats[i].run_pages,
+				info->timer, info->mhz,
+				cpu_model());
+	}
+}
+
+/*
+ * json_string - Write s as a JSON string literal
+ */
+static void json_string(FILE *fp, const char *s)
+{
+	putc('"', fp);
+	for (; *s != '\0'; s++)
+	{
+		if (*s == '"' || *s == '\\')
+			putc('\\', fp);
+		if ((unsigned char)*s >= 0x20)
+			putc(*s, fp);
+	}
+	putc('"', fp);
+}
+
+/*
+ * cpu_model - The CPU model from /proc/cpuinfo, or "unknown"
+ */
+static const char *cpu_model(void)
+{
+	static char model[MAXLINE] = "";
+	char line[MAXLINE], *p;
+	FILE *fp;
+
+	if (model[0] != '\0')
+		return model;
+	strcpy(model, "unknown");
+	if ((fp = fopen("/proc/cpuinfo", "r")) == NULL)
+		return model;
+	while (fgets(line, sizeof(line), fp) != NULL)
+		if (!strncmp(line, "model name", 10) && (p = strchr(line, ':')) != NULL)
+		{
+			for (p++; *p == ' '; p++)
+				;
+			p[strcspn(p, "\n\"")] = '\0';
+			strcpy(model, p);
+			break;
+		}
+	fclose(fp);
+	return model;
+}
+
+/*
+ * read_file - Read a whole file into a NUL-terminated malloc'd buffer
+ */
+static char *read_file(const char *path)
+{
+	FILE *fp;
+	char *buf;
+	long len;
+
+	if ((fp = fopen(path, "r")) == NULL)
+		results_error("Could not open", path);
+	fseek(fp, 0, SEEK_END);
+	len = ftell(fp);
+	rewind(fp);
+	if (len < 0 || (buf = (char *)malloc(len + 1)) == NULL)
+		results_error("Could not read", path);
+	if (fread(buf, 1, len, fp) != (size_t)len)
+		results_error("Could not read", path);
+	buf[len] = '\0';
+	fclose(fp);
+	return buf;
+}
+
+/*
+ * parse_trace - Read the fields of one trace object (without its braces)
+ */
+static int parse_trace(char *obj, basetrace_t *b)
+{
+	char *p;
+	size_t len;
+
+	if ((p = field(obj, "file")) == NULL || *p != '"')
+		return -1;
+	len = strcspn(p + 1, "\"");
+	if (len >= sizeof(b->file))
+		return -1;
+	memcpy(b->file, p + 1, len);
+	b->file[len] = '\0';
+	if ((p = field(obj, "valid")) == NULL)
+		return -1;
+	b->valid = !strncmp(p, "true", 4);
+	if ((p = field(obj, "util")) == NULL)
+		return -1;
+	b->util = strncmp(p, "null", 4) ? atof(p) : -1;
+	if ((p = field(obj, "ops")) == NULL)
+		return -1;
+	b->ops = atof(p);
+	if ((p = field(obj, "secs")) == NULL)
+		return -1;
+	b->secs = atof(p);
+	b->secs_sd = (p = field(obj, "secs_sd")) ? atof(p) : 0;
+	b->secs_lo = (p = field(obj, "secs_lo")) ? atof(p) : -1;
+	b->secs_hi = (p = field(obj, "secs_hi")) ? atof(p) : -1;
+	b->reps = (p = field(obj, "reps")) ? atoi(p) : 1;
+	return 0;
+}
+
+/*
+ * field - The value of "key" in obj, or NULL if obj has no such key
+ */
+static char *field(char *obj, const char *key)
+{
+	char pat[64];
+	char *p;
+
+	snprintf(pat, sizeof(pat), "\"%s\":", key);
+	if ((p = strstr(obj, pat)) == NULL)
+		return NULL;
+	for (p += strlen(pat); *p == ' '; p++)
+		;
+	return p;
+}
+
+/*
+ * kops - Throughput in thousands of ops per second
+ */
+static double kops(double ops, double secs)
+{
+	return (ops / 1e3) / secs;
+}
+
+/*
+ * fmt_util - util (or tutil) as a results file field in buf, or none if
+ *     it was not measured (< 0, -A libc)
+ */
+static const char *fmt_util(char *buf, double util, const char *none)
+{
+	if (util < 0)
+		return none;
+	sprintf(buf, "%.6f", util);
+	return buf;
+}
+
+/*
+ * results_error - Report a results file problem and terminate
+ */
+static void results_error(char *msg, const char *path)
+{
+	fprintf(stderr, "ERROR: %s results file %s\n", msg, path);
+	exit(1);
+}
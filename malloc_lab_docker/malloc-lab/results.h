@@ -0,0 +1,54 @@
+/*
+ * results.h - Per-trace results of the driver, the performance index,
+ *             and their machine-readable forms (mdriver --json, --csv,
+ *             --compare).
+ */
+#ifndef __RESULTS_H_
+#define __RESULTS_H_
+
+/* Summarizes the important stats for some malloc function on some trace */
+typedef struct
+{
+	/* defined for both libc malloc and student malloc package (mm.c) */
+	double ops;		   /* number of ops (malloc/free/realloc) in the trace */
+	int valid;		   /* was the trace processed correctly by the allocator? */
+	double secs;	   /* number of secs needed to run the trace (median of reps) */
+	double secs_sd;	   /* sample standard deviation of secs over the reps */
+	double secs_lo;	   /* 95% confidence interval of the median */
+	double secs_hi;
+	double secs_null;  /* replay loop time taken off secs (--calibrate), or 0 */
+	int reps;		   /* number of times secs was measured */
+	double valid_secs; /* number of secs the correctness check took */
+
+	/* defined only for the student malloc package */
+	double util; /* space utilization for this trace (always 0 for libc) */
+	double tutil;	   /* peak payload / heap pages actually touched */
+	/* util and tutil are < 0 for backends without a memlib heap (-A libc);
+	   tutil also when the trace was streamed (-S) */
+	double faults;	   /* minor page faults of the util run, on fresh pages */
+	double pages;	   /* heap pages resident after the util run */
+	double run_faults; /* minor page faults per timed run */
+	double run_pages;  /* heap pages resident after the timed runs */
+
+	/* Note: secs and util are only defined if valid is true */
+} stats_t;
+
+/* What the results files record besides the per-trace stats */
+typedef struct
+{
+	const char *timer; /* timing method of fsecs */
+	double mhz;		   /* clock rate fsecs assumed (0 if not cycle based) */
+	int jobs;		   /* worker processes (-j) */
+	double perfindex;  /* performance index of mm, or -1 if there were errors
+						  or the backend has no util to score */
+} runinfo_t;
+
+double perf_index(int n, stats_t *stats, double *util_pts, double *thru_pts);
+void write_json(const char *path, char **tracefiles, int n, stats_t *mm,
+				stats_t *libc, runinfo_t *info);
+void write_csv(const char *path, char **tracefiles, int n, stats_t *mm,
+			   stats_t *libc, runinfo_t *info);
+int compare_results(const char *baseline, char **tracefiles, int n,
+					stats_t *mm, double threshold);
+
+#endif /* __RESULTS_H_ */
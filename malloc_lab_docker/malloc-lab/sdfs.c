@@ -3,7 +3,7 @@
 #include <assert.h>
 #include <unistd.h>
 #include <string.h>
-#include "mm.h"     // mdriver가 호출할 함수들 시그니처 제공 (mm_malloc, mm_free, etc.)
+#include "mm.h"     // mdriver -A에 등록할 mm_ops_t 정의 (sdfs_ops)
 #include "memlib.h" // 가상 Heap을 확장하기 위한 함수 정의 (mem_sbrk, mem_heap_lo 등)
 
 /* ==========================================
@@ -31,8 +31,8 @@
 #define PACK(size, alloc) ((size) | (alloc))
 
 /* 포인터 p가 가리키는 주소의 값을 읽거나 저장 (header/footer 직접 조작용) */
-#define GET(p) (*(unsigned int *)(p))              // 값 읽기 → (((포인터 p가 가리키는 메모리 주소)에서 4바이트 크기)를 읽어옴)
-#define PUT(p, val) (*(unsigned int *)(p) = (val)) // 값 쓰기 → (((포인터 p가 가리키는 메모리 주소)에 4바이트 크기)로 val 값을 저장함)
+#define GET(p) (*(unsigned int *)MM_REF((p), sizeof(unsigned int), 0))              // 값 읽기 → (((포인터 p가 가리키는 메모리 주소)에서 4바이트 크기)를 읽어옴)
+#define PUT(p, val) (*(unsigned int *)MM_REF((p), sizeof(unsigned int), 1) = (val)) // 값 쓰기 → (((포인터 p가 가리키는 메모리 주소)에 4바이트 크기)로 val 값을 저장함)
 
 /* 주소 p에서 블록 크기와 할당 여부 추출 (블록 메타데이터 읽기) */
 #define GET_SIZE(p) (GET(p) & ~0x7) // 하위 3비트를 제외한 크기
@@ -64,7 +64,7 @@ static void *coalesce(void *bp);        // 인접 블록 병합 함수
  * 초기화 함수 / Initialization
  * ========================================== */
 /*
- * mm_init - 초기 힙 생성 / Initialize the heap
+ * sdfs_init - 초기 힙 생성 / Initialize the heap
  * 1. 4워드 공간을 확보하여 기본 힙 구조를 설정한다.
  *    - 패딩 (alignment padding)
  *    - 프롤로그 헤더 (prologue header)
@@ -73,7 +73,7 @@ static void *coalesce(void *bp);        // 인접 블록 병합 함수
  * 2. 프롤로그/에필로그를 설정하여 힙 일관성을 유지한다.
  * 3. 이후 첫 번째 가용 블록을 만들기 위해 CHUNKSIZE만큼 힙을 확장한다.
  */
-int mm_init(void)
+int sdfs_init(void)
 {
     // 4워드 만큼 가상 힙 공간을 확장 요청해 (mem_sbrk(4 * WSIZE))
     // 성공하면, 확장된 메모리의 시작 주소를 heap_listp에 저장하고
@@ -157,7 +157,7 @@ static void *find_fit(size_t asize)
 
     // 2. 못 찾으면 처음부터 last_fitp까지 다시 탐색
     //for (bp = heap_listp; GET_SIZE(HDRP(bp)) > 0 && bp != last_fitp; bp = NEXT_BLKP(bp))
-    for (bp = heap_listp; bp < last_fitp; bp = NEXT_BLKP(bp))
+    for (bp = heap_listp; (char *)bp < (char *)last_fitp; bp = NEXT_BLKP(bp))
     {
         if (!GET_ALLOC(HDRP(bp)) && (asize <= GET_SIZE(HDRP(bp))))
         {
@@ -203,13 +203,13 @@ static void place(void *bp, size_t asize)
  * 메모리 블록 할당 및 해제 / Malloc & Free
  * ========================================== */
 /*
- * mm_malloc - 요청한 size만큼 메모리 블록 할당
+ * sdfs_malloc - 요청한 size만큼 메모리 블록 할당
  * 1. 요청 크기 조정 (정렬 및 최소 블록 크기 충족)
  * 2. find_fit으로 가용 블록 탐색
  * 3. 없으면 extend_heap으로 힙 확장 후 배치
  * 4. 예외 free block 병합 후 place
  */
-void *mm_malloc(size_t size)
+void *sdfs_malloc(size_t size)
 {
     size_t asize;      // 조정된 블록 크기 (payload + header/footer + 정렬)
     size_t extendsize; // fit 실패 시 heap을 얼마나 확장할지
@@ -247,11 +247,11 @@ void *mm_malloc(size_t size)
  * 메모리 블록 해제 / Free Block
  * ========================================== */
 /*
- * mm_free - 블록을 해제하여 가용 상태로 변경
+ * sdfs_free - 블록을 해제하여 가용 상태로 변경
  * 1. header/footer를 free로 설정
  * 2. 주변 가용 블록들과 병합(coalesce)
  */
-void mm_free(void *ptr)
+void sdfs_free(void *ptr)
 {
     void *bp = ptr;
     size_t size = GET_SIZE(HDRP(bp));
@@ -277,7 +277,7 @@ static void *coalesce(void *bp)
 
     if (prev_alloc && next_alloc)
     { // Case 1: 양쪽 모두 할당 - 병합 없음
-        last_fitp = bp;
+        last_fitp = PREV_BLKP(bp); // 다음 find_fit이 bp부터 탐색하도록
         return bp;
     }
     else if (prev_alloc && !next_alloc)
@@ -301,6 +301,7 @@ static void *coalesce(void *bp)
         PUT(FTRP(NEXT_BLKP(bp)), PACK(size, 0)); // 다음 블록 푸터에 새 사이즈 저장
         bp = PREV_BLKP(bp);
     }
+    last_fitp = PREV_BLKP(bp); // 병합된 블록 안을 가리키지 않고, 다음 find_fit이 bp부터 탐색하도록
     return bp;
 }
 
@@ -308,21 +309,21 @@ static void *coalesce(void *bp)
  * 메모리 블록 재할당 / Reallocate Block
  * ========================================== */
 /*
- * mm_realloc - 블록 재할당
+ * sdfs_realloc - 블록 재할당
  * 1. ptr이 NULL이면 malloc(size)로 새로 할당한다.
  * 2. size가 0이면 free(ptr) 후 NULL을 반환한다.
  * 3. 요청 크기가 기존 블록보다 작거나 같으면 in-place로 사용하거나 분할한다.
  * 4. 오른쪽 블록이 가용 상태이고, 합쳐서 충분하면 확장하여 사용하고 필요시 분할한다.
  * 5. 위 방법으로 불가능하면 새 블록을 malloc하고, 기존 데이터를 복사한 후 free한다.
  */
-void *mm_realloc(void *ptr, size_t size)
+void *sdfs_realloc(void *ptr, size_t size)
 {
     if (ptr == NULL)
-        return mm_malloc(size);
+        return sdfs_malloc(size);
 
     if (size == 0)
     {
-        mm_free(ptr);
+        sdfs_free(ptr);
         return NULL;
     }
 
@@ -352,12 +353,13 @@ void *mm_realloc(void *ptr, size_t size)
         PUT(HDRP(ptr), PACK(total, 1));                            // 새로운 header 설정
         PUT(FTRP(ptr), PACK(total, 1));                            // 새로운 footer 설정
         place(ptr, new_asize);                                     // 오른쪽 확장 후 split
+        last_fitp = PREV_BLKP(ptr);                                // 흡수된 블록을 가리키지 않도록
         return ptr;
     }
 
     // [Case 3] 위 방법으로도 안되면
     // => 새 블록을 malloc해서 데이터 복사 후 기존 블록 free
-    void *new_ptr = mm_malloc(size);
+    void *new_ptr = sdfs_malloc(size);
     if (new_ptr == NULL)
         return NULL; // 기존 ptr은 살아 있음 free하지 않음)
 
@@ -365,6 +367,15 @@ void *mm_realloc(void *ptr, size_t size)
     size_t copy = old_payload < size ? old_payload : size;
     memmove(new_ptr, ptr, copy); // 새 블록에 데이터 복사 (memmove: 겹칠 수도 있으니 안전 복사)
 
-    mm_free(ptr);   // 기존 블록 해제
+    sdfs_free(ptr);   // 기존 블록 해제
     return new_ptr; // 새 블록 주소 반환
-}
\ No newline at end of file
+}
+
+/* ==========================================
+ * mdriver 등록 / Registration (mdriver -A sdfs)
+ * ========================================== */
+/* last_fitp가 힙 밖의 전역 변수라서 힙 checkpoint만으로는 상태가 복원되지 않음 (INHEAP 아님) */
+const mm_ops_t sdfs_ops = {
+    "sdfs", sdfs_init, sdfs_malloc, sdfs_free, sdfs_realloc,
+    NULL, NULL, NULL,
+    MM_OPS_MEMLIB};
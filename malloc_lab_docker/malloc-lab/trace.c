@@ -0,0 +1,367 @@
+/*
+ * trace.c - Loads malloc traces into memory and writes them back out.
+ *
+ * Text .rep files are parsed with fscanf as before. Binary files (see
+ * trace.h) are recognized by their magic number: a TRACE_FIXED file is
+ * mmap'd and its op array is used in place, a TRACE_VARINT file is
+ * mmap'd and decoded into a malloc'd op array.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "trace.h"
+
+#define MAXLINE 1024 /* max string size */
+
+static void trace_error(char *msg, char *path);
+static trace_t *new_trace(void);
+static void alloc_blocks(trace_t *trace, char *path);
+static int read_text_trace(trace_t *trace, char *path);
+static int read_bin_trace(trace_t *trace, char *path);
+static const unsigned char *get_varint(const unsigned char *p,
+									   const unsigned char *end, uint64_t *v);
+static void put_varint(FILE *fp, uint64_t v);
+
+/*
+ * read_trace - read a trace file and store it in memory
+ */
+trace_t *read_trace(char *tracedir, char *filename)
+{
+	trace_t *trace;
+	char path[MAXLINE];
+
+	if (filename[0] == '/') /* absolute paths ignore the trace directory */
+		path[0] = '\0';
+	else
+		strcpy(path, tracedir);
+	strcat(path, filename);
+
+	trace = new_trace();
+	if (!read_bin_trace(trace, path))
+		read_text_trace(trace, path);
+
+	return trace;
+}
+
+/*
+ * free_trace - Free the trace record and the arrays it points to,
+ *              all of which were set up in read_trace().
+ */
+void free_trace(trace_t *trace)
+{
+	if (trace->map != NULL)
+		munmap(trace->map, trace->map_len); /* ops live in the mapping */
+	else
+		free(trace->ops);
+	free(trace->blocks);
+	free(trace->block_sizes);
+	free(trace); /* and the trace record itself... */
+}
+
+/*
+ * write_trace - Store a trace in the binary format with the given
+ *     encoding. Returns 0 on success, -1 on error (with errno set).
+ */
+int write_trace(trace_t *trace, char *path, int encoding)
+{
+	FILE *fp;
+	trace_hdr_t hdr;
+	traceop_t *op;
+	uint64_t prev = 0, z;
+	int64_t delta;
+	long i;
+
+	if ((fp = fopen(path, "w+")) == NULL)
+		return -1;
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, TRACE_MAGIC, sizeof(hdr.magic));
+	hdr.version = TRACE_VERSION;
+	hdr.endian = TRACE_ENDIAN;
+	hdr.encoding = encoding;
+	hdr.sugg_heapsize = trace->sugg_heapsize;
+	hdr.num_ids = trace->num_ids;
+	hdr.num_ops = trace->num_ops;
+	hdr.weight = trace->weight;
+	fwrite(&hdr, sizeof(hdr), 1, fp); /* data_len is patched in below */
+
+	if (encoding == TRACE_FIXED)
+	{
+		fwrite(trace->ops, sizeof(traceop_t), trace->num_ops, fp);
+	}
+	else
+	{
+		for (i = 0; i < trace->num_ops; i++)
+		{
+			op = &trace->ops[i];
+			delta = (int64_t)(op->index - prev);
+			z = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+			put_varint(fp, (z << 2) | op->type);
+			if (op->type != FREE)
+				put_varint(fp, op->size);
+			prev = op->index;
+		}
+	}
+
+	hdr.data_len = ftell(fp) - sizeof(hdr);
+	rewind(fp);
+	fwrite(&hdr, sizeof(hdr), 1, fp);
+
+	if (ferror(fp))
+	{
+		fclose(fp);
+		return -1;
+	}
+	return fclose(fp);
+}
+
+/*
+ * new_trace - Allocate an empty trace record
+ */
+static trace_t *new_trace(void)
+{
+	trace_t *trace;
+
+	if ((trace = (trace_t *)calloc(1, sizeof(trace_t))) == NULL)
+		trace_error("malloc failed in read_trace", NULL);
+	return trace;
+}
+
+/*
+ * alloc_blocks - Allocate the per-id arrays once num_ids is known
+ */
+static void alloc_blocks(trace_t *trace, char *path)
+{
+	/* We'll keep an array of pointers to the allocated blocks here... */
+	if ((trace->blocks =
+			 (char **)malloc(trace->num_ids * sizeof(char *))) == NULL)
+		trace_error("malloc of block array failed for", path);
+
+	/* ... along with the corresponding byte sizes of each block */
+	if ((trace->block_sizes =
+			 (size_t *)malloc(trace->num_ids * sizeof(size_t))) == NULL)
+		trace_error("malloc of block size array failed for", path);
+}
+
+/*
+ * read_text_trace - Parse a text .rep trace
+ */
+static int read_text_trace(trace_t *trace, char *path)
+{
+	FILE *tracefile;
+	char type[MAXLINE];
+	unsigned long index, size;
+	unsigned long max_index = 0;
+	long op_index;
+	char msg[MAXLINE];
+
+	if ((tracefile = fopen(path, "r")) == NULL)
+		trace_error("Could not open trace file", path);
+	fscanf(tracefile, "%ld", &(trace->sugg_heapsize)); /* not used */
+	fscanf(tracefile, "%ld", &(trace->num_ids));
+	fscanf(tracefile, "%ld", &(trace->num_ops));
+	fscanf(tracefile, "%ld", &(trace->weight)); /* not used */
+
+	/* We'll store each request line in the trace in this array */
+	if ((trace->ops =
+			 (traceop_t *)calloc(trace->num_ops, sizeof(traceop_t))) == NULL)
+		trace_error("malloc of op array failed for", path);
+	alloc_blocks(trace, path);
+
+	/* read every request line in the trace file */
+	index = 0;
+	op_index = 0;
+	while (fscanf(tracefile, "%s", type) != EOF)
+	{
+		if (op_index >= trace->num_ops)
+			trace_error("More requests than the header says in", path);
+		switch (type[0])
+		{
+		case 'a':
+			fscanf(tracefile, "%lu %lu", &index, &size);
+			trace->ops[op_index].type = ALLOC;
+			trace->ops[op_index].index = index;
+			trace->ops[op_index].size = size;
+			max_index = (index > max_index) ? index : max_index;
+			break;
+		case 'r':
+			fscanf(tracefile, "%lu %lu", &index, &size);
+			trace->ops[op_index].type = REALLOC;
+			trace->ops[op_index].index = index;
+			trace->ops[op_index].size = size;
+			max_index = (index > max_index) ? index : max_index;
+			break;
+		case 'f':
+			fscanf(tracefile, "%lu", &index);
+			trace->ops[op_index].type = FREE;
+			trace->ops[op_index].index = index;
+			break;
+		default:
+			printf("Bogus type character (%c) in tracefile %s\n",
+				   type[0], path);
+			exit(1);
+		}
+		if (type[0] != 'f' && size > TRACE_MAX_SIZE)
+		{
+			snprintf(msg, sizeof(msg), "Size %lu of request %ld too large in",
+					 size, op_index);
+			trace_error(msg, path);
+		}
+		op_index++;
+	}
+	fclose(tracefile);
+	if (max_index != trace->num_ids - 1 || op_index != trace->num_ops)
+		trace_error("Header does not match the requests in", path);
+
+	return 1;
+}
+
+/*
+ * read_bin_trace - Load a binary trace. Returns 0 if the file is not
+ *     a binary trace (no magic number), 1 once it has been loaded.
+ */
+static int read_bin_trace(trace_t *trace, char *path)
+{
+	int fd;
+	struct stat st;
+	trace_hdr_t *hdr;
+	char *map;
+	const unsigned char *p, *end;
+	uint64_t v, size, index = 0;
+	long i;
+
+	if ((fd = open(path, O_RDONLY)) < 0)
+		trace_error("Could not open trace file", path);
+	if (fstat(fd, &st) < 0)
+		trace_error("Could not stat trace file", path);
+	if (st.st_size < (off_t)sizeof(trace_hdr_t))
+	{
+		close(fd);
+		return 0;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		trace_error("Could not map trace file", path);
+
+	hdr = (trace_hdr_t *)map;
+	if (memcmp(hdr->magic, TRACE_MAGIC, sizeof(hdr->magic)) != 0)
+	{
+		munmap(map, st.st_size);
+		return 0;
+	}
+	if (hdr->version != TRACE_VERSION || hdr->endian != TRACE_ENDIAN)
+		trace_error("Unsupported version or byte order in", path);
+	if (hdr->data_len > st.st_size - sizeof(trace_hdr_t))
+		trace_error("Truncated trace file", path);
+
+	trace->sugg_heapsize = hdr->sugg_heapsize;
+	trace->num_ids = hdr->num_ids;
+	trace->num_ops = hdr->num_ops;
+	trace->weight = hdr->weight;
+	alloc_blocks(trace, path);
+
+	if (hdr->encoding == TRACE_FIXED)
+	{
+		/* Zero-parse: the records are used straight from the mapping,
+		   after one pass that checks them as the varint reader does */
+		if (hdr->num_ops > SIZE_MAX / sizeof(traceop_t) ||
+			hdr->data_len != hdr->num_ops * sizeof(traceop_t))
+			trace_error("Bad op array length in", path);
+		madvise(map, st.st_size, MADV_SEQUENTIAL);
+		trace->ops = (traceop_t *)(map + sizeof(trace_hdr_t));
+		for (i = 0; i < trace->num_ops; i++)
+			if (trace->ops[i].type > REALLOC ||
+				trace->ops[i].index >= (uint64_t)trace->num_ids ||
+				(trace->ops[i].type != FREE &&
+				 trace->ops[i].size > TRACE_MAX_SIZE))
+				trace_error("Corrupt op data in", path);
+		trace->map = map;
+		trace->map_len = st.st_size;
+		return 1;
+	}
+	if (hdr->encoding != TRACE_VARINT)
+		trace_error("Unknown encoding in", path);
+
+	if ((trace->ops =
+			 (traceop_t *)calloc(trace->num_ops, sizeof(traceop_t))) == NULL)
+		trace_error("malloc of op array failed for", path);
+
+	p = (const unsigned char *)map + sizeof(trace_hdr_t);
+	end = p + hdr->data_len;
+	for (i = 0; i < trace->num_ops; i++)
+	{
+		p = get_varint(p, end, &v);
+		index += (uint64_t)((int64_t)(v >> 3) ^ -(int64_t)((v >> 2) & 1));
+		trace->ops[i].type = v & 3;
+		trace->ops[i].index = index;
+		if ((v & 3) != FREE)
+		{
+			p = get_varint(p, end, &size);
+			trace->ops[i].size = size;
+		}
+		if (p == NULL || (v & 3) > REALLOC || index >= trace->num_ids ||
+			trace->ops[i].size > TRACE_MAX_SIZE)
+			trace_error("Corrupt op data in", path);
+	}
+	munmap(map, st.st_size);
+
+	return 1;
+}
+
+/*
+ * get_varint - Decode one LEB128 varint at p into *v. Returns the
+ *     position after it, or NULL if the data runs past end.
+ */
+static const unsigned char *get_varint(const unsigned char *p,
+									   const unsigned char *end, uint64_t *v)
+{
+	uint64_t x = 0;
+	int shift = 0;
+
+	*v = 0;
+	if (p == NULL)
+		return NULL;
+	while (p < end && shift < 64)
+	{
+		x |= (uint64_t)(*p & 0x7f) << shift;
+		if ((*p++ & 0x80) == 0)
+		{
+			*v = x;
+			return p;
+		}
+		shift += 7;
+	}
+	return NULL;
+}
+
+/*
+ * put_varint - Append v to fp as a LEB128 varint
+ */
+static void put_varint(FILE *fp, uint64_t v)
+{
+	while (v >= 0x80)
+	{
+		putc((v & 0x7f) | 0x80, fp);
+		v >>= 7;
+	}
+	putc(v, fp);
+}
+
+/*
+ * trace_error - Report a trace loading error and terminate
+ */
+static void trace_error(char *msg, char *path)
+{
+	if (path != NULL)
+		fprintf(stderr, "Trace error: %s %s", msg, path);
+	else
+		fprintf(stderr, "Trace error: %s", msg);
+	fprintf(stderr, "\n");
+	exit(1);
+}
@@ -0,0 +1,88 @@
+/*
+ * trace.h - In-memory representation of a malloc trace and the
+ *           routines that load and store it.
+ *
+ * A trace is either a text .rep file (four header lines followed by
+ * one "a id size", "r id size" or "f id" request per line) or a binary
+ * file that starts with a trace_hdr_t. Binary traces come in two
+ * encodings:
+ *
+ *   TRACE_FIXED   the ops are stored as an array of traceop_t records
+ *                 exactly as they are laid out in memory, so loading the
+ *                 trace is a single mmap with no parsing at all.
+ *
+ *   TRACE_VARINT  each op is a varint holding (zigzag(id - previous id)
+ *                 << 2 | type), followed by a varint size for allocs and
+ *                 reallocs. Roughly 3 bytes per op instead of 24, decoded
+ *                 into a traceop_t array on load.
+ */
+#ifndef __TRACE_H_
+#define __TRACE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <limits.h>
+
+/* Request types */
+enum
+{
+	ALLOC,
+	FREE,
+	REALLOC
+};
+
+/* Characterizes a single trace operation (allocator request) */
+typedef struct
+{
+	uint32_t type;	/* type of request */
+	uint32_t pad;	/* keeps the record 8-byte aligned on disk */
+	uint64_t index; /* index for free() to use later */
+	uint64_t size;	/* byte size of alloc/realloc request */
+} traceop_t;
+
+/* Largest request size a trace may hold: the validity checks and
+   mem_sbrk take int sizes */
+#define TRACE_MAX_SIZE INT_MAX
+
+/* Holds the information for one trace file*/
+typedef struct
+{
+	long sugg_heapsize;	 /* suggested heap size (unused) */
+	long num_ids;		 /* number of alloc/realloc ids */
+	long num_ops;		 /* number of distinct requests */
+	long weight;		 /* weight for this trace (unused) */
+	int peak_bytes;		 /* peak live payload bytes (set by eval_mm_util) */
+	traceop_t *ops;		 /* array of requests */
+	char **blocks;		 /* array of ptrs returned by malloc/realloc... */
+	size_t *block_sizes; /* ... and a corresponding array of payload sizes */
+	void *map;			 /* mapping of a TRACE_FIXED file (NULL otherwise) */
+	size_t map_len;		 /* length of that mapping */
+} trace_t;
+
+/* Header at the start of a binary trace file */
+#define TRACE_MAGIC "MMTRACE"	/* 8 bytes including the terminating nul */
+#define TRACE_VERSION 1
+#define TRACE_ENDIAN 0x01020304 /* written in host byte order */
+
+#define TRACE_FIXED 0  /* ops stored as raw traceop_t records */
+#define TRACE_VARINT 1 /* ops stored as delta/varint pairs */
+
+typedef struct
+{
+	char magic[8];			/* TRACE_MAGIC */
+	uint32_t version;		/* TRACE_VERSION */
+	uint32_t endian;		/* TRACE_ENDIAN as seen by the writer */
+	uint32_t encoding;		/* TRACE_FIXED or TRACE_VARINT */
+	uint32_t reserved;
+	uint64_t sugg_heapsize; /* the four .rep header fields */
+	uint64_t num_ids;
+	uint64_t num_ops;
+	uint64_t weight;
+	uint64_t data_len; /* bytes of op data following the header */
+} trace_hdr_t;
+
+trace_t *read_trace(char *tracedir, char *filename);
+void free_trace(trace_t *trace);
+int write_trace(trace_t *trace, char *path, int encoding);
+
+#endif /* __TRACE_H_ */
@@ -0,0 +1,612 @@
+/*
+ * tracegen.c - Generates synthetic malloc traces with realistic request
+ *     sizes and object lifetimes, as a fast and more general
+ *     replacement for the traces/gen_*.pl scripts.
+ *
+ *     tracegen [-bz] [-n allocs] [-s seed] [-d sizes] [-l lifetimes]
+ *              [-r frac[:factor]] [-p pattern] <out>
+ *
+ *     Sizes (-d) are drawn from
+ *         uniform:MIN:MAX        uniform in [MIN, MAX]
+ *         power:MIN:MAX:ALPHA    power law, density ~ size^-ALPHA
+ *         bimodal:S1:S2:P        S1 with probability P, S2 otherwise
+ *         hist:FILE              measured histogram, "size weight" lines
+ *                                (tracestat -H writes one)
+ *
+ *     Lifetimes (-l), counted in allocations:
+ *         exp:MEAN               exponential with mean MEAN
+ *         lifo[:Q]               stack: before each alloc, pop the top
+ *                                block while a coin with P(heads) = Q says so
+ *         fifo:DEPTH             queue: the oldest of DEPTH live blocks goes
+ *         phase:LEN[:KEEP]       all blocks of a phase of LEN allocs die
+ *                                together at its end, except a fraction
+ *                                KEEP that lives to the end of the trace
+ *
+ *     With -r a fraction FRAC of the steps also reallocs a random live
+ *     block to FACTOR (default 1.5) times its size.
+ *
+ *     -p replaces the size and lifetime models with an adversarial
+ *     fragmentation pattern:
+ *         holes:SIZE             free every other block of a run of SIZE
+ *                                blocks, then ask for blocks that are
+ *                                too big for the holes
+ *         pin:SIZE               alloc a large block, pin it with a small
+ *                                long-lived one and free it, each large
+ *                                block a little larger than the last hole
+ *
+ *     The trace is balanced (every block is freed) and is written as a
+ *     text .rep file, or with -b/-z as a fixed/varint binary trace. All
+ *     randomness comes from one splitmix64 generator seeded with -s, so
+ *     a command line always produces the same trace.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include "trace.h"
+
+#define MAX_SIZE ((uint64_t)1 << 30) /* largest request (mem_sbrk takes an int) */
+#define HOLES_RUN 1024               /* blocks per run of the holes pattern */
+#define PIN_STEPS 256                /* pin pattern restarts its growth after this */
+
+/* Size distributions */
+enum
+{
+    SD_UNIFORM,
+    SD_POWER,
+    SD_BIMODAL,
+    SD_HIST
+};
+
+/* Lifetime models and fragmentation patterns */
+enum
+{
+    LT_EXP,
+    LT_LIFO,
+    LT_FIFO,
+    LT_PHASE,
+    PAT_HOLES,
+    PAT_PIN
+};
+
+/* A live block of the trace being generated */
+typedef struct
+{
+    uint64_t id;
+    uint64_t size;
+    uint64_t deadline; /* LT_EXP: step at which the block is freed */
+} obj_t;
+
+/* The trace being built */
+static traceop_t *ops = NULL;
+static long num_ops = 0, max_ops = 0;
+static uint64_t num_ids = 0;
+static uint64_t live_bytes = 0, peak_bytes = 0;
+
+/* Size distribution */
+static int sd_kind = SD_POWER;
+static double sd_a = 16, sd_b = 4096, sd_c = 1.5;
+static uint64_t *hist_sizes = NULL;
+static double *hist_cum = NULL; /* cumulative weights */
+static long hist_n = 0;
+
+/* Lifetime model */
+static int lt_kind = LT_EXP;
+static double lt_a = 1000, lt_b = 0;
+
+/* Live blocks: objs[head..num_objs) (a heap on deadline for LT_EXP) */
+static obj_t *objs = NULL;
+static long head = 0, num_objs = 0, max_objs = 0;
+static obj_t *kept = NULL; /* phase survivors, freed at the end */
+static long num_kept = 0, max_kept = 0;
+
+static uint64_t rng_state;
+
+static void gen_lifetimes(long nallocs, double re_frac, double re_factor);
+static void gen_holes(long nallocs, uint64_t size);
+static void gen_pin(long nallocs, uint64_t size);
+static void emit(int type, uint64_t id, uint64_t size, uint64_t oldsize);
+static uint64_t draw_size(void);
+static void push(obj_t *o);
+static obj_t pop_min(void);
+static void keep(obj_t *o);
+static void load_hist(char *path);
+static uint64_t rnd(void);
+static double urand(void);
+static void *grow(void *p, long *max, size_t elsize);
+static int write_text(char *path);
+static void usage(void);
+static void gen_error(char *msg, char *arg);
+
+int main(int argc, char **argv)
+{
+    int c, encoding = -1;
+    long nallocs = 100000;
+    uint64_t seed = 1;
+    double re_frac = 0, re_factor = 1.5, pat_size = 0;
+    int pat = -1;
+    trace_t trace;
+
+    while ((c = getopt(argc, argv, "bzn:s:d:l:r:p:h")) != EOF) {
+	switch (c) {
+	case 'b':
+	    encoding = TRACE_FIXED;
+	    break;
+	case 'z':
+	    encoding = TRACE_VARINT;
+	    break;
+	case 'n':
+	    if ((nallocs = atol(optarg)) <= 0)
+		gen_error("bad number of allocations", optarg);
+	    break;
+	case 's':
+	    seed = strtoull(optarg, NULL, 0);
+	    break;
+	case 'd':
+	    if (sscanf(optarg, "uniform:%lf:%lf", &sd_a, &sd_b) == 2)
+		sd_kind = SD_UNIFORM;
+	    else if (sscanf(optarg, "power:%lf:%lf:%lf", &sd_a, &sd_b, &sd_c) == 3)
+		sd_kind = SD_POWER;
+	    else if (sscanf(optarg, "bimodal:%lf:%lf:%lf", &sd_a, &sd_b, &sd_c) == 3)
+		sd_kind = SD_BIMODAL;
+	    else if (strncmp(optarg, "hist:", 5) == 0) {
+		sd_kind = SD_HIST;
+		load_hist(optarg + 5);
+	    }
+	    else
+		gen_error("bad size distribution", optarg);
+	    if (sd_kind != SD_HIST && (sd_a < 1 || sd_b < 1 ||
+				       (sd_kind != SD_BIMODAL && sd_b < sd_a)))
+		gen_error("bad size range", optarg);
+	    break;
+	case 'l':
+	    lt_b = 0;
+	    if (sscanf(optarg, "exp:%lf", &lt_a) == 1 && lt_a > 0)
+		lt_kind = LT_EXP;
+	    else if (strcmp(optarg, "lifo") == 0) {
+		lt_kind = LT_LIFO;
+		lt_a = 0.5;
+	    }
+	    else if (sscanf(optarg, "lifo:%lf", &lt_a) == 1 && lt_a >= 0 && lt_a < 1)
+		lt_kind = LT_LIFO;
+	    else if (sscanf(optarg, "fifo:%lf", &lt_a) == 1 && lt_a >= 1)
+		lt_kind = LT_FIFO;
+	    else if (sscanf(optarg, "phase:%lf:%lf", &lt_a, &lt_b) >= 1 && lt_a >= 1)
+		lt_kind = LT_PHASE;
+	    else
+		gen_error("bad lifetime model", optarg);
+	    break;
+	case 'r':
+	    if (sscanf(optarg, "%lf:%lf", &re_frac, &re_factor) < 1 ||
+		re_frac < 0 || re_frac > 1 || re_factor <= 0)
+		gen_error("bad realloc fraction", optarg);
+	    break;
+	case 'p':
+	    if (sscanf(optarg, "holes:%lf", &pat_size) == 1)
+		pat = PAT_HOLES;
+	    else if (sscanf(optarg, "pin:%lf", &pat_size) == 1)
+		pat = PAT_PIN;
+	    else
+		gen_error("bad pattern", optarg);
+	    if (pat_size < 1 || pat_size > MAX_SIZE / 4)
+		gen_error("bad pattern size", optarg);
+	    break;
+	case 'h':
+	    usage();
+	    exit(0);
+	default:
+	    usage();
+	    exit(1);
+	}
+    }
+    if (argc - optind != 1) {
+	usage();
+	exit(1);
+    }
+
+    rng_state = seed;
+    if (pat == PAT_HOLES)
+	gen_holes(nallocs, (uint64_t)pat_size);
+    else if (pat == PAT_PIN)
+	gen_pin(nallocs, (uint64_t)pat_size);
+    else
+	gen_lifetimes(nallocs, re_frac, re_factor);
+
+    /* Write the trace */
+    memset(&trace, 0, sizeof(trace));
+    trace.sugg_heapsize = peak_bytes;
+    trace.num_ids = num_ids;
+    trace.num_ops = num_ops;
+    trace.weight = 1;
+    trace.ops = ops;
+    if ((encoding < 0 ? write_text(argv[optind]) :
+	 write_trace(&trace, argv[optind], encoding)) < 0)
+	gen_error(strerror(errno), argv[optind]);
+    printf("%s: %ld ops, %lu ids, peak %lu live bytes (seed %lu)\n",
+	   argv[optind], num_ops, (unsigned long)num_ids,
+	   (unsigned long)peak_bytes, (unsigned long)seed);
+
+    free(ops);
+    free(objs);
+    free(kept);
+    free(hist_sizes);
+    free(hist_cum);
+    exit(0);
+}
+
+/*
+ * gen_lifetimes - One step per allocation: free the blocks whose time
+ *     has come, maybe realloc a live block, then allocate. Whatever is
+ *     live at the end is freed last.
+ */
+static void gen_lifetimes(long nallocs, double re_frac, double re_factor)
+{
+    long t, i, j;
+    obj_t o, *r, tmp;
+    uint64_t size;
+
+    for (t = 0; t < nallocs; t++) {
+	switch (lt_kind) {
+	case LT_EXP:
+	    while (num_objs > 0 && objs[0].deadline <= (uint64_t)t) {
+		o = pop_min();
+		emit(FREE, o.id, 0, o.size);
+	    }
+	    break;
+	case LT_LIFO:
+	    while (num_objs > 0 && urand() < lt_a) {
+		num_objs--;
+		emit(FREE, objs[num_objs].id, 0, objs[num_objs].size);
+	    }
+	    break;
+	case LT_PHASE:
+	    if (t > 0 && t % (long)lt_a == 0) {
+		for (i = num_objs - 1; i > 0; i--) { /* die in random order */
+		    j = rnd() % (i + 1);
+		    tmp = objs[i];
+		    objs[i] = objs[j];
+		    objs[j] = tmp;
+		}
+		for (i = 0; i < num_objs; i++)
+		    emit(FREE, objs[i].id, 0, objs[i].size);
+		num_objs = 0;
+	    }
+	    break;
+	}
+
+	if (re_frac > 0 && num_objs > head && urand() < re_frac) {
+	    r = &objs[head + rnd() % (num_objs - head)];
+	    size = (uint64_t)(r->size * re_factor);
+	    if (size == r->size)
+		size++;
+	    size = (size > MAX_SIZE) ? MAX_SIZE : (size ? size : 1);
+	    emit(REALLOC, r->id, size, r->size);
+	    r->size = size;
+	}
+
+	o.id = num_ids;
+	o.size = draw_size();
+	o.deadline = 0;
+	emit(ALLOC, o.id, o.size, 0);
+	switch (lt_kind) {
+	case LT_EXP:
+	    o.deadline = t + 1 + (uint64_t)(-lt_a * log(1 - urand()));
+	    push(&o);
+	    break;
+	case LT_FIFO:
+	    push(&o);
+	    if (num_objs - head > (long)lt_a) {
+		emit(FREE, objs[head].id, 0, objs[head].size);
+		head++;
+	    }
+	    break;
+	case LT_PHASE:
+	    if (urand() < lt_b)
+		keep(&o);
+	    else
+		push(&o);
+	    break;
+	default:
+	    push(&o);
+	}
+    }
+
+    /* Free what is left */
+    if (lt_kind == LT_EXP)
+	while (num_objs > 0) {
+	    o = pop_min();
+	    emit(FREE, o.id, 0, o.size);
+	}
+    for (i = num_objs - 1; i >= head; i--)
+	emit(FREE, objs[i].id, 0, objs[i].size);
+    for (i = 0; i < num_kept; i++)
+	emit(FREE, kept[i].id, 0, kept[i].size);
+}
+
+/*
+ * gen_holes - Runs of HOLES_RUN blocks of the given size. Every other
+ *     block of a run is freed, leaving holes that the run's follow-up
+ *     blocks of twice the size do not fit. The rest of the run is freed
+ *     after them, the big blocks once the next run has made its holes.
+ */
+static void gen_holes(long nallocs, uint64_t size)
+{
+    uint64_t first, big = 0, nbig = 0, i;
+    long n = 0;
+
+    while (n < nallocs) {
+	first = num_ids;
+	for (i = 0; i < HOLES_RUN; i++, n++)
+	    emit(ALLOC, num_ids, size, 0);
+	for (i = 0; i < HOLES_RUN; i += 2)
+	    emit(FREE, first + i, 0, size);
+	for (i = 0; i < nbig; i++)
+	    emit(FREE, big + i, 0, 2 * size + 1);
+	big = num_ids;
+	nbig = HOLES_RUN / 2;
+	for (i = 0; i < nbig; i++, n++)
+	    emit(ALLOC, num_ids, 2 * size + 1, 0);
+	for (i = 1; i < HOLES_RUN; i += 2)
+	    emit(FREE, first + i, 0, size);
+    }
+    for (i = 0; i < nbig; i++)
+	emit(FREE, big + i, 0, 2 * size + 1);
+}
+
+/*
+ * gen_pin - Each step allocates a large block and a 16-byte pin after
+ *     it, then frees the large block. The next large block is 16 bytes
+ *     bigger, so it never fits the hole in front of the pin. The pins
+ *     live to the end; the growth restarts every PIN_STEPS steps.
+ */
+static void gen_pin(long nallocs, uint64_t size)
+{
+    uint64_t first = num_ids, big, i;
+    long n;
+
+    for (n = 0; n < nallocs; n += 2) {
+	big = size + 16 * ((n / 2) % PIN_STEPS);
+	emit(ALLOC, num_ids, big, 0);
+	emit(ALLOC, num_ids, 16, 0);
+	emit(FREE, num_ids - 2, 0, big);
+    }
+    for (i = first + 1; i < num_ids; i += 2)
+	emit(FREE, i, 0, 16);
+}
+
+/*
+ * emit - Append an op to the trace and track the live bytes. ALLOC
+ *     takes a new id; oldsize is the size of the block a FREE or
+ *     REALLOC is applied to.
+ */
+static void emit(int type, uint64_t id, uint64_t size, uint64_t oldsize)
+{
+    traceop_t *op;
+
+    if (num_ops == max_ops)
+	ops = grow(ops, &max_ops, sizeof(traceop_t));
+    op = &ops[num_ops++];
+    op->type = type;
+    op->pad = 0;
+    op->index = id;
+    op->size = size;
+    if (type == ALLOC)
+	num_ids++;
+    live_bytes += size - oldsize;
+    peak_bytes = (live_bytes > peak_bytes) ? live_bytes : peak_bytes;
+}
+
+/*
+ * draw_size - A request size from the size distribution
+ */
+static uint64_t draw_size(void)
+{
+    double u = urand(), e, lo, hi, s;
+    long l, h, m;
+
+    switch (sd_kind) {
+    case SD_UNIFORM:
+	s = sd_a + floor(u * (sd_b - sd_a + 1));
+	break;
+    case SD_POWER: /* inverse of the CDF of a truncated power law */
+	if (fabs(sd_c - 1) < 1e-9)
+	    s = sd_a * pow(sd_b / sd_a, u);
+	else {
+	    e = 1 - sd_c;
+	    lo = pow(sd_a, e);
+	    hi = pow(sd_b, e);
+	    s = pow(lo + u * (hi - lo), 1 / e);
+	}
+	break;
+    case SD_BIMODAL:
+	s = (u < sd_c) ? sd_a : sd_b;
+	break;
+    default: /* SD_HIST: first bucket whose cumulative weight exceeds u */
+	u *= hist_cum[hist_n - 1];
+	for (l = 0, h = hist_n - 1; l < h; ) {
+	    m = (l + h) / 2;
+	    if (hist_cum[m] > u)
+		h = m;
+	    else
+		l = m + 1;
+	}
+	s = hist_sizes[l];
+    }
+    if (s < 1)
+	return 1;
+    return (s > MAX_SIZE) ? MAX_SIZE : (uint64_t)s;
+}
+
+/*
+ * push, pop_min - Add a live block; remove the one with the earliest
+ *     deadline. For LT_EXP the live blocks are a binary min-heap on
+ *     deadline, for the other models push simply appends.
+ */
+static void push(obj_t *o)
+{
+    long i, p;
+
+    if (num_objs == max_objs) {
+	if (head > 0) { /* reclaim the dead front of a queue */
+	    memmove(objs, objs + head, (num_objs - head) * sizeof(obj_t));
+	    num_objs -= head;
+	    head = 0;
+	}
+	if (num_objs == max_objs)
+	    objs = grow(objs, &max_objs, sizeof(obj_t));
+    }
+    i = num_objs++;
+    if (lt_kind == LT_EXP)
+	for (; i > 0 && objs[p = (i - 1) / 2].deadline > o->deadline; i = p)
+	    objs[i] = objs[p];
+    objs[i] = *o;
+}
+
+static obj_t pop_min(void)
+{
+    obj_t top = objs[0], last = objs[--num_objs];
+    long i = 0, c;
+
+    while ((c = 2 * i + 1) < num_objs) {
+	if (c + 1 < num_objs && objs[c + 1].deadline < objs[c].deadline)
+	    c++;
+	if (objs[c].deadline >= last.deadline)
+	    break;
+	objs[i] = objs[c];
+	i = c;
+    }
+    objs[i] = last;
+    return top;
+}
+
+static void keep(obj_t *o)
+{
+    if (num_kept == max_kept)
+	kept = grow(kept, &max_kept, sizeof(obj_t));
+    kept[num_kept++] = *o;
+}
+
+/*
+ * load_hist - Read a "size weight" histogram; '#' starts a comment
+ */
+static void load_hist(char *path)
+{
+    FILE *fp;
+    char line[256];
+    double size, weight, total = 0;
+    long max = 0;
+
+    if ((fp = fopen(path, "r")) == NULL)
+	gen_error(strerror(errno), path);
+    while (fgets(line, sizeof(line), fp) != NULL) {
+	if (line[0] == '#' || sscanf(line, "%lf %lf", &size, &weight) != 2)
+	    continue;
+	if (size < 1 || weight < 0)
+	    gen_error("bad histogram line", line);
+	if (weight == 0)
+	    continue;
+	if (hist_n == max) {
+	    hist_sizes = grow(hist_sizes, &max, sizeof(uint64_t));
+	    if ((hist_cum = realloc(hist_cum, max * sizeof(double))) == NULL)
+		gen_error("out of memory", "");
+	}
+	total += weight;
+	hist_sizes[hist_n] = (uint64_t)size;
+	hist_cum[hist_n++] = total;
+    }
+    fclose(fp);
+    if (hist_n == 0)
+	gen_error("empty histogram", path);
+}
+
+/*
+ * rnd, urand - splitmix64, as a 64-bit integer and in [0, 1)
+ */
+static uint64_t rnd(void)
+{
+    uint64_t z = (rng_state += 0x9e3779b97f4a7c15ULL);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static double urand(void)
+{
+    return (rnd() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*
+ * grow - Double an array of *max elements (at least 1024)
+ */
+static void *grow(void *p, long *max, size_t elsize)
+{
+    *max = *max ? 2 * *max : 1024;
+    if ((p = realloc(p, *max * elsize)) == NULL)
+	gen_error("out of memory", "");
+    return p;
+}
+
+/*
+ * write_text - Store the trace as a text .rep file. Returns 0, or -1
+ *     on error (with errno set).
+ */
+static int write_text(char *path)
+{
+    FILE *fp;
+    traceop_t *op;
+    long i;
+
+    if ((fp = fopen(path, "w")) == NULL)
+	return -1;
+    fprintf(fp, "%lu\n%lu\n%ld\n%d\n", (unsigned long)peak_bytes,
+	    (unsigned long)num_ids, num_ops, 1);
+    for (i = 0; i < num_ops; i++) {
+	op = &ops[i];
+	if (op->type == ALLOC)
+	    fprintf(fp, "a %lu %lu\n", (unsigned long)op->index, (unsigned long)op->size);
+	else if (op->type == REALLOC)
+	    fprintf(fp, "r %lu %lu\n", (unsigned long)op->index, (unsigned long)op->size);
+	else
+	    fprintf(fp, "f %lu\n", (unsigned long)op->index);
+    }
+    if (ferror(fp)) {
+	fclose(fp);
+	return -1;
+    }
+    return fclose(fp);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: tracegen [-bzh] [-n allocs] [-s seed] [-d sizes] [-l lifetimes]\n");
+    fprintf(stderr, "                [-r frac[:factor]] [-p pattern] <out>\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-b         Write a fixed-width binary trace.\n");
+    fprintf(stderr, "\t-z         Write a delta/varint binary trace.\n");
+    fprintf(stderr, "\t-d <dist>  Sizes: uniform:MIN:MAX, power:MIN:MAX:ALPHA,\n");
+    fprintf(stderr, "\t           bimodal:S1:S2:P or hist:FILE (default power:16:4096:1.5).\n");
+    fprintf(stderr, "\t-h         Print this message.\n");
+    fprintf(stderr, "\t-l <model> Lifetimes in allocs: exp:MEAN, lifo[:Q], fifo:DEPTH or\n");
+    fprintf(stderr, "\t           phase:LEN[:KEEP] (default exp:1000).\n");
+    fprintf(stderr, "\t-n <n>     Number of allocations (default 100000).\n");
+    fprintf(stderr, "\t-p <pat>   Fragmentation pattern instead: holes:SIZE or pin:SIZE.\n");
+    fprintf(stderr, "\t-r <f[:g]> Realloc a random live block to g (1.5) times its size\n");
+    fprintf(stderr, "\t           in a fraction f of the steps.\n");
+    fprintf(stderr, "\t-s <seed>  Seed of the random numbers (default 1).\n");
+}
+
+/*
+ * gen_error - Report a problem and terminate
+ */
+static void gen_error(char *msg, char *arg)
+{
+    fprintf(stderr, "tracegen: %s: %s\n", arg, msg);
+    exit(1);
+}
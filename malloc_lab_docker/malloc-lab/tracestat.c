@@ -0,0 +1,381 @@
+/*
+ * tracestat.c - Describes what a malloc trace asks of an allocator.
+ *
+ *     tracestat [-c curve.csv] [-i interval] [-H hist] <trace> ...
+ *         Prints, for each trace (text .rep or binary):
+ *           - the requests per size class, with the class bounds of
+ *             find_size_class in mm.c applied to the block size each
+ *             request needs (payload + header/footer, 16-byte aligned)
+ *           - the lifetimes of the blocks, in ops from alloc to free
+ *           - the peak and average live set
+ *           - the growth ratios (new size / old size) of the reallocs
+ *         With -c the ideal footprint curve is written as CSV: every
+ *         interval ops (default num_ops/1000) the live bytes and blocks
+ *         and the heap a zero-fragmentation allocator that never
+ *         returns memory would have (the running peak of live bytes).
+ *         With -H the exact request sizes are written as "size weight"
+ *         lines, which tracegen -d hist: reads back.
+ *
+ * The trace is streamed (tstream) in a single pass. Apart from the -H
+ * table of distinct sizes, memory is bounded by the live set: the only
+ * per-block state is an idmap entry holding the op of the allocation.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+#include "trace.h"
+#include "tstream.h"
+
+#define DSIZE 16		/* header + footer bytes, and the alignment (mm.c) */
+#define NUM_CLASSES 10	/* size classes of mm.c */
+#define LT_BUCKETS 48	/* lifetime buckets: [2^b, 2^(b+1)) ops */
+
+/* Realloc growth ratio buckets */
+#define NUM_RATIOS 7
+static const double ratio_max[NUM_RATIOS - 1] = {0.999999, 1.000001, 1.25, 1.5, 2, 4};
+static const char *ratio_name[NUM_RATIOS] = {"< 1", "1", "(1, 1.25]", "(1.25, 1.5]",
+					     "(1.5, 2]", "(2, 4]", "> 4"};
+
+/* Statistics of one trace */
+typedef struct
+{
+    long ops, allocs, frees, reallocs, bad;
+    long cls_count[NUM_CLASSES];	/* allocs and reallocs per class */
+    double cls_bytes[NUM_CLASSES];	/* requested bytes per class */
+    long lifetime[LT_BUCKETS];
+    long freed, never_freed;
+    double lifetime_sum;
+    size_t live_bytes, live_blocks;
+    size_t peak_bytes, peak_blocks;
+    long peak_op;
+    double live_bytes_sum, live_blocks_sum;
+    long ratio[NUM_RATIOS];
+    double ratio_sum;
+} tstat_t;
+
+static void analyze(char *path, FILE *curve, long interval, idmap_t *sizes);
+static void print_stats(char *path, tstat_t *st);
+static void count_size(tstat_t *st, idmap_t *sizes, size_t size);
+static void count_lifetime(tstat_t *st, long born, long died);
+static int size_class(size_t size);
+static int write_hist(idmap_t *sizes, char *path);
+static int by_size(const void *a, const void *b);
+static void usage(void);
+static void stat_error(char *msg, char *path);
+
+int main(int argc, char **argv)
+{
+    int c;
+    char *curvefile = NULL, *histfile = NULL;
+    long interval = 0;
+    FILE *curve = NULL;
+    idmap_t sizes;
+
+    while ((c = getopt(argc, argv, "c:i:H:h")) != EOF) {
+	switch (c) {
+	case 'c':
+	    curvefile = optarg;
+	    break;
+	case 'i':
+	    if ((interval = atol(optarg)) <= 0)
+		stat_error("bad interval", optarg);
+	    break;
+	case 'H':
+	    histfile = optarg;
+	    break;
+	case 'h':
+	    usage();
+	    exit(0);
+	default:
+	    usage();
+	    exit(1);
+	}
+    }
+    if (argc == optind) {
+	usage();
+	exit(1);
+    }
+
+    if (curvefile != NULL) {
+	if ((curve = fopen(curvefile, "w")) == NULL)
+	    stat_error(strerror(errno), curvefile);
+	fprintf(curve, "trace,op,live_bytes,live_blocks,ideal_heap\n");
+    }
+    idmap_init(&sizes);
+    for (; optind < argc; optind++)
+	analyze(argv[optind], curve, interval, histfile ? &sizes : NULL);
+
+    if (curve != NULL && fclose(curve) != 0)
+	stat_error(strerror(errno), curvefile);
+    if (histfile != NULL && write_hist(&sizes, histfile) < 0)
+	stat_error(strerror(errno), histfile);
+    idmap_destroy(&sizes);
+    exit(0);
+}
+
+/*
+ * analyze - One pass over a trace. The idmap maps the id of each live
+ *     block to the op that allocated it (in the p field) and its size.
+ */
+static void analyze(char *path, FILE *curve, long interval, idmap_t *sizes)
+{
+    tstream_t *s;
+    trace_t info;
+    traceop_t *ops, *op;
+    tstat_t st;
+    idmap_t live;
+    idmap_ent_t *e;
+    long n, i, k;
+    double ratio;
+
+    memset(&st, 0, sizeof(st));
+    s = tstream_open(path, 0, &info);
+    if (interval <= 0)
+	interval = (info.num_ops >= 1000) ? info.num_ops / 1000 : 1;
+    idmap_init(&live);
+
+    while ((n = tstream_next(s, &ops)) > 0) {
+	for (i = 0; i < n; i++, st.ops++) {
+	    op = &ops[i];
+	    switch (op->type) {
+	    case REALLOC:
+		st.reallocs++;
+		if ((e = idmap_find(&live, op->index)) != NULL) {
+		    ratio = e->size ? (double)op->size / e->size : 1;
+		    for (k = 0; k < NUM_RATIOS - 1 && ratio > ratio_max[k]; k++)
+			;
+		    st.ratio[k]++;
+		    st.ratio_sum += ratio;
+		    st.live_bytes += op->size - e->size;
+		    e->size = op->size;
+		    count_size(&st, sizes, op->size);
+		    break;
+		}
+		/* Fall through: replayed as realloc(NULL, size) */
+
+	    case ALLOC:
+		if (op->type == ALLOC)
+		    st.allocs++;
+		if (idmap_find(&live, op->index) != NULL) {
+		    st.bad++;
+		    break;
+		}
+		e = idmap_insert(&live, op->index);
+		e->p = (char *)(uintptr_t)st.ops;
+		e->size = op->size;
+		st.live_bytes += op->size;
+		st.live_blocks++;
+		count_size(&st, sizes, op->size);
+		break;
+
+	    case FREE:
+		st.frees++;
+		if ((e = idmap_find(&live, op->index)) == NULL) {
+		    st.bad++;
+		    break;
+		}
+		count_lifetime(&st, (long)(uintptr_t)e->p, st.ops);
+		st.live_bytes -= e->size;
+		st.live_blocks--;
+		idmap_remove(&live, e);
+		break;
+	    }
+
+	    if (st.live_bytes > st.peak_bytes) {
+		st.peak_bytes = st.live_bytes;
+		st.peak_op = st.ops;
+	    }
+	    if (st.live_blocks > st.peak_blocks)
+		st.peak_blocks = st.live_blocks;
+	    st.live_bytes_sum += st.live_bytes;
+	    st.live_blocks_sum += st.live_blocks;
+	    if (curve != NULL && (st.ops % interval == 0 || st.ops == info.num_ops - 1))
+		fprintf(curve, "%s,%ld,%zu,%zu,%zu\n", path, st.ops,
+			st.live_bytes, st.live_blocks, st.peak_bytes);
+	}
+    }
+    st.never_freed = live.count;
+    idmap_destroy(&live);
+    tstream_close(s);
+    print_stats(path, &st);
+}
+
+/*
+ * print_stats - Report the statistics of one trace
+ */
+static void print_stats(char *path, tstat_t *st)
+{
+    static const char *bound[NUM_CLASSES] = {"32", "64", "128", "256", "512", "1K",
+					     "2K", "4K", "8K", "> 8K"};
+    long i, total, cum, last;
+    double bytes;
+
+    printf("%s: %ld ops: %ld allocs, %ld reallocs, %ld frees", path,
+	   st->ops, st->allocs, st->reallocs, st->frees);
+    if (st->bad)
+	printf(" (%ld invalid)", st->bad);
+    printf("\n");
+
+    /* Size classes */
+    for (total = 0, bytes = 0, i = 0; i < NUM_CLASSES; i++) {
+	total += st->cls_count[i];
+	bytes += st->cls_bytes[i];
+    }
+    printf("\n  Requests by size class (block size incl. header/footer):\n");
+    printf("  class  blocks <=   requests       %%     req bytes       %%\n");
+    for (i = 0; i < NUM_CLASSES; i++)
+	if (st->cls_count[i] > 0)
+	    printf("  %5ld %10s %10ld %6.1f%% %13.0f %6.1f%%\n", i, bound[i],
+		   st->cls_count[i], 100.0 * st->cls_count[i] / total,
+		   st->cls_bytes[i], bytes > 0 ? 100.0 * st->cls_bytes[i] / bytes : 0);
+
+    /* Lifetimes */
+    printf("\n  Lifetimes (ops from alloc to free):\n");
+    printf("  %21s %10s %7s %7s\n", "ops", "blocks", "%", "cum %");
+    for (last = LT_BUCKETS - 1; last > 0 && st->lifetime[last] == 0; last--)
+	;
+    for (cum = 0, i = 0; i <= last && st->freed > 0; i++) {
+	cum += st->lifetime[i];
+	printf("  %10ld - %8ld %10ld %6.1f%% %6.1f%%\n", 1L << i, (2L << i) - 1,
+	       st->lifetime[i], 100.0 * st->lifetime[i] / st->freed,
+	       100.0 * cum / st->freed);
+    }
+    printf("  mean %.1f ops; %ld blocks never freed\n",
+	   st->freed ? st->lifetime_sum / st->freed : 0, st->never_freed);
+
+    /* Live set */
+    printf("\n  Live set: peak %zu bytes at op %ld, %zu blocks; "
+	   "average %.0f bytes, %.0f blocks\n", st->peak_bytes, st->peak_op,
+	   st->peak_blocks, st->ops ? st->live_bytes_sum / st->ops : 0,
+	   st->ops ? st->live_blocks_sum / st->ops : 0);
+
+    /* Reallocs */
+    for (total = 0, i = 0; i < NUM_RATIOS; i++)
+	total += st->ratio[i];
+    if (total > 0) {
+	printf("\n  Realloc growth (new size / old size), mean %.2f:\n",
+	       st->ratio_sum / total);
+	for (i = 0; i < NUM_RATIOS; i++)
+	    if (st->ratio[i] > 0)
+		printf("  %12s %10ld %6.1f%%\n", ratio_name[i], st->ratio[i],
+		       100.0 * st->ratio[i] / total);
+    }
+    printf("\n");
+}
+
+/*
+ * count_size - Count an alloc or realloc request of size bytes
+ */
+static void count_size(tstat_t *st, idmap_t *sizes, size_t size)
+{
+    idmap_ent_t *e;
+    int c = size_class(size);
+
+    st->cls_count[c]++;
+    st->cls_bytes[c] += size;
+    if (sizes != NULL) {	/* -H: exact sizes, keyed by size */
+	if ((e = idmap_find(sizes, size)) == NULL) {
+	    e = idmap_insert(sizes, size);
+	    e->size = 0;
+	}
+	e->size++;
+    }
+}
+
+/*
+ * count_lifetime - Count a block allocated at op born and freed at op died
+ */
+static void count_lifetime(tstat_t *st, long born, long died)
+{
+    long life = died - born;
+    int b = 0;
+
+    while (b < LT_BUCKETS - 1 && (life >> (b + 1)) > 0)
+	b++;
+    st->lifetime[b]++;
+    st->lifetime_sum += life;
+    st->freed++;
+}
+
+/*
+ * size_class - The class mm.c puts a block for a size-byte request in:
+ *     the block size as malloc_block computes it, bucketed the way
+ *     find_size_class does
+ */
+static int size_class(size_t size)
+{
+    size_t asize = (size <= DSIZE) ? 2 * DSIZE :
+	DSIZE * ((size + DSIZE + (DSIZE - 1)) / DSIZE);
+    int c;
+
+    for (c = 0; c < NUM_CLASSES - 1 && asize > ((size_t)32 << c); c++)
+	;
+    return c;
+}
+
+/*
+ * write_hist - Write the -H table of request sizes. Returns 0, or -1 on
+ *     error (with errno set).
+ */
+static int write_hist(idmap_t *sizes, char *path)
+{
+    FILE *fp;
+    idmap_ent_t *ents;
+    size_t i, n;
+
+    if ((ents = malloc((sizes->count + 1) * sizeof(idmap_ent_t))) == NULL)
+	stat_error("out of memory", path);
+    for (n = 0, i = 0; i <= sizes->mask; i++)
+	if (sizes->slots[i].id != IDMAP_EMPTY)
+	    ents[n++] = sizes->slots[i];
+    qsort(ents, n, sizeof(idmap_ent_t), by_size);
+
+    if ((fp = fopen(path, "w")) == NULL) {
+	free(ents);
+	return -1;
+    }
+    fprintf(fp, "# size weight\n");
+    for (i = 0; i < n; i++)
+	fprintf(fp, "%lu %zu\n", (unsigned long)ents[i].id, ents[i].size);
+    free(ents);
+    if (ferror(fp)) {
+	fclose(fp);
+	return -1;
+    }
+    return fclose(fp);
+}
+
+/*
+ * by_size - qsort comparator for the -H table
+ */
+static int by_size(const void *a, const void *b)
+{
+    uint64_t x = ((const idmap_ent_t *)a)->id, y = ((const idmap_ent_t *)b)->id;
+
+    return (x > y) - (x < y);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: tracestat [-h] [-c <file>] [-i <n>] [-H <file>] <trace> ...\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-c <file>  Write the live bytes and ideal footprint curve as CSV.\n");
+    fprintf(stderr, "\t-h         Print this message.\n");
+    fprintf(stderr, "\t-H <file>  Write the request sizes as a tracegen histogram.\n");
+    fprintf(stderr, "\t-i <n>     Sample the curve every n ops (default num_ops/1000).\n");
+}
+
+/*
+ * stat_error - Report a problem and terminate
+ */
+static void stat_error(char *msg, char *path)
+{
+    fprintf(stderr, "tracestat: %s: %s\n", path, msg);
+    exit(1);
+}
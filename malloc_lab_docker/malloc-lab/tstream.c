@@ -0,0 +1,507 @@
+/*
+ * tstream.c - Streams the ops of a trace file in fixed-size windows.
+ *
+ * tstream_open reads the trace header and starts a helper thread that
+ * decodes ops into two window buffers in turn. While the reader replays
+ * one window, the thread fills the other, so decoding and file I/O
+ * overlap with the replay and the driver holds at most two windows of
+ * ops at a time no matter how long the trace is.
+ *
+ * The idmap at the end of the file is the streaming replacement for the
+ * blocks/block_sizes arrays of trace_t.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include "tstream.h"
+
+#define BUFSIZE (1 << 16)	/* bytes per read of the trace file */
+#define TEXT_ENCODING (-1)	/* encoding of a text .rep trace */
+#define IDMAP_MINSLOTS 1024 /* initial idmap size */
+
+struct tstream
+{
+	char *path;
+	int fd;
+	int encoding;		/* TEXT_ENCODING, TRACE_FIXED or TRACE_VARINT */
+	uint64_t data_left; /* binary traces: op bytes not yet consumed */
+	uint64_t prev_id;	/* TRACE_VARINT: last decoded id */
+
+	/* Read buffer */
+	unsigned char *buf;
+	size_t pos; /* next unread byte */
+	size_t len; /* valid bytes in buf */
+
+	/* Double-buffered windows of decoded ops */
+	long window;	   /* ops per window */
+	traceop_t *win[2]; /* the two window buffers */
+	long nops[2];	   /* ops in each window (0 marks the end) */
+	int full[2];	   /* set by the thread, cleared by the reader */
+	int cur;		   /* window held by the reader (-1 before the first) */
+	int ended;		   /* the reader has seen the end of the trace */
+	int stop;		   /* tells the thread to quit (tstream_close) */
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+};
+
+static void stream_error(tstream_t *s, char *msg);
+static int next_byte(tstream_t *s);
+static size_t read_bytes(tstream_t *s, void *dst, size_t n);
+static int read_number(tstream_t *s, unsigned long *v);
+static int read_varint(tstream_t *s, uint64_t *v);
+static long decode_window(tstream_t *s, traceop_t *ops);
+static void *stream_thread(void *arg);
+
+/*
+ * tstream_open - Open a trace for streaming with window ops per window
+ *     (TSTREAM_WINDOW if window <= 0). The header fields are returned in
+ *     *info; its op and block arrays are left NULL.
+ */
+tstream_t *tstream_open(char *path, long window, trace_t *info)
+{
+	tstream_t *s;
+	trace_hdr_t hdr;
+	unsigned long v[4];
+	ssize_t n;
+	int i;
+
+	if ((s = (tstream_t *)calloc(1, sizeof(tstream_t))) == NULL)
+		stream_error(NULL, "malloc failed in tstream_open");
+	s->path = path;
+	s->window = (window > 0) ? window : TSTREAM_WINDOW;
+	s->cur = -1;
+	if ((s->fd = open(path, O_RDONLY)) < 0)
+		stream_error(s, "Could not open trace file");
+	if ((s->buf = (unsigned char *)malloc(BUFSIZE)) == NULL ||
+		(s->win[0] = (traceop_t *)calloc(s->window, sizeof(traceop_t))) == NULL ||
+		(s->win[1] = (traceop_t *)calloc(s->window, sizeof(traceop_t))) == NULL)
+		stream_error(s, "malloc of stream buffers failed for");
+
+	memset(info, 0, sizeof(trace_t));
+	if ((n = read(s->fd, s->buf, BUFSIZE)) < 0)
+		stream_error(s, "Read error on");
+	s->len = n;
+	if (s->len >= sizeof(hdr) &&
+		memcmp(s->buf, TRACE_MAGIC, sizeof(hdr.magic)) == 0)
+	{
+		memcpy(&hdr, s->buf, sizeof(hdr));
+		s->pos = sizeof(hdr);
+		if (hdr.version != TRACE_VERSION || hdr.endian != TRACE_ENDIAN)
+			stream_error(s, "Unsupported version or byte order in");
+		if (hdr.encoding != TRACE_FIXED && hdr.encoding != TRACE_VARINT)
+			stream_error(s, "Unknown encoding in");
+		if (hdr.encoding == TRACE_FIXED && hdr.data_len % sizeof(traceop_t))
+			stream_error(s, "Bad op array length in");
+		s->encoding = hdr.encoding;
+		s->data_left = hdr.data_len;
+		info->sugg_heapsize = hdr.sugg_heapsize;
+		info->num_ids = hdr.num_ids;
+		info->num_ops = hdr.num_ops;
+		info->weight = hdr.weight;
+	}
+	else
+	{
+		/* Not a binary trace: parse the text header */
+		s->encoding = TEXT_ENCODING;
+		for (i = 0; i < 4; i++)
+			if (!read_number(s, &v[i]))
+				stream_error(s, "Bad header in");
+		info->sugg_heapsize = v[0];
+		info->num_ids = v[1];
+		info->num_ops = v[2];
+		info->weight = v[3];
+	}
+
+	pthread_mutex_init(&s->lock, NULL);
+	pthread_cond_init(&s->cond, NULL);
+	if (pthread_create(&s->thread, NULL, stream_thread, s) != 0)
+		stream_error(s, "Could not start the decoder thread for");
+	return s;
+}
+
+/*
+ * tstream_next - Hand the current window back to the decoder and return
+ *     the next one in *ops. Returns the number of ops in it, 0 at the end
+ *     of the trace. The window stays valid until the next call.
+ */
+long tstream_next(tstream_t *s, traceop_t **ops)
+{
+	int k;
+
+	if (s->ended)
+		return 0;
+
+	pthread_mutex_lock(&s->lock);
+	if (s->cur >= 0)
+	{
+		s->full[s->cur] = 0;
+		pthread_cond_broadcast(&s->cond);
+	}
+	k = (s->cur + 1) & 1;
+	while (!s->full[k])
+		pthread_cond_wait(&s->cond, &s->lock);
+	s->cur = k;
+	pthread_mutex_unlock(&s->lock);
+
+	*ops = s->win[k];
+	if (s->nops[k] == 0)
+		s->ended = 1;
+	return s->nops[k];
+}
+
+/*
+ * tstream_close - Stop the decoder and release the stream
+ */
+void tstream_close(tstream_t *s)
+{
+	pthread_mutex_lock(&s->lock);
+	s->stop = 1;
+	pthread_cond_broadcast(&s->cond);
+	pthread_mutex_unlock(&s->lock);
+	pthread_join(s->thread, NULL);
+
+	pthread_mutex_destroy(&s->lock);
+	pthread_cond_destroy(&s->cond);
+	close(s->fd);
+	free(s->buf);
+	free(s->win[0]);
+	free(s->win[1]);
+	free(s);
+}
+
+/*
+ * stream_thread - Decode windows until the end of the trace, staying at
+ *     most one window ahead of the reader
+ */
+static void *stream_thread(void *arg)
+{
+	tstream_t *s = (tstream_t *)arg;
+	long n;
+	int k = 0;
+
+	do
+	{
+		pthread_mutex_lock(&s->lock);
+		while (s->full[k] && !s->stop)
+			pthread_cond_wait(&s->cond, &s->lock);
+		pthread_mutex_unlock(&s->lock);
+		if (s->stop)
+			break;
+
+		n = decode_window(s, s->win[k]);
+
+		pthread_mutex_lock(&s->lock);
+		s->nops[k] = n;
+		s->full[k] = 1;
+		pthread_cond_broadcast(&s->cond);
+		pthread_mutex_unlock(&s->lock);
+		k ^= 1;
+	} while (n > 0);
+
+	return NULL;
+}
+
+/*
+ * decode_window - Decode up to s->window ops into ops. Returns the
+ *     number decoded, 0 once the trace is exhausted.
+ */
+static long decode_window(tstream_t *s, traceop_t *ops)
+{
+	long n;
+	int c;
+	unsigned long index, size;
+	uint64_t v, z;
+
+	if (s->encoding == TRACE_FIXED)
+	{
+		size_t want = s->window * sizeof(traceop_t);
+
+		if (want > s->data_left)
+			want = s->data_left;
+		if (read_bytes(s, ops, want) != want)
+			stream_error(s, "Truncated trace file");
+		s->data_left -= want;
+		for (n = 0; n < (long)(want / sizeof(traceop_t)); n++)
+			if (ops[n].type > REALLOC ||
+				(ops[n].type != FREE && ops[n].size > TRACE_MAX_SIZE))
+				stream_error(s, "Corrupt op data in");
+		return want / sizeof(traceop_t);
+	}
+
+	for (n = 0; n < s->window; n++)
+	{
+		if (s->encoding == TRACE_VARINT)
+		{
+			if (!read_varint(s, &v))
+				break;
+			z = v >> 2;
+			s->prev_id += (uint64_t)((int64_t)(z >> 1) ^ -(int64_t)(z & 1));
+			ops[n].type = v & 3;
+			ops[n].index = s->prev_id;
+			ops[n].size = 0;
+			if ((v & 3) > REALLOC ||
+				((v & 3) != FREE && !read_varint(s, &ops[n].size)) ||
+				ops[n].size > TRACE_MAX_SIZE)
+				stream_error(s, "Corrupt op data in");
+			continue;
+		}
+
+		/* Text: one of "a id size", "r id size" or "f id" */
+		while ((c = next_byte(s)) == ' ' || c == '\t' || c == '\n' || c == '\r')
+			;
+		if (c < 0)
+			break;
+		size = 0;
+		if (!read_number(s, &index) ||
+			(c != 'f' && !read_number(s, &size)))
+			stream_error(s, "Truncated request in");
+		switch (c)
+		{
+		case 'a':
+			ops[n].type = ALLOC;
+			break;
+		case 'r':
+			ops[n].type = REALLOC;
+			break;
+		case 'f':
+			ops[n].type = FREE;
+			break;
+		default:
+			stream_error(s, "Bogus type character in");
+		}
+		if (size > TRACE_MAX_SIZE)
+			stream_error(s, "Request size above INT_MAX in");
+		ops[n].index = index;
+		ops[n].size = size;
+	}
+	return n;
+}
+
+/*
+ * next_byte - The next byte of the trace file, or -1 at its end. For
+ *     binary traces, the end is the end of the op data.
+ */
+static int next_byte(tstream_t *s)
+{
+	ssize_t n;
+
+	if (s->encoding != TEXT_ENCODING)
+	{
+		if (s->data_left == 0)
+			return -1;
+		s->data_left--;
+	}
+	if (s->pos == s->len)
+	{
+		if ((n = read(s->fd, s->buf, BUFSIZE)) < 0)
+			stream_error(s, "Read error on");
+		if (n == 0)
+			return -1;
+		s->pos = 0;
+		s->len = n;
+	}
+	return s->buf[s->pos++];
+}
+
+/*
+ * read_bytes - Copy up to n bytes of the trace file to dst, first from
+ *     the read buffer and then straight from the file (no extra copy for
+ *     the large reads of TRACE_FIXED windows). Returns the number of
+ *     bytes copied.
+ */
+static size_t read_bytes(tstream_t *s, void *dst, size_t n)
+{
+	char *d = (char *)dst;
+	size_t done = s->len - s->pos;
+	ssize_t r;
+
+	if (done > n)
+		done = n;
+	memcpy(d, s->buf + s->pos, done);
+	s->pos += done;
+	while (done < n)
+	{
+		if ((r = read(s->fd, d + done, n - done)) < 0)
+			stream_error(s, "Read error on");
+		if (r == 0)
+			break;
+		done += r;
+	}
+	return done;
+}
+
+/*
+ * read_number - Skip blanks and read an unsigned decimal number
+ */
+static int read_number(tstream_t *s, unsigned long *v)
+{
+	int c;
+
+	while ((c = next_byte(s)) == ' ' || c == '\t' || c == '\n' || c == '\r')
+		;
+	if (c < '0' || c > '9')
+		return 0;
+	*v = 0;
+	do
+	{
+		*v = *v * 10 + (c - '0');
+	} while ((c = next_byte(s)) >= '0' && c <= '9');
+	return 1;
+}
+
+/*
+ * read_varint - Read one LEB128 varint. Returns 0 at the end of the data.
+ */
+static int read_varint(tstream_t *s, uint64_t *v)
+{
+	int c, shift = 0;
+
+	*v = 0;
+	while ((c = next_byte(s)) >= 0 && shift < 64)
+	{
+		*v |= (uint64_t)(c & 0x7f) << shift;
+		if ((c & 0x80) == 0)
+			return 1;
+		shift += 7;
+	}
+	if (shift > 0)
+		stream_error(s, "Truncated varint in");
+	return 0;
+}
+
+/*
+ * stream_error - Report a trace streaming error and terminate
+ */
+static void stream_error(tstream_t *s, char *msg)
+{
+	if (s != NULL)
+		fprintf(stderr, "Trace error: %s %s\n", msg, s->path);
+	else
+		fprintf(stderr, "Trace error: %s\n", msg);
+	exit(1);
+}
+
+/************************************************************
+ * idmap: open addressing hash table from trace ids to blocks
+ ************************************************************/
+
+/* Home slot of id (Fibonacci hashing) */
+#define IDMAP_HOME(m, id) \
+	((size_t)(((id) * 0x9e3779b97f4a7c15ULL) >> 32) & (m)->mask)
+
+static void idmap_alloc(idmap_t *m, size_t nslots);
+
+/*
+ * idmap_init - Create an empty map
+ */
+void idmap_init(idmap_t *m)
+{
+	m->max_count = 0;
+	idmap_alloc(m, IDMAP_MINSLOTS);
+}
+
+/*
+ * idmap_destroy - Free the slots of a map
+ */
+void idmap_destroy(idmap_t *m)
+{
+	free(m->slots);
+	m->slots = NULL;
+}
+
+/*
+ * idmap_find - The entry for id, or NULL if id is not live
+ */
+idmap_ent_t *idmap_find(idmap_t *m, uint64_t id)
+{
+	size_t i = IDMAP_HOME(m, id);
+
+	while (m->slots[i].id != id)
+	{
+		if (m->slots[i].id == IDMAP_EMPTY)
+			return NULL;
+		i = (i + 1) & m->mask;
+	}
+	return &m->slots[i];
+}
+
+/*
+ * idmap_insert - The entry for id, adding an empty one if id is not
+ *     live. The table doubles when it would become more than half full.
+ */
+idmap_ent_t *idmap_insert(idmap_t *m, uint64_t id)
+{
+	idmap_ent_t *old, *e;
+	size_t i, nslots = m->mask + 1;
+
+	if ((e = idmap_find(m, id)) != NULL)
+		return e;
+
+	if (2 * (m->count + 1) > nslots)
+	{
+		old = m->slots;
+		idmap_alloc(m, 2 * nslots);
+		for (i = 0; i < nslots; i++)
+			if (old[i].id != IDMAP_EMPTY)
+				*idmap_insert(m, old[i].id) = old[i];
+		free(old);
+	}
+
+	for (i = IDMAP_HOME(m, id); m->slots[i].id != IDMAP_EMPTY;
+		 i = (i + 1) & m->mask)
+		;
+	e = &m->slots[i];
+	e->id = id;
+	e->p = NULL;
+	e->size = 0;
+	if (++m->count > m->max_count)
+		m->max_count = m->count;
+	return e;
+}
+
+/*
+ * idmap_remove - Remove an entry returned by idmap_find/idmap_insert.
+ *     Later entries of the probe run are shifted back into the hole so
+ *     lookups never need tombstones.
+ */
+void idmap_remove(idmap_t *m, idmap_ent_t *e)
+{
+	size_t hole = e - m->slots;
+	size_t i = hole, home;
+
+	for (;;)
+	{
+		i = (i + 1) & m->mask;
+		if (m->slots[i].id == IDMAP_EMPTY)
+			break;
+		home = IDMAP_HOME(m, m->slots[i].id);
+		/* Move slot i into the hole unless its home lies in (hole, i] */
+		if (((i - home) & m->mask) >= ((i - hole) & m->mask))
+		{
+			m->slots[hole] = m->slots[i];
+			hole = i;
+		}
+	}
+	m->slots[hole].id = IDMAP_EMPTY;
+	m->count--;
+}
+
+/*
+ * idmap_alloc - Give m an empty table of nslots slots
+ */
+static void idmap_alloc(idmap_t *m, size_t nslots)
+{
+	size_t i;
+
+	if ((m->slots = (idmap_ent_t *)malloc(nslots * sizeof(idmap_ent_t))) == NULL)
+		stream_error(NULL, "malloc of idmap failed");
+	for (i = 0; i < nslots; i++)
+		m->slots[i].id = IDMAP_EMPTY;
+	m->mask = nslots - 1;
+	m->count = 0;
+}
@@ -0,0 +1,48 @@
+/*
+ * tstream.h - Streaming access to trace files that are too large to
+ *             load with read_trace.
+ *
+ * A tstream decodes the ops of a trace (text .rep or either binary
+ * encoding) into fixed-size windows on a helper thread, one window ahead
+ * of the reader. An idmap maps the ids of the live blocks to their
+ * pointers and sizes; it grows with the live set instead of being sized
+ * to num_ids up front.
+ */
+#ifndef __TSTREAM_H_
+#define __TSTREAM_H_
+
+#include "trace.h"
+
+#define TSTREAM_WINDOW 65536 /* default ops per window */
+
+typedef struct tstream tstream_t;
+
+tstream_t *tstream_open(char *path, long window, trace_t *info);
+long tstream_next(tstream_t *s, traceop_t **ops);
+void tstream_close(tstream_t *s);
+
+#define IDMAP_EMPTY UINT64_MAX /* id of an unused idmap slot */
+
+/* One live block in an idmap */
+typedef struct
+{
+	uint64_t id;  /* trace id (IDMAP_EMPTY if the slot is unused) */
+	char *p;	  /* pointer returned by malloc/realloc */
+	size_t size;  /* payload size */
+} idmap_ent_t;
+
+typedef struct
+{
+	idmap_ent_t *slots; /* open addressing table, linear probing */
+	size_t mask;		/* number of slots - 1 (a power of 2) */
+	size_t count;		/* number of live ids */
+	size_t max_count;	/* high water mark of count */
+} idmap_t;
+
+void idmap_init(idmap_t *m);
+void idmap_destroy(idmap_t *m);
+idmap_ent_t *idmap_find(idmap_t *m, uint64_t id);
+idmap_ent_t *idmap_insert(idmap_t *m, uint64_t id);
+void idmap_remove(idmap_t *m, idmap_ent_t *e);
+
+#endif /* __TSTREAM_H_ */